@@ -60,10 +60,16 @@ struct _AoBookmarkListPrivate
 	GtkListStore *store;
 	GtkWidget *tree;
 
-	gint		 search_line;
-	GtkTreeIter	*search_iter;
+	/* the lines of the bookmarks of the listed document, one per row of the
+	 * list, as differences to the line of the previous row summed up in a
+	 * Fenwick tree (element 0 is unused). Inserting or removing lines moves
+	 * all the following bookmarks in O(log n) without touching the rows. */
+	GArray			*lines;
+	GeanyDocument	*doc;
 };
 
+#define LINES_TREE(priv, i)		g_array_index((priv)->lines, gint, (i))
+
 enum
 {
 	PROP_0,
@@ -72,7 +78,6 @@ enum
 
 enum
 {
-	BMLIST_COL_LINE,
 	BMLIST_COL_NAME,
 	BMLIST_COL_TOOLTIP,
 	BMLIST_COL_MAX
@@ -136,54 +141,142 @@ static void ao_bookmark_list_finalize(GObject *object)
 	g_return_if_fail(IS_AO_BOOKMARK_LIST(object));
 
 	ao_bookmark_list_hide(AO_BOOKMARK_LIST(object));
+	g_array_free(AO_BOOKMARK_LIST_GET_PRIVATE(object)->lines, TRUE);
 
 	G_OBJECT_CLASS(ao_bookmark_list_parent_class)->finalize(object);
 }
 
 
-static gboolean tree_model_foreach(GtkTreeModel *model, GtkTreePath *path,
-								   GtkTreeIter *iter, gpointer data)
+static gint rows_count(AoBookmarkListPrivate *priv)
 {
-	gint x;
-	AoBookmarkListPrivate *priv = AO_BOOKMARK_LIST_GET_PRIVATE(data);
+	return priv->lines->len - 1;
+}
+
+
+/* Returns the line of the bookmark at row */
+static gint row_get_line(AoBookmarkListPrivate *priv, gint row)
+{
+	gint i, line_nr = 0;
+
+	for (i = row + 1; i > 0; i -= i & -i)
+		line_nr += LINES_TREE(priv, i);
+	return line_nr;
+}
+
+
+/* Moves the bookmarks from row on by lines_added lines */
+static void rows_shift(AoBookmarkListPrivate *priv, gint row, gint lines_added)
+{
+	gint i, n = rows_count(priv);
+
+	for (i = row + 1; i <= n; i += i & -i)
+		LINES_TREE(priv, i) += lines_added;
+}
 
-	gtk_tree_model_get(model, iter, BMLIST_COL_LINE, &x, -1);
-	if (x == priv->search_line)
+
+/* Returns the first row with a bookmark after line_nr, or the number of rows */
+static gint row_after(AoBookmarkListPrivate *priv, gint line_nr)
+{
+	gint n = rows_count(priv);
+	gint row = 0, step = 1;
+
+	while (step * 2 <= n)
+		step *= 2;
+	/* the differences aren't negative, so the rows up to line_nr are found
+	 * by descending the tree */
+	for (; step > 0; step /= 2)
 	{
-		priv->search_iter = gtk_tree_iter_copy(iter);
-		return TRUE;
+		if (row + step <= n && LINES_TREE(priv, row + step) <= line_nr)
+		{
+			row += step;
+			line_nr -= LINES_TREE(priv, row);
+		}
 	}
-	return FALSE;
+	return row;
 }
 
 
-static void delete_line(AoBookmarkList *bm, gint line_nr)
+/* Turns the tree into the plain differences of the lines, so that rows can be
+ * inserted or removed, or back into a tree, both in O(n) */
+static void rows_untree(AoBookmarkListPrivate *priv)
 {
-	AoBookmarkListPrivate *priv = AO_BOOKMARK_LIST_GET_PRIVATE(bm);
+	gint i, n = rows_count(priv);
 
-	priv->search_line = line_nr + 1;
-	priv->search_iter = NULL;
-	gtk_tree_model_foreach(GTK_TREE_MODEL(priv->store), tree_model_foreach, bm);
-	if (priv->search_iter != NULL)
+	for (i = n; i > 0; i--)
 	{
-		gtk_list_store_remove(priv->store, priv->search_iter);
-		gtk_tree_iter_free(priv->search_iter);
+		if (i + (i & -i) <= n)
+			LINES_TREE(priv, i + (i & -i)) -= LINES_TREE(priv, i);
 	}
 }
 
 
-static void add_line(AoBookmarkList *bm, ScintillaObject *sci, gint line_nr)
+static void rows_tree(AoBookmarkListPrivate *priv)
+{
+	gint i, n = rows_count(priv);
+
+	for (i = 1; i <= n; i++)
+	{
+		if (i + (i & -i) <= n)
+			LINES_TREE(priv, i + (i & -i)) += LINES_TREE(priv, i);
+	}
+}
+
+
+static void rows_insert(AoBookmarkListPrivate *priv, gint row, gint line_nr)
+{
+	gint diff = line_nr - (row > 0 ? row_get_line(priv, row - 1) : 0);
+
+	rows_untree(priv);
+	g_array_insert_val(priv->lines, row + 1, diff);
+	/* the next row keeps its line */
+	if (row + 1 < rows_count(priv))
+		LINES_TREE(priv, row + 2) -= diff;
+	rows_tree(priv);
+}
+
+
+static void rows_remove(AoBookmarkListPrivate *priv, gint row)
+{
+	rows_untree(priv);
+	/* the next row keeps its line */
+	if (row + 1 < rows_count(priv))
+		LINES_TREE(priv, row + 2) += LINES_TREE(priv, row + 1);
+	g_array_remove_index(priv->lines, row + 1);
+	rows_tree(priv);
+}
+
+
+static void rows_clear(AoBookmarkListPrivate *priv)
+{
+	g_array_set_size(priv->lines, 1);
+}
+
+
+/* Returns the line of the bookmark listed at iter */
+static gint iter_get_line(AoBookmarkListPrivate *priv, GtkTreeModel *model, GtkTreeIter *iter)
+{
+	GtkTreePath *path = gtk_tree_model_get_path(model, iter);
+	gint row = gtk_tree_path_get_indices(path)[0];
+
+	gtk_tree_path_free(path);
+	return row < rows_count(priv) ? row_get_line(priv, row) : -1;
+}
+
+
+static void set_row_text(AoBookmarkListPrivate *priv, GtkTreeIter *iter,
+						 ScintillaObject *sci, gint line_nr)
 {
 	gchar *line, *tooltip;
-	AoBookmarkListPrivate *priv = AO_BOOKMARK_LIST_GET_PRIVATE(bm);
 
 	line = g_strstrip(sci_get_line(sci, line_nr));
 	if (EMPTY(line))
+	{
+		g_free(line);
 		line = g_strdup(_("(Empty Line)"));
+	}
 	tooltip = g_markup_escape_text(line, -1);
 
-	gtk_list_store_insert_with_values(priv->store, NULL, -1,
-		BMLIST_COL_LINE, line_nr + 1,
+	gtk_list_store_set(priv->store, iter,
 		BMLIST_COL_NAME, line,
 		BMLIST_COL_TOOLTIP, tooltip,
 		-1);
@@ -192,22 +285,107 @@ static void add_line(AoBookmarkList *bm, ScintillaObject *sci, gint line_nr)
 }
 
 
-static gboolean ao_selection_changed_cb(gpointer widget)
+static void remove_row(AoBookmarkListPrivate *priv, gint row)
+{
+	GtkTreeIter iter;
+
+	gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(priv->store), &iter, NULL, row);
+	gtk_list_store_remove(priv->store, &iter);
+	rows_remove(priv, row);
+}
+
+
+static void delete_line(AoBookmarkList *bm, gint line_nr)
 {
-	GtkTreeSelection *selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(widget));
+	AoBookmarkListPrivate *priv = AO_BOOKMARK_LIST_GET_PRIVATE(bm);
+	gint row = row_after(priv, line_nr - 1);
+
+	while (row < rows_count(priv) && row_get_line(priv, row) == line_nr)
+		remove_row(priv, row);
+}
+
+
+static void add_line(AoBookmarkList *bm, ScintillaObject *sci, gint line_nr)
+{
+	AoBookmarkListPrivate *priv = AO_BOOKMARK_LIST_GET_PRIVATE(bm);
+	gint row = row_after(priv, line_nr);
+	GtkTreeIter iter;
+
+	/* already listed */
+	if (row > 0 && row_get_line(priv, row - 1) == line_nr)
+		return;
+
+	rows_insert(priv, row, line_nr);
+	gtk_list_store_insert(priv->store, &iter, row);
+	set_row_text(priv, &iter, sci, line_nr);
+}
+
+
+/* Makes the list agree with the bookmark set at line_nr, and updates its text */
+static void sync_line(AoBookmarkList *bm, ScintillaObject *sci, gint line_nr)
+{
+	/* drop the bookmarks merged into the line, keep a single one if any */
+	delete_line(bm, line_nr);
+	if (sci_is_marker_set_at_line(sci, line_nr, 1))
+		add_line(bm, sci, line_nr);
+}
+
+
+/* Moves the bookmarks after line_nr by lines_added lines. Bookmarks on the
+ * removed lines end up on line_nr like in Scintilla. */
+static void shift_lines(AoBookmarkList *bm, ScintillaObject *sci, gint line_nr, gint lines_added)
+{
+	AoBookmarkListPrivate *priv = AO_BOOKMARK_LIST_GET_PRIVATE(bm);
+	gint row;
+
+	if (lines_added > 0 && ! sci_is_marker_set_at_line(sci, line_nr, 1))
+	{	/* the lines were inserted at the start of the bookmarked line */
+		row = row_after(priv, line_nr - 1);
+	}
+	else
+		row = row_after(priv, line_nr);
+
+	/* the bookmarks of the removed lines are merged into line_nr */
+	while (lines_added < 0 && row < rows_count(priv) &&
+		   row_get_line(priv, row) <= line_nr - lines_added)
+		remove_row(priv, row);
+
+	/* only the line numbers change, and the rows keep their order */
+	rows_shift(priv, row, lines_added);
+
+	sync_line(bm, sci, line_nr);
+	if (lines_added > 0)
+		sync_line(bm, sci, line_nr + lines_added);
+	gtk_widget_queue_draw(priv->tree);
+}
+
+
+static void bookmark_line_data_func(GtkTreeViewColumn *column, GtkCellRenderer *cell,
+									GtkTreeModel *model, GtkTreeIter *iter, gpointer data)
+{
+	gchar text[16];
+
+	g_snprintf(text, sizeof(text), "%d",
+		iter_get_line(AO_BOOKMARK_LIST_GET_PRIVATE(data), model, iter) + 1);
+	g_object_set(cell, "text", text, NULL);
+}
+
+
+static gboolean ao_selection_changed_cb(gpointer data)
+{
+	AoBookmarkListPrivate *priv = AO_BOOKMARK_LIST_GET_PRIVATE(data);
+	GtkTreeSelection *selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(priv->tree));
 	GtkTreeIter iter;
 	GtkTreeModel *model;
 
 	if (gtk_tree_selection_get_selected(selection, &model, &iter))
 	{
-		gint line;
 		GeanyDocument *doc = document_get_current();
 		if (DOC_VALID(doc))
 		{
 			gint pos;
 
-			gtk_tree_model_get(model, &iter, BMLIST_COL_LINE, &line, -1);
-			pos = sci_get_position_from_line(doc->editor->sci, line - 1);
+			pos = sci_get_position_from_line(doc->editor->sci, iter_get_line(priv, model, &iter));
 
 			editor_goto_pos(doc->editor, pos, FALSE);
 			gtk_widget_grab_focus(GTK_WIDGET(doc->editor->sci));
@@ -221,7 +399,7 @@ static gboolean ao_button_press_cb(GtkWidget *widget, GdkEventButton *event, gpo
 {
 	if (event->button == 1)
 	{	/* allow reclicking of a treeview item */
-		g_idle_add(ao_selection_changed_cb, widget);
+		g_idle_add(ao_selection_changed_cb, data);
 	}
 	else if (event->button == 3)
 	{
@@ -245,7 +423,7 @@ static gboolean ao_key_press_cb(GtkWidget *widget, GdkEventKey *event, gpointer
 		event->keyval == GDK_KP_Enter ||
 		event->keyval == GDK_space)
 	{
-		g_idle_add(ao_selection_changed_cb, widget);
+		g_idle_add(ao_selection_changed_cb, data);
 	}
 
 	if ((event->keyval == GDK_F10 && event->state & GDK_SHIFT_MASK) || event->keyval == GDK_Menu)
@@ -291,9 +469,7 @@ static void popup_item_click_cb(GtkWidget *button, gpointer data)
 	if (gtk_tree_selection_get_selected(treesel, &model, &iter))
 	{
 		GeanyDocument *doc = document_get_current();
-		gint line_nr;
-		gtk_tree_model_get(model, &iter, BMLIST_COL_LINE, &line_nr, -1);
-		sci_delete_marker_at_line(doc->editor->sci, line_nr - 1, 1);
+		sci_delete_marker_at_line(doc->editor->sci, iter_get_line(priv, model, &iter), 1);
 	}
 }
 
@@ -320,12 +496,11 @@ static void ao_bookmark_list_show(AoBookmarkList *bm)
 	GtkTreeView *tree;
 	GtkListStore *store;
 	GtkWidget *scrollwin;
-	GtkTreeSortable *sortable;
 	GeanyDocument *doc;
 	AoBookmarkListPrivate *priv = AO_BOOKMARK_LIST_GET_PRIVATE(bm);
 
 	tree = GTK_TREE_VIEW(gtk_tree_view_new());
-	store = gtk_list_store_new(BMLIST_COL_MAX, G_TYPE_INT, G_TYPE_STRING, G_TYPE_STRING);
+	store = gtk_list_store_new(BMLIST_COL_MAX, G_TYPE_STRING, G_TYPE_STRING);
 	gtk_tree_view_set_model(tree, GTK_TREE_MODEL(store));
 
 	text_renderer = gtk_cell_renderer_text_new();
@@ -333,7 +508,7 @@ static void ao_bookmark_list_show(AoBookmarkList *bm)
 	// Translators: Number is meant at this point.
 	gtk_tree_view_column_set_title(column, _("No."));
 	gtk_tree_view_column_pack_start(column, text_renderer, TRUE);
-	gtk_tree_view_column_set_attributes(column, text_renderer, "text", BMLIST_COL_LINE, NULL);
+	gtk_tree_view_column_set_cell_data_func(column, text_renderer, bookmark_line_data_func, bm, NULL);
 	gtk_tree_view_append_column(tree, column);
 
 	text_renderer = gtk_cell_renderer_text_new();
@@ -347,10 +522,6 @@ static void ao_bookmark_list_show(AoBookmarkList *bm)
 
 	gtk_tree_view_set_search_column(tree, BMLIST_COL_NAME);
 
-	/* sorting */
-	sortable = GTK_TREE_SORTABLE(GTK_TREE_MODEL(store));
-	gtk_tree_sortable_set_sort_column_id(sortable, BMLIST_COL_LINE, GTK_SORT_ASCENDING);
-
 	ui_widget_modify_font_from_string(GTK_WIDGET(tree), geany->interface_prefs->tagbar_font);
 
 	/* GTK 2.12 tooltips */
@@ -403,19 +574,45 @@ void ao_bookmark_list_activate(AoBookmarkList *bm)
 
 void ao_bookmark_list_update(AoBookmarkList *bm, GeanyDocument *doc)
 {
-	gint line_nr = 0;
+	gint line_nr = 0, prev_line = 0;
 	gint mask = 1 << 1;
 	ScintillaObject *sci = doc->editor->sci;
 	AoBookmarkListPrivate *priv = AO_BOOKMARK_LIST_GET_PRIVATE(bm);
+	GtkTreeIter iter;
 
 	if (priv->enable_bookmarklist)
 	{
 		gtk_list_store_clear(priv->store);
+		rows_clear(priv);
+		priv->doc = doc;
+		/* the markers come in line order, so collect their plain differences
+		 * and build the tree once */
 		while ((line_nr = scintilla_send_message(sci, SCI_MARKERNEXT, line_nr, mask)) != -1)
 		{
-			add_line(bm, sci, line_nr);
+			gint diff = line_nr - prev_line;
+
+			g_array_append_val(priv->lines, diff);
+			gtk_list_store_append(priv->store, &iter);
+			set_row_text(priv, &iter, sci, line_nr);
+			prev_line = line_nr;
 			line_nr++;
 		}
+		rows_tree(priv);
+	}
+}
+
+
+/* Forgets the bookmarks of doc if it's listed, as it's being closed */
+void ao_bookmark_list_remove(AoBookmarkList *bm, GeanyDocument *doc)
+{
+	AoBookmarkListPrivate *priv = AO_BOOKMARK_LIST_GET_PRIVATE(bm);
+
+	if (doc == priv->doc)
+	{
+		if (priv->enable_bookmarklist)
+			gtk_list_store_clear(priv->store);
+		rows_clear(priv);
+		priv->doc = NULL;
 	}
 }
 
@@ -424,16 +621,38 @@ void ao_bookmark_list_update_marker(AoBookmarkList *bm, GeanyEditor *editor, SCN
 {
 	AoBookmarkListPrivate *priv = AO_BOOKMARK_LIST_GET_PRIVATE(bm);
 
-	if (priv->enable_bookmarklist &&
-		nt->nmhdr.code == SCN_MODIFIED && nt->modificationType == SC_MOD_CHANGEMARKER)
+	if (priv->enable_bookmarklist && editor->document == priv->doc &&
+		nt->nmhdr.code == SCN_MODIFIED)
 	{
-		if (sci_is_marker_set_at_line(editor->sci, nt->line, 1))
+		if (nt->modificationType & SC_MOD_CHANGEMARKER)
 		{
-			add_line(bm, editor->sci, nt->line);
+			if (sci_is_marker_set_at_line(editor->sci, nt->line, 1))
+			{
+				add_line(bm, editor->sci, nt->line);
+			}
+			else
+			{
+				delete_line(bm, nt->line);
+			}
 		}
-		else
+		if (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
 		{
-			delete_line(bm, nt->line);
+			gint line_nr = sci_get_line_from_position(editor->sci, nt->position);
+
+			if (nt->linesAdded != 0)
+				shift_lines(bm, editor->sci, line_nr, nt->linesAdded);
+			else
+			{	/* the contents of a bookmarked line may have changed */
+				gint row = row_after(priv, line_nr - 1);
+
+				if (row < rows_count(priv) && row_get_line(priv, row) == line_nr)
+				{
+					GtkTreeIter iter;
+
+					gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(priv->store), &iter, NULL, row);
+					set_row_text(priv, &iter, editor->sci, line_nr);
+				}
+			}
 		}
 	}
 }
@@ -444,6 +663,9 @@ static void ao_bookmark_list_init(AoBookmarkList *self)
 	AoBookmarkListPrivate *priv = AO_BOOKMARK_LIST_GET_PRIVATE(self);
 
 	priv->page = NULL;
+	priv->lines = g_array_new(FALSE, TRUE, sizeof(gint));
+	rows_clear(priv);
+	priv->doc = NULL;
 }
 
 
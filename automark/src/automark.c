@@ -54,29 +54,321 @@ static gint source_id;
 
 static const gint AUTOMARK_INDICATOR = GEANY_INDICATOR_SEARCH;
 
+/* amount of text indexed per idle callback */
+#define INDEX_CHUNK_SIZE (64 * 1024)
+
+#define INDEX_KEY "automark-index"
+
+enum
+{
+	KB_NEXT_OCCURRENCE,
+	KB_PREV_OCCURRENCE,
+	KB_COUNT
+};
+
+typedef struct
+{
+	gchar *word;
+	guint  count;
+} WordInfo;
+
+typedef struct
+{
+	gint      start;
+	gint      end;
+	WordInfo *info;
+} Occurrence;
+
+/* Per-document list of all words sorted by position. It is built in the
+ * background and afterwards only the text around modifications is indexed
+ * again, so marking is a lookup instead of a search. */
+typedef struct
+{
+	ScintillaObject *sci;
+	GArray          *occurrences;
+	GHashTable      *words;       /* word -> WordInfo */
+	gint             build_pos;   /* end of the indexed text */
+	gboolean         complete;
+	gint             dirty_start; /* range which needs indexing again, -1 if none */
+	gint             dirty_end;
+	guint            build_id;
+	gchar            wordchars[256];
+} OccurrenceIndex;
+
+static WordInfo *
+get_word_info(OccurrenceIndex *idx, const gchar *text, gint len)
+{
+	gchar    *word = g_strndup(text, len);
+	WordInfo *info = g_hash_table_lookup(idx->words, word);
+
+	if (info)
+		g_free(word);
+	else
+	{
+		info = g_slice_new(WordInfo);
+		info->word = word;
+		info->count = 0;
+		g_hash_table_insert(idx->words, word, info);
+	}
+	return info;
+}
+
 static void
-search_mark_in_range(
-	GeanyEditor *editor,
-	gint         flags,
-	struct       Sci_TextToFind *ttf)
+free_word_info(gpointer data)
 {
-	ScintillaObject *sci = editor->sci;
+	WordInfo *info = data;
 
-	while (SSM(sci, SCI_FINDTEXT, flags, (uptr_t)ttf) != -1)
+	g_free(info->word);
+	g_slice_free(WordInfo, info);
+}
+
+static void
+release_occurrences(OccurrenceIndex *idx, guint first, guint n)
+{
+	guint i;
+
+	for (i = first; i < first + n; i++)
 	{
-		gint start = ttf->chrgText.cpMin;
-		gint end = ttf->chrgText.cpMax;
+		WordInfo *info = g_array_index(idx->occurrences, Occurrence, i).info;
 
-		if (end > ttf->chrg.cpMax)
-			break;
+		if (--info->count == 0)
+			g_hash_table_remove(idx->words, info->word);
+	}
+	g_array_remove_range(idx->occurrences, first, n);
+}
 
-		ttf->chrg.cpMin = ttf->chrgText.cpMax;
-		if (end == start)
-			continue;
-		if(SSM(sci, SCI_INDICATORVALUEAT, AUTOMARK_INDICATOR, start))
+/* Collects the words between from and to, which must not be inside a word */
+static void
+scan_words(OccurrenceIndex *idx, GArray *out, const gchar *text, gint from, gint to)
+{
+	gint pos = from;
+
+	while (pos < to)
+	{
+		Occurrence occ;
+
+		if (!idx->wordchars[(guchar) text[pos]])
+		{
+			pos++;
 			continue;
-		SSM(sci, SCI_SETINDICATORCURRENT, AUTOMARK_INDICATOR, 0);
-		SSM(sci, SCI_INDICATORFILLRANGE, start, end - start);
+		}
+		occ.start = pos;
+		while (pos < to && idx->wordchars[(guchar) text[pos]])
+			pos++;
+		occ.end = pos;
+		occ.info = get_word_info(idx, text + occ.start, occ.end - occ.start);
+		occ.info->count++;
+		g_array_append_val(out, occ);
+	}
+}
+
+/* Returns the index of the first occurrence whose start (or end) is at or
+ * after pos. Occurrences don't overlap, so both are sorted. */
+static guint
+find_first_occurrence(GArray *occurrences, gint pos, gboolean by_end)
+{
+	guint low = 0;
+	guint high = occurrences->len;
+
+	while (low < high)
+	{
+		guint       mid = (low + high) / 2;
+		Occurrence *occ = &g_array_index(occurrences, Occurrence, mid);
+
+		if ((by_end ? occ->end : occ->start) < pos)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/* Indexes the text up to at least pos, or everything if pos is -1 */
+static void
+index_build_to(OccurrenceIndex *idx, gint pos)
+{
+	gint         len = sci_get_length(idx->sci);
+	const gchar *text = (const gchar *)SSM(idx->sci, SCI_GETCHARACTERPOINTER, 0, 0);
+
+	if (pos < 0 || pos > len)
+		pos = len;
+	if (idx->build_pos >= pos)
+		return;
+
+	/* don't stop in the middle of a word */
+	while (pos < len && idx->wordchars[(guchar) text[pos]])
+		pos++;
+	scan_words(idx, idx->occurrences, text, idx->build_pos, pos);
+	idx->build_pos = pos;
+	idx->complete = (pos == len);
+}
+
+static void
+index_update(OccurrenceIndex *idx)
+{
+	const gchar *text;
+	guint        first, last;
+	gint         from, to;
+	GArray      *occurrences;
+
+	if (idx->dirty_start < 0)
+		return;
+
+	/* index again from the end of the last untouched word before the change
+	 * up to the first untouched one after it */
+	text = (const gchar *)SSM(idx->sci, SCI_GETCHARACTERPOINTER, 0, 0);
+	first = find_first_occurrence(idx->occurrences, idx->dirty_start, FALSE);
+	last = find_first_occurrence(idx->occurrences, idx->dirty_end, FALSE);
+	from = first > 0 ? g_array_index(idx->occurrences, Occurrence, first - 1).end : 0;
+	to = last < idx->occurrences->len ?
+		g_array_index(idx->occurrences, Occurrence, last).start : idx->build_pos;
+
+	occurrences = g_array_new(FALSE, FALSE, sizeof(Occurrence));
+	scan_words(idx, occurrences, text, from, to);
+	release_occurrences(idx, first, last - first);
+	g_array_insert_vals(idx->occurrences, first, occurrences->data, occurrences->len);
+	g_array_free(occurrences, TRUE);
+	idx->dirty_start = idx->dirty_end = -1;
+}
+
+static gboolean
+index_build_step(gpointer user_data)
+{
+	OccurrenceIndex *idx = user_data;
+
+	index_update(idx);
+	index_build_to(idx, idx->build_pos + INDEX_CHUNK_SIZE);
+	if (idx->complete)
+	{
+		idx->build_id = 0;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Shifts the occurrences after a modification and drops the ones it
+ * touched, they are indexed again on the next lookup. */
+static void
+index_text_changed(OccurrenceIndex *idx, gint pos, gint length, gboolean inserted)
+{
+	gint  change_end = inserted ? pos : pos + length;
+	gint  delta = inserted ? length : -length;
+	guint first, last, i;
+
+	if (pos > idx->build_pos)
+		return;
+
+	/* words touching the change may have been extended or joined */
+	first = find_first_occurrence(idx->occurrences, pos, TRUE);
+	for (last = first; last < idx->occurrences->len; last++)
+	{
+		if (g_array_index(idx->occurrences, Occurrence, last).start > change_end)
+			break;
+	}
+	release_occurrences(idx, first, last - first);
+	for (i = first; i < idx->occurrences->len; i++)
+	{
+		Occurrence *occ = &g_array_index(idx->occurrences, Occurrence, i);
+
+		occ->start += delta;
+		occ->end += delta;
+	}
+
+	if (idx->build_pos >= change_end)
+		idx->build_pos += delta;
+	else
+	{
+		/* the change ate the end of the indexed text, continue building
+		 * after the last intact word */
+		idx->build_pos = first > 0 ? g_array_index(idx->occurrences, Occurrence, first - 1).end : 0;
+		idx->complete = FALSE;
+		if (idx->dirty_start >= idx->build_pos)
+			idx->dirty_start = idx->dirty_end = -1;
+		else
+			idx->dirty_end = MIN(idx->dirty_end, idx->build_pos);
+		if (!idx->build_id)
+			idx->build_id = g_idle_add_full(G_PRIORITY_LOW, index_build_step, idx, NULL);
+		return;
+	}
+
+	if (idx->dirty_start >= 0)
+	{
+		if (idx->dirty_start >= change_end)
+			idx->dirty_start += delta;
+		else if (idx->dirty_start > pos)
+			idx->dirty_start = pos;
+		if (idx->dirty_end >= change_end)
+			idx->dirty_end += delta;
+		else if (idx->dirty_end > pos)
+			idx->dirty_end = pos;
+		idx->dirty_start = MIN(idx->dirty_start, pos);
+		idx->dirty_end = MAX(idx->dirty_end, inserted ? pos + length : pos);
+	}
+	else
+	{
+		idx->dirty_start = pos;
+		idx->dirty_end = inserted ? pos + length : pos;
+	}
+}
+
+static void
+free_index(gpointer data)
+{
+	OccurrenceIndex *idx = data;
+
+	if (idx->build_id)
+		g_source_remove(idx->build_id);
+	g_array_free(idx->occurrences, TRUE);
+	g_hash_table_destroy(idx->words);
+	g_free(idx);
+}
+
+static OccurrenceIndex *
+get_index(ScintillaObject *sci)
+{
+	OccurrenceIndex *idx = g_object_get_data(G_OBJECT(sci), INDEX_KEY);
+
+	if (!idx)
+	{
+		const gchar *wordchars = GEANY_WORDCHARS;
+		gint         i;
+#ifdef SCI_GETWORDCHARS
+		gchar        buf[257] = {0};
+
+		if (SSM(sci, SCI_GETWORDCHARS, 0, (sptr_t)buf) > 0)
+			wordchars = buf;
+#endif
+		idx = g_new0(OccurrenceIndex, 1);
+		idx->sci = sci;
+		idx->occurrences = g_array_new(FALSE, FALSE, sizeof(Occurrence));
+		idx->words = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free_word_info);
+		idx->dirty_start = idx->dirty_end = -1;
+		for (i = 0; wordchars[i]; i++)
+			idx->wordchars[(guchar) wordchars[i]] = TRUE;
+		/* like Scintilla, treat non-ASCII characters as word characters */
+		for (i = 0x80; i < 256; i++)
+			idx->wordchars[i] = TRUE;
+		idx->build_id = g_idle_add_full(G_PRIORITY_LOW, index_build_step, idx, NULL);
+		g_object_set_data_full(G_OBJECT(sci), INDEX_KEY, idx, free_index);
+	}
+	return idx;
+}
+
+static void
+mark_in_range(OccurrenceIndex *idx, WordInfo *info, gint start, gint end)
+{
+	guint i;
+
+	SSM(idx->sci, SCI_SETINDICATORCURRENT, AUTOMARK_INDICATOR, 0);
+	for (i = find_first_occurrence(idx->occurrences, start, TRUE);
+		 i < idx->occurrences->len; i++)
+	{
+		Occurrence *occ = &g_array_index(idx->occurrences, Occurrence, i);
+
+		if (occ->start > end)
+			break;
+		if (occ->info == info)
+			SSM(idx->sci, SCI_INDICATORFILLRANGE, occ->start, occ->end - occ->start);
 	}
 }
 
@@ -107,8 +399,8 @@ automark(gpointer user_data)
 	ScintillaObject    *sci = editor->sci;
 	gchar               text[GEANY_MAX_WORD_LENGTH];
 	static gchar        text_cache[GEANY_MAX_WORD_LENGTH] = {0};
-	gint                match_flag = SCFIND_MATCHCASE | SCFIND_WHOLEWORD;
-	struct              Sci_TextToFind ttf;
+	OccurrenceIndex    *idx;
+	WordInfo           *info;
 
 	source_id = 0;
 
@@ -125,16 +417,13 @@ automark(gpointer user_data)
 	if (!*text)
 	{
 		editor_indicator_clear(editor, AUTOMARK_INDICATOR);
+		text_cache[0] = 0;
 		return FALSE;
 	}
 
-	if (editor_cache != editor || strcmp(text, text_cache) != 0)
-	{
-		editor_indicator_clear(editor, AUTOMARK_INDICATOR);
-		strcpy(text_cache, text);
-		editor_cache = editor;
-	}
-	
+	idx = get_index(sci);
+	index_update(idx);
+
 	gint vis_first = SSM(sci, SCI_GETFIRSTVISIBLELINE, 0, 0);
 	gint doc_first = SSM(sci, SCI_DOCLINEFROMVISIBLE, vis_first, 0);
 	gint vis_last  = SSM(sci, SCI_LINESONSCREEN, 0, 0) + vis_first;
@@ -142,15 +431,84 @@ automark(gpointer user_data)
 	gint start     = SSM(sci, SCI_POSITIONFROMLINE,   doc_first, 0);
 	gint end       = SSM(sci, SCI_GETLINEENDPOSITION, doc_last, 0);
 
-	ttf.chrg.cpMin = start;
-	ttf.chrg.cpMax = end;
-	ttf.lpstrText  = text;
+	/* the visible part is needed now, the rest is indexed in the background */
+	index_build_to(idx, end);
+	info = g_hash_table_lookup(idx->words, text);
+
+	if (editor_cache != editor || strcmp(text, text_cache) != 0)
+	{
+		editor_indicator_clear(editor, AUTOMARK_INDICATOR);
+		strcpy(text_cache, text);
+		editor_cache = editor;
+		if (info && idx->complete)
+			ui_set_statusbar(FALSE, _("%u occurrences of \"%s\""), info->count, text);
+	}
 
-	search_mark_in_range(editor, match_flag, &ttf);
+	if (info)
+		mark_in_range(idx, info, start, end);
 
 	return FALSE;
 }
 
+/* Moves the caret to the next or previous occurrence of the current word */
+static void
+goto_occurrence(gboolean forward)
+{
+	GeanyDocument   *doc = document_get_current();
+	ScintillaObject *sci;
+	OccurrenceIndex *idx;
+	WordInfo        *info;
+	gchar            text[GEANY_MAX_WORD_LENGTH];
+	gint             pos;
+	guint            i, n;
+
+	if (!DOC_VALID(doc))
+		return;
+	sci = doc->editor->sci;
+	get_current_word(sci, text, sizeof(text));
+	if (!*text)
+		return;
+
+	idx = get_index(sci);
+	index_update(idx);
+	index_build_to(idx, -1);
+	info = g_hash_table_lookup(idx->words, text);
+	if (!info)
+		return;
+
+	pos = sci_get_current_position(sci);
+	n = idx->occurrences->len;
+	i = find_first_occurrence(idx->occurrences, pos, TRUE);
+	/* skip the word under the caret and wrap around at the ends */
+	for (; n > 0; n--)
+	{
+		Occurrence *occ;
+
+		if (forward)
+			i = (i + 1) % idx->occurrences->len;
+		else
+			i = (i + idx->occurrences->len - 1) % idx->occurrences->len;
+		occ = &g_array_index(idx->occurrences, Occurrence, i);
+		if (occ->info == info)
+		{
+			sci_set_current_position(sci, occ->start, TRUE);
+			return;
+		}
+	}
+}
+
+static void
+on_next_occurrence(G_GNUC_UNUSED guint key_id)
+{
+	goto_occurrence(TRUE);
+}
+
+static void
+on_prev_occurrence(G_GNUC_UNUSED guint key_id)
+{
+	goto_occurrence(FALSE);
+}
+
 static gboolean
 on_editor_notify(
 	GObject        *obj,
@@ -158,7 +516,16 @@ on_editor_notify(
 	SCNotification *nt,
 	gpointer        user_data)
 {
-	if (SCN_UPDATEUI == nt->nmhdr.code)
+	if (SCN_MODIFIED == nt->nmhdr.code &&
+		(nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)))
+	{
+		OccurrenceIndex *idx = g_object_get_data(G_OBJECT(editor->sci), INDEX_KEY);
+
+		if (idx)
+			index_text_changed(idx, nt->position, nt->length,
+				(nt->modificationType & SC_MOD_INSERTTEXT) != 0);
+	}
+	else if (SCN_UPDATEUI == nt->nmhdr.code)
 	{
 		/* if events are too intensive - remove old callback */
 		if (source_id)
@@ -177,14 +544,27 @@ PluginCallback plugin_callbacks[] =
 void
 plugin_init(G_GNUC_UNUSED GeanyData *data)
 {
+	GeanyKeyGroup *key_group;
+
 	source_id = 0;
+
+	key_group = plugin_set_key_group(geany_plugin, "automark", KB_COUNT, NULL);
+	keybindings_set_item(key_group, KB_NEXT_OCCURRENCE, on_next_occurrence,
+		0, 0, "next_occurrence", _("Go to next occurrence"), NULL);
+	keybindings_set_item(key_group, KB_PREV_OCCURRENCE, on_prev_occurrence,
+		0, 0, "prev_occurrence", _("Go to previous occurrence"), NULL);
 }
 
 void
 plugin_cleanup(void)
 {
+	guint i;
+
 	if (source_id)
 		g_source_remove(source_id);
+
+	foreach_document(i)
+		g_object_set_data(G_OBJECT(documents[i]->editor->sci), INDEX_KEY, NULL);
 }
 
 void
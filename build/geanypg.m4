@@ -3,10 +3,10 @@ AC_DEFUN([GP_CHECK_GEANYPG],
     GP_ARG_DISABLE([geanypg], [auto])
     if test "$enable_geanypg" = "auto"; then
         enable_geanypg=no
-        m4_ifdef([AM_PATH_GPGME], [AM_PATH_GPGME(, enable_geanypg=auto)])
+        m4_ifdef([AM_PATH_GPGME_PTHREAD], [AM_PATH_GPGME_PTHREAD(1.1.7, enable_geanypg=auto)])
     elif test "$enable_geanypg" = "yes"; then
-        m4_ifdef([AM_PATH_GPGME],
-                [AM_PATH_GPGME(,, [AC_MSG_ERROR([Could not find GPGME. Please define GPGME_CFLAGS and GPGME_LIBS if it is installed.])])],
+        m4_ifdef([AM_PATH_GPGME_PTHREAD],
+                [AM_PATH_GPGME_PTHREAD(1.1.7,, [AC_MSG_ERROR([Could not find GPGME. Please define GPGME_PTHREAD_CFLAGS and GPGME_PTHREAD_LIBS if it is installed.])])],
                 [AC_MSG_ERROR([Could not find GPGME. Please install it])])
 
     fi
@@ -22,6 +22,9 @@ AC_DEFUN([GP_CHECK_GEANYPG],
     # necessary for gpgme
     AC_SYS_LARGEFILE
 
+    # operations run in a worker thread
+    GP_CHECK_PLUGIN_DEPS([geanypg], [GEANYPG], [gthread-2.0])
+
     GP_COMMIT_PLUGIN_STATUS([GeanyPG])
     AC_CONFIG_FILES([
         geanypg/Makefile
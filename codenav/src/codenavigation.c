@@ -29,6 +29,7 @@
 #include "codenavigation.h"
 #include "switch_head_impl.h"
 #include "goto_file.h"
+#include "file_index.h"
 
 /************************* Plugin utilities ***************************/
 
@@ -66,6 +67,14 @@ GeanyData		*geany_data;
 GeanyFunctions	*geany_functions;
 
 static GtkListStore *list_store;	/* for settings dialog */
+static GtkWidget *ignore_entry;		/* for settings dialog */
+
+/* Files and directories not indexed for Go to File */
+static gchar **ignore_patterns = NULL;
+static const gchar *default_ignore_patterns[] =
+{
+	"*.o", "*.obj", "*.a", "*.so", "*.lo", "*.la", "*.pyc", "*.class", "*~", NULL
+};
 
 
 /**************************** Prototypes ******************************/
@@ -73,6 +82,9 @@ static GtkListStore *list_store;	/* for settings dialog */
 GtkWidget*
 config_widget(void);
 
+static GtkWidget*
+goto_file_config_widget(void);
+
 static void 
 load_configuration();
 
@@ -91,6 +103,24 @@ on_configure_cell_edited(GtkCellRendererText* text, gchar* arg1, gchar* arg2, gp
 static void
 on_configure_response(GtkDialog *dialog, gint response, gpointer user_data);
 
+static void
+on_project_open(GObject *obj, GKeyFile *config, gpointer user_data);
+
+static void
+on_project_save(GObject *obj, GKeyFile *config, gpointer user_data);
+
+static void
+on_project_close(GObject *obj, gpointer user_data);
+
+/* Keep the file index in sync with the open project */
+PluginCallback plugin_callbacks[] =
+{
+	{ "project-open", (GCallback) &on_project_open, TRUE, NULL },
+	{ "project-save", (GCallback) &on_project_save, TRUE, NULL },
+	{ "project-close", (GCallback) &on_project_close, TRUE, NULL },
+	{ NULL, NULL, FALSE, NULL }
+};
+
 /***************************** Functions ******************************/
 
 /**
@@ -106,6 +136,7 @@ void plugin_init(GeanyData *data)
 	/* Initialize the features */
 	switch_head_impl_init();
 	goto_file_init();
+	file_index_init();
 }
 
 /**
@@ -142,11 +173,17 @@ static void load_configuration()
 		}
 		else
 			fill_languages_list((const gchar**) impl_list, (const gchar**) head_list, head_list_len);
+
+		ignore_patterns = g_key_file_get_string_list(config, "goto_file", "ignore_patterns", NULL, NULL);
 	}
 	else {
 		log_debug("Fresh configuration");
 		fill_default_languages_list();
 	}
+
+	if ( ignore_patterns == NULL )
+		ignore_patterns = g_strdupv((gchar**) default_ignore_patterns);
+	file_index_set_ignore_patterns(ignore_patterns);
 	
 	
 	/* Freeing memory */
@@ -185,6 +222,9 @@ GtkWidget *plugin_configure(GtkDialog *dialog)
 	/* Switch header/implementation widget */
 	gtk_box_pack_start(GTK_BOX(vbox), config_widget(), TRUE, TRUE, 0);
 
+	/* Go to File widget */
+	gtk_box_pack_start(GTK_BOX(vbox), goto_file_config_widget(), FALSE, FALSE, 0);
+
 	gtk_widget_show_all(vbox);
 
 	/* Connect a callback for when the user clicks a dialog button */
@@ -204,8 +244,54 @@ void plugin_cleanup(void)
 	log_func();
 
 	/* Cleanup the features */
+	file_index_cleanup();
 	goto_file_cleanup();
 	switch_head_impl_cleanup();
+
+	g_strfreev(ignore_patterns);
+	ignore_patterns = NULL;
+}
+
+/**
+ * @brief	Callback called when a project is opened.
+ * @param	obj			not used
+ * @param	config		not used
+ * @param	user_data	not used
+ * @return	void
+ *
+ */
+static void
+on_project_open(GObject *obj, GKeyFile *config, gpointer user_data)
+{
+	file_index_update(FALSE);
+}
+
+/**
+ * @brief	Callback called when a project is saved, index it again to pick
+ * 			up the changes in unmonitored directories.
+ * @param	obj			not used
+ * @param	config		not used
+ * @param	user_data	not used
+ * @return	void
+ *
+ */
+static void
+on_project_save(GObject *obj, GKeyFile *config, gpointer user_data)
+{
+	file_index_update(TRUE);
+}
+
+/**
+ * @brief	Callback called when a project is closed
+ * @param	obj			not used
+ * @param	user_data	not used
+ * @return	void
+ *
+ */
+static void
+on_project_close(GObject *obj, gpointer user_data)
+{
+	file_index_clear();
 }
 
 /**
@@ -285,6 +371,13 @@ on_configure_response(GtkDialog* dialog, gint response, gpointer user_data)
 								(const gchar * const*)impl_list, list_len - empty_lines);
 	g_key_file_set_string_list(config, "switch_head_impl", "headers_list", 
 								(const gchar * const*)head_list, list_len - empty_lines);
+
+	/* ignore patterns, separated by semicolons in the entry */
+	g_strfreev(ignore_patterns);
+	ignore_patterns = g_strsplit(gtk_entry_get_text(GTK_ENTRY(ignore_entry)), ";", -1);
+	g_key_file_set_string_list(config, "goto_file", "ignore_patterns",
+								(const gchar * const*)ignore_patterns, g_strv_length(ignore_patterns));
+	file_index_set_ignore_patterns(ignore_patterns);
 	
 	/* Try to create directory if not exists */
 	if (! g_file_test(config_dir, G_FILE_TEST_IS_DIR) && utils_mkdir(config_dir, TRUE) != 0)
@@ -302,6 +395,9 @@ on_configure_response(GtkDialog* dialog, gint response, gpointer user_data)
 
 	/* Replace the current (runtime) languages list */
 	fill_languages_list((const gchar**)impl_list, (const gchar**)head_list, list_len - empty_lines);
+
+	/* The indexed files depend on the languages and on the ignore patterns */
+	file_index_update(TRUE);
 	
 	/* Freeing memory */
 	for ( i=0; i < list_len; i++ ) {
@@ -467,6 +563,39 @@ config_widget(void)
 	return frame;
 }
 
+/**
+ * @brief 	The configuration widget of Go to File
+ * 
+ * @return	The configuration widget
+ * 
+ */
+static GtkWidget*
+goto_file_config_widget(void)
+{
+	GtkWidget *frame, *vbox, *label;
+	gchar *text;
+
+	log_func();
+
+	frame = gtk_frame_new(_("Go to File"));
+
+	vbox = gtk_vbox_new(FALSE, 0);
+	gtk_container_add(GTK_CONTAINER(frame), vbox);
+
+	label = gtk_label_new(_("Files and directories to ignore in the project " \
+							"(patterns separated by semicolons):"));
+	gtk_misc_set_alignment(GTK_MISC(label), 0, 0.5);
+	gtk_box_pack_start(GTK_BOX(vbox), label, FALSE, FALSE, 6);
+
+	ignore_entry = gtk_entry_new();
+	text = g_strjoinv(";", ignore_patterns);
+	gtk_entry_set_text(GTK_ENTRY(ignore_entry), text);
+	g_free(text);
+	gtk_box_pack_start(GTK_BOX(vbox), ignore_entry, FALSE, FALSE, 0);
+
+	return frame;
+}
+
  /**
  * @brief 	Callback for adding a language in the configuration dialog
  * @param 	button	the button, not used here
@@ -0,0 +1,626 @@
+/*
+ *  file_index.c - this file is part of "codenavigation", which is
+ *  part of the "geany-plugins" project.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+	#include "config.h"
+#endif
+#include <geanyplugin.h>
+#include <gio/gio.h>
+
+#include "file_index.h"
+#include "switch_head_impl.h"
+#include "utils.h"
+
+/* Number of directory entries handled per idle callback */
+#define CRAWL_BATCH_SIZE 200
+
+/* Watching directories uses up inotify watches, don't take them all */
+#define MAX_DIR_MONITORS 2000
+
+/******************* Global variables for the feature *****************/
+
+static gchar* root = NULL;				/* locale encoding */
+static GPtrArray* files = NULL;			/* paths relative to root */
+static GHashTable* file_positions = NULL;	/* path in files -> its index + 1 */
+static GHashTable* basenames = NULL;	/* name without extension -> GPtrArray of paths */
+static GHashTable* extensions = NULL;	/* extensions worth indexing */
+static GHashTable* monitors = NULL;		/* directory path -> GFileMonitor */
+static GQueue* pending_dirs = NULL;		/* directories still to be scanned */
+static GDir* current_dir = NULL;
+static gchar* current_dir_path = NULL;
+static guint crawl_source_id = 0;
+static guint generation = 0;			/* changes each time files is modified */
+static GPtrArray* ignore_specs = NULL;	/* GPatternSpec of the files to skip */
+
+/**************************** Prototypes ******************************/
+
+static gboolean
+crawl_step(gpointer data);
+
+static void
+on_dir_changed(GFileMonitor* monitor, GFile* file, GFile* other_file,
+				GFileMonitorEvent event_type, gpointer user_data);
+
+/***************************** Functions ******************************/
+
+/**
+ * @brief	Initialization function called in plugin_init
+ * @param	void
+ * @return	void
+ *
+ */
+void
+file_index_init(void)
+{
+	log_func();
+
+	files = g_ptr_array_new_with_free_func(g_free);
+	/* the keys are the strings of files */
+	file_positions = g_hash_table_new(g_str_hash, g_str_equal);
+	basenames = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+										(GDestroyNotify)(&g_ptr_array_unref));
+	extensions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	monitors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+										(GDestroyNotify)(&g_object_unref));
+	pending_dirs = g_queue_new();
+	if(ignore_specs == NULL)
+		ignore_specs = g_ptr_array_new_with_free_func((GDestroyNotify)(&g_pattern_spec_free));
+
+	file_index_update(TRUE);
+}
+
+/**
+ * @brief	Stop scanning and forget everything that was indexed
+ * @param	void
+ * @return	void
+ *
+ */
+void
+file_index_clear(void)
+{
+	if(crawl_source_id != 0)
+	{
+		g_source_remove(crawl_source_id);
+		crawl_source_id = 0;
+	}
+	if(current_dir != NULL)
+	{
+		g_dir_close(current_dir);
+		current_dir = NULL;
+	}
+	g_free(current_dir_path);
+	current_dir_path = NULL;
+
+	while(!g_queue_is_empty(pending_dirs))
+		g_free(g_queue_pop_head(pending_dirs));
+
+	g_hash_table_remove_all(monitors);
+	g_hash_table_remove_all(basenames);
+	g_hash_table_remove_all(extensions);
+	g_hash_table_remove_all(file_positions);
+	g_ptr_array_set_size(files, 0);
+	generation++;
+
+	g_free(root);
+	root = NULL;
+}
+
+/**
+ * @brief	Cleanup function called in plugin_cleanup
+ * @param	void
+ * @return	void
+ *
+ */
+void
+file_index_cleanup(void)
+{
+	log_func();
+
+	file_index_clear();
+	g_hash_table_destroy(monitors);
+	g_hash_table_destroy(basenames);
+	g_hash_table_destroy(extensions);
+	g_hash_table_destroy(file_positions);
+	g_ptr_array_free(files, TRUE);
+	g_ptr_array_free(ignore_specs, TRUE);
+	ignore_specs = NULL;
+	g_queue_free(pending_dirs);
+}
+
+/**
+ * @brief	Set the glob patterns of the files and directories not to index,
+ * 			e.g. "*.o" or "build". The index has to be updated afterwards.
+ * @param	patterns	NULL-terminated array of patterns, may be NULL
+ * @return	void
+ *
+ */
+void
+file_index_set_ignore_patterns(gchar** patterns)
+{
+	gchar** pattern;
+
+	if(ignore_specs == NULL)
+		ignore_specs = g_ptr_array_new_with_free_func((GDestroyNotify)(&g_pattern_spec_free));
+	else
+		g_ptr_array_set_size(ignore_specs, 0);
+
+	for(pattern = patterns ; pattern != NULL && *pattern != NULL ; pattern++)
+	{
+		gchar* stripped = g_strstrip(g_strdup(*pattern));
+
+		if(stripped[0] != '\0')
+			g_ptr_array_add(ignore_specs, g_pattern_spec_new(stripped));
+		g_free(stripped);
+	}
+}
+
+/**
+ * @brief	Whether a file or directory matches one of the ignore patterns.
+ * 			Both the name and the path relative to the root are tried.
+ * @param	path	the path (locale encoding)
+ * @return	gboolean
+ *
+ */
+static gboolean
+is_ignored(const gchar* path)
+{
+	const gchar* name = strrchr(path, G_DIR_SEPARATOR);
+	const gchar* relative = path + strlen(root);
+	guint i;
+
+	name = (name != NULL) ? name + 1 : path;
+
+	/* skip hidden files and directories like .git */
+	if(name[0] == '.')
+		return TRUE;
+
+	while(*relative == G_DIR_SEPARATOR)
+		relative++;
+
+	for(i = 0 ; i < ignore_specs->len ; i++)
+	{
+		GPatternSpec* spec = g_ptr_array_index(ignore_specs, i);
+
+		if(g_pattern_match_string(spec, name) || g_pattern_match_string(spec, relative))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * @brief	Get the base directory of the current project
+ * @param	void
+ * @return	gchar*	newly-allocated path in locale encoding, or NULL
+ *
+ */
+static gchar*
+get_project_root(void)
+{
+	GeanyProject* project = geany->app->project;
+	gchar* base_path;
+	gchar* locale_path;
+
+	if(project == NULL || project->base_path == NULL || project->base_path[0] == '\0')
+		return NULL;
+
+	/* base_path may be relative to the project file */
+	if(g_path_is_absolute(project->base_path))
+		base_path = g_strdup(project->base_path);
+	else
+	{
+		gchar* dir = g_path_get_dirname(project->file_name);
+		base_path = g_build_filename(dir, project->base_path, NULL);
+		g_free(dir);
+	}
+
+	locale_path = utils_get_locale_from_utf8(base_path);
+	g_free(base_path);
+	return locale_path;
+}
+
+/**
+ * @brief	Start scanning the current project in the background
+ * @param	force	rebuild even if the project root didn't change
+ * @return	void
+ *
+ */
+void
+file_index_update(gboolean force)
+{
+	gchar* new_root = get_project_root();
+	GSList* iter_lang;
+	GSList* iter_ext;
+
+	if(!force && utils_str_equal(new_root, root))
+	{
+		g_free(new_root);
+		return;
+	}
+
+	file_index_clear();
+	root = new_root;
+	if(root == NULL || !g_file_test(root, G_FILE_TEST_IS_DIR))
+		return;
+
+	log_debug("indexing \"%s\"", root);
+
+	/* only files of the configured languages are of interest */
+	for(iter_lang = switch_head_impl_get_languages() ; iter_lang != NULL ; iter_lang = iter_lang->next)
+	{
+		Language* lang = (Language*)(iter_lang->data);
+
+		for(iter_ext = lang->head_extensions ; iter_ext != NULL ; iter_ext = iter_ext->next)
+			g_hash_table_insert(extensions, g_strdup(iter_ext->data), GINT_TO_POINTER(TRUE));
+		for(iter_ext = lang->impl_extensions ; iter_ext != NULL ; iter_ext = iter_ext->next)
+			g_hash_table_insert(extensions, g_strdup(iter_ext->data), GINT_TO_POINTER(TRUE));
+	}
+
+	g_queue_push_tail(pending_dirs, g_strdup(root));
+	crawl_source_id = g_idle_add_full(G_PRIORITY_LOW, crawl_step, NULL, NULL);
+}
+
+/**
+ * @brief	Extern function to get the indexed directory.
+ * @param	void
+ * @return	const gchar*	root of the index or NULL
+ *
+ */
+const gchar*
+file_index_get_root(void)
+{
+	return root;
+}
+
+/**
+ * @brief	Extern function telling whether the scan is finished.
+ * @param	void
+ * @return	gboolean
+ *
+ */
+gboolean
+file_index_is_complete(void)
+{
+	return root != NULL && crawl_source_id == 0;
+}
+
+/**
+ * @brief	Extern function to get all the indexed files.
+ * @param	void
+ * @return	GPtrArray*	paths relative to the root (locale encoding), owned
+ * 			by the index. The order changes when files are removed.
+ *
+ */
+GPtrArray*
+file_index_get_files(void)
+{
+	return files;
+}
+
+/**
+ * @brief	Extern function telling when the file list changed : the value
+ * 			returned is different after each modification.
+ * @param	void
+ * @return	guint
+ *
+ */
+guint
+file_index_get_generation(void)
+{
+	return generation;
+}
+
+/**
+ * @brief	Look up the files having the given name without extension.
+ * @param	basename_no_extension	e.g. : "file" for "/home/me/file.cpp"
+ * @return	GPtrArray*	array of paths owned by the index, or NULL
+ *
+ */
+GPtrArray*
+file_index_lookup_basename(const gchar* basename_no_extension)
+{
+	if(root == NULL)
+		return NULL;
+	return g_hash_table_lookup(basenames, basename_no_extension);
+}
+
+/**
+ * @brief	Get the path relative to the root of the index
+ * @param	path	the path (locale encoding), below the root
+ * @return	const gchar*	pointer inside path
+ *
+ */
+static const gchar*
+get_relative_path(const gchar* path)
+{
+	const gchar* relative = path + strlen(root);
+
+	while(*relative == G_DIR_SEPARATOR)
+		relative++;
+	return relative;
+}
+
+/**
+ * @brief	Add a file to the index, and to the names lookup table if its
+ * 			extension is handled
+ * @param	path	the file path (locale encoding)
+ * @return	void
+ *
+ */
+static void
+add_file(const gchar* path)
+{
+	gchar* basename;
+	gchar* extension;
+	gchar* key;
+	gchar* relative;
+	GPtrArray* paths;
+
+	/* a file may be replaced without being deleted first */
+	if(g_hash_table_lookup(file_positions, get_relative_path(path)) != NULL)
+		return;
+
+	relative = g_strdup(get_relative_path(path));
+	g_ptr_array_add(files, relative);
+	g_hash_table_insert(file_positions, relative, GUINT_TO_POINTER(files->len));
+	generation++;
+
+	basename = g_path_get_basename(path);
+	extension = get_extension(basename);
+	if(extension == NULL || !g_hash_table_lookup(extensions, extension))
+		goto free_mem;
+
+	key = copy_and_remove_extension(basename);
+	paths = g_hash_table_lookup(basenames, key);
+	if(paths == NULL)
+	{
+		paths = g_ptr_array_new_with_free_func(g_free);
+		g_hash_table_insert(basenames, key, paths);
+	}
+	else
+		g_free(key);
+	g_ptr_array_add(paths, g_strdup(path));
+
+free_mem:
+	g_free(extension);
+	g_free(basename);
+}
+
+/**
+ * @brief	Remove the file at the given position of the index
+ * @param	i	position in files
+ * @return	void
+ *
+ */
+static void
+remove_file_at(guint i)
+{
+	const gchar* relative = g_ptr_array_index(files, i);
+	gchar* path = g_build_filename(root, relative, NULL);
+	gchar* basename = g_path_get_basename(path);
+	gchar* key = copy_and_remove_extension(basename);
+	GPtrArray* paths = g_hash_table_lookup(basenames, key);
+	guint last = files->len - 1;
+
+	if(paths != NULL)
+	{
+		guint j;
+
+		for(j = 0 ; j < paths->len ; j++)
+		{
+			if(utils_str_equal(g_ptr_array_index(paths, j), path))
+			{
+				g_ptr_array_remove_index_fast(paths, j);
+				break;
+			}
+		}
+		if(paths->len == 0)
+			g_hash_table_remove(basenames, key);
+	}
+
+	/* the last file takes the place of the removed one */
+	g_hash_table_remove(file_positions, relative);
+	if(i != last)
+		g_hash_table_insert(file_positions, g_ptr_array_index(files, last), GUINT_TO_POINTER(i + 1));
+	g_ptr_array_remove_index_fast(files, i);
+	generation++;
+
+	g_free(key);
+	g_free(basename);
+	g_free(path);
+}
+
+/**
+ * @brief	Remove a file, or all files below a directory, from the index
+ * @param	path	the file or directory path (locale encoding)
+ * @return	void
+ *
+ */
+static void
+remove_path(const gchar* path)
+{
+	GHashTableIter iter;
+	gpointer value;
+	gchar* dir_prefix;
+	const gchar* relative = get_relative_path(path);
+	gsize relative_len;
+	guint i;
+
+	value = g_hash_table_lookup(file_positions, relative);
+	if(value != NULL)
+	{
+		remove_file_at(GPOINTER_TO_UINT(value) - 1);
+		return;
+	}
+
+	/* not a file, a directory: look for the files below it */
+	relative_len = strlen(relative);
+	for(i = 0 ; i < files->len ; )
+	{
+		const gchar* p = g_ptr_array_index(files, i);
+
+		if(strncmp(p, relative, relative_len) == 0 && p[relative_len] == G_DIR_SEPARATOR)
+			remove_file_at(i);
+		else
+			i++;
+	}
+
+	dir_prefix = g_strconcat(path, G_DIR_SEPARATOR_S, NULL);
+	g_hash_table_iter_init(&iter, monitors);
+	while(g_hash_table_iter_next(&iter, &value, NULL))
+	{
+		if(utils_str_equal(value, path) || g_str_has_prefix(value, dir_prefix))
+			g_hash_table_iter_remove(&iter);
+	}
+	g_free(dir_prefix);
+}
+
+/**
+ * @brief	Watch a directory for files being added or removed
+ * @param	path	the directory path (locale encoding)
+ * @return	void
+ *
+ */
+static void
+monitor_dir(const gchar* path)
+{
+	GFile* file;
+	GFileMonitor* monitor;
+
+	if(g_hash_table_size(monitors) >= MAX_DIR_MONITORS ||
+		g_hash_table_lookup(monitors, path) != NULL)
+		return;
+
+	file = g_file_new_for_path(path);
+	monitor = g_file_monitor_directory(file, G_FILE_MONITOR_NONE, NULL, NULL);
+	g_object_unref(file);
+	if(monitor == NULL)
+		return;
+
+	g_signal_connect(monitor, "changed", G_CALLBACK(on_dir_changed), NULL);
+	g_hash_table_insert(monitors, g_strdup(path), monitor);
+}
+
+/**
+ * @brief	Idle callback scanning a bunch of directory entries at a time
+ * @param	data	not used
+ * @return	gboolean	FALSE when everything has been scanned
+ *
+ */
+static gboolean
+crawl_step(gpointer data)
+{
+	gint budget = CRAWL_BATCH_SIZE;
+
+	while(budget-- > 0)
+	{
+		const gchar* name;
+		gchar* path;
+
+		if(current_dir == NULL)
+		{
+			g_free(current_dir_path);
+			current_dir_path = g_queue_pop_head(pending_dirs);
+			if(current_dir_path == NULL)
+			{
+				log_debug("indexing done");
+				crawl_source_id = 0;
+				return FALSE;
+			}
+			current_dir = g_dir_open(current_dir_path, 0, NULL);
+			if(current_dir == NULL)
+				continue;
+			monitor_dir(current_dir_path);
+		}
+
+		name = g_dir_read_name(current_dir);
+		if(name == NULL)
+		{
+			g_dir_close(current_dir);
+			current_dir = NULL;
+			continue;
+		}
+
+		path = g_build_filename(current_dir_path, name, NULL);
+		if(is_ignored(path))
+		{
+			g_free(path);
+			continue;
+		}
+		if(g_file_test(path, G_FILE_TEST_IS_DIR))
+		{
+			/* don't follow links to directories, they may loop */
+			if(!g_file_test(path, G_FILE_TEST_IS_SYMLINK))
+			{
+				g_queue_push_tail(pending_dirs, path);
+				continue;
+			}
+		}
+		else
+			add_file(path);
+		g_free(path);
+	}
+
+	return TRUE;
+}
+
+/**
+ * @brief	Keep the index up to date when files are created or deleted
+ * @param	monitor, file, other_file, event_type	see GFileMonitor::changed
+ * @param	user_data	not used
+ * @return	void
+ *
+ */
+static void
+on_dir_changed(GFileMonitor* monitor, GFile* file, GFile* other_file,
+				GFileMonitorEvent event_type, gpointer user_data)
+{
+	gchar* path = g_file_get_path(file);
+
+	if(path == NULL)
+		return;
+
+	if(root == NULL || is_ignored(path))
+		goto free_mem;
+
+	switch(event_type)
+	{
+		case G_FILE_MONITOR_EVENT_CREATED:
+			if(g_file_test(path, G_FILE_TEST_IS_DIR))
+			{
+				if(!g_file_test(path, G_FILE_TEST_IS_SYMLINK))
+				{
+					g_queue_push_tail(pending_dirs, g_strdup(path));
+					if(crawl_source_id == 0)
+						crawl_source_id = g_idle_add_full(G_PRIORITY_LOW, crawl_step, NULL, NULL);
+				}
+			}
+			else
+				add_file(path);
+			break;
+
+		case G_FILE_MONITOR_EVENT_DELETED:
+			remove_path(path);
+			break;
+
+		default:
+			break;
+	}
+
+free_mem:
+	g_free(path);
+}
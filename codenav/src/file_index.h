@@ -0,0 +1,69 @@
+/*
+ *      file_index.h - this file is part of "codenavigation", which is
+ *      part of the "geany-plugins" project.
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef FILE_INDEX_H
+#define FILE_INDEX_H
+
+#include "codenavigation.h"
+
+/* Initialization */
+void
+file_index_init(void);
+
+/* Cleanup */
+void
+file_index_cleanup(void);
+
+/* Forget the indexed files, e.g. when the project is closed */
+void
+file_index_clear(void);
+
+/* (Re)build the index in the background if the project root changed,
+ * or unconditionally if force is TRUE */
+void
+file_index_update(gboolean force);
+
+/* Root directory of the index (locale encoding), or NULL if there is none */
+const gchar*
+file_index_get_root(void);
+
+/* Set the glob patterns of the files and directories not to index */
+void
+file_index_set_ignore_patterns(gchar** patterns);
+
+/* Whether the whole tree has been scanned */
+gboolean
+file_index_is_complete(void);
+
+/* Paths (locale encoding, relative to the root) of all the indexed files.
+ * Owned by the index. */
+GPtrArray*
+file_index_get_files(void);
+
+/* Changes each time the list returned by file_index_get_files() changes */
+guint
+file_index_get_generation(void);
+
+/* Paths (locale encoding) of the indexed files whose name without extension
+ * is basename_no_extension, or NULL. Owned by the index. */
+GPtrArray*
+file_index_lookup_basename(const gchar* basename_no_extension);
+
+#endif /* FILE_INDEX_H */
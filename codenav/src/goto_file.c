@@ -25,10 +25,42 @@
 #include <geanyplugin.h>
 
 #include "goto_file.h"
+#include "file_index.h"
 #include "utils.h"
 
 #define MAX_FILENAME_LENGTH 255
 
+/* Only the best matches are put in the list, whatever the size of the project */
+#define MAX_RESULTS 100
+
+/* Columns of the results list */
+enum
+{
+	RESULT_COLUMN_DISPLAY = 0,	/* UTF-8, for the view */
+	RESULT_COLUMN_PATH,			/* locale encoding, relative to the index root */
+	RESULT_NB_COLUMNS
+};
+
+/******************* Data types for the feature *****************/
+
+typedef struct
+{
+	guint index;	/* in file_index_get_files() */
+	gint score;
+} FuzzyMatch;
+
+/* State of the fuzzy search, so that typing more characters only has
+ * to filter the previous matches */
+typedef struct
+{
+	gchar* query;			/* locale encoding */
+	guint generation;		/* of the file index when matches were computed */
+	GArray* matches;		/* guint indexes of all the files matching query */
+	GtkListStore* results;
+	GtkWidget* view;
+	GtkWidget* status_label;
+} FuzzySearch;
+
 /******************* Global variables for the feature *****************/
 
 static GtkWidget* menu_item = NULL;
@@ -45,7 +77,7 @@ static void
 directory_check(GtkEntry*, GtkEntryCompletion*);
 
 static GtkWidget*
-create_dialog(GtkWidget**, GtkTreeModel*);
+create_dialog(GtkWidget**, GtkTreeModel*, FuzzySearch*);
 
 /********************** Functions for the feature *********************/
 
@@ -199,16 +231,233 @@ directory_check(GtkEntry* entry, GtkEntryCompletion* completion)
 }
 
 
+/**
+ * @brief 	Score how well a path matches a query whose characters must all
+ * 		appear in the path, in order, ignoring case. Matches at the start
+ * 		of a path component or a word, consecutive matches and matches in
+ * 		the file name score higher; long paths score lower.
+ * @param 	const gchar* path	the path relative to the project
+ * @param	const gchar* query	what the user typed
+ * @return	gint	the score, or -1 if the path doesn't match
+ * 
+ */
+static gint
+fuzzy_score(const gchar* path, const gchar* query)
+{
+	const gchar* p = path;
+	const gchar* q = query;
+	const gchar* name;
+	const gchar* last = NULL;
+	gint score = 0;
+
+	name = strrchr(path, G_DIR_SEPARATOR);
+	name = (name != NULL) ? name + 1 : path;
+
+	for( ; *q != '\0' ; q++)
+	{
+		gchar c = g_ascii_tolower(*q);
+
+		while(*p != '\0' && g_ascii_tolower(*p) != c)
+			p++;
+		if(*p == '\0')
+			return -1;
+
+		score++;
+		if(p == path || p[-1] == G_DIR_SEPARATOR)
+			score += 8;
+		else if(p[-1] == '_' || p[-1] == '-' || p[-1] == '.' ||
+				(g_ascii_isupper(*p) && g_ascii_islower(p[-1])))
+			score += 4;
+		if(last != NULL && p == last + 1)
+			score += 5;
+		if(p >= name)
+			score += 2;
+
+		last = p;
+		p++;
+	}
+
+	return score * 16 - (gint)strlen(path);
+}
+
+/**
+ * @brief 	Fill the results list with the files of the index which best match
+ * 		the text typed by the user. When the text only grew since last time,
+ * 		only the previous matches are searched.
+ * @param 	FuzzySearch* search	the search state
+ * @param	const gchar* text	the text in the entry (UTF-8)
+ * @return	void
+ * 
+ */
+static void
+fuzzy_search_update(FuzzySearch* search, const gchar* text)
+{
+	GPtrArray* files = file_index_get_files();
+	GArray* old_matches;
+	GArray* candidates;
+	FuzzyMatch best[MAX_RESULTS];
+	guint n_best = 0;
+	guint n_candidates;
+	guint i, j;
+	gchar* query;
+	GtkTreeIter iter;
+	gchar* status;
+
+	query = utils_get_locale_from_utf8(text);
+
+	/* Reuse the previous matches if they are still valid */
+	old_matches = search->matches;
+	candidates = NULL;
+	if(old_matches != NULL && search->generation == file_index_get_generation() &&
+		g_str_has_prefix(query, search->query))
+		candidates = old_matches;
+	n_candidates = (candidates != NULL) ? candidates->len : files->len;
+
+	search->matches = g_array_new(FALSE, FALSE, sizeof(guint));
+	for(i = 0 ; i < n_candidates ; i++)
+	{
+		guint index = (candidates != NULL) ? g_array_index(candidates, guint, i) : i;
+		gint score = fuzzy_score(g_ptr_array_index(files, index), query);
+
+		if(score < 0)
+			continue;
+		g_array_append_val(search->matches, index);
+
+		/* keep the best ones sorted, by insertion */
+		if(n_best == MAX_RESULTS && score <= best[n_best - 1].score)
+			continue;
+		if(n_best < MAX_RESULTS)
+			n_best++;
+		for(j = n_best - 1 ; j > 0 && best[j - 1].score < score ; j--)
+			best[j] = best[j - 1];
+		best[j].index = index;
+		best[j].score = score;
+	}
+
+	if(old_matches != NULL)
+		g_array_free(old_matches, TRUE);
+	g_free(search->query);
+	search->query = query;
+	search->generation = file_index_get_generation();
+
+	/* Only the best matches get into the view */
+	gtk_list_store_clear(search->results);
+	for(i = 0 ; i < n_best ; i++)
+	{
+		const gchar* path = g_ptr_array_index(files, best[i].index);
+		gchar* display = utils_get_utf8_from_locale(path);
+
+		gtk_list_store_insert_with_values(search->results, &iter, -1,
+										RESULT_COLUMN_DISPLAY, display,
+										RESULT_COLUMN_PATH, path, -1);
+		g_free(display);
+	}
+
+	/* Nothing is selected until the user picks a result, so that the text
+	 * typed is what gets opened otherwise */
+	status = g_strdup_printf(file_index_is_complete() ?
+								_("%u of %u files") : _("%u of %u files (indexing...)"),
+							search->matches->len, files->len);
+	gtk_label_set_text(GTK_LABEL(search->status_label), status);
+	g_free(status);
+}
+
+/**
+ * @brief 	Entry callback function for the fuzzy search 
+ * @param 	GtkEntry* entry			entry object
+ * @param	FuzzySearch* search		the search state
+ * @return	void
+ * 
+ */
+static void
+on_fuzzy_entry_changed(GtkEntry* entry, FuzzySearch* search)
+{
+	fuzzy_search_update(search, gtk_entry_get_text(entry));
+}
+
+/**
+ * @brief 	Move the selection in the results with the arrow keys, while
+ * 		keeping the focus in the entry
+ * @param 	GtkWidget* entry		entry object
+ * @param	GdkEventKey* event		the key event
+ * @param	FuzzySearch* search		the search state
+ * @return	gboolean	TRUE if the key was handled
+ * 
+ */
+static gboolean
+on_fuzzy_entry_key_press(GtkWidget* entry, GdkEventKey* event, FuzzySearch* search)
+{
+	GtkTreePath* path = NULL;
+	gint n_rows, row;
+
+	if(event->keyval != GDK_Up && event->keyval != GDK_Down &&
+		event->keyval != GDK_Page_Up && event->keyval != GDK_Page_Down)
+		return FALSE;
+
+	n_rows = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(search->results), NULL);
+	if(n_rows == 0)
+		return TRUE;
+
+	/* the cursor is only meaningful if a result is selected */
+	if(gtk_tree_selection_count_selected_rows(
+			gtk_tree_view_get_selection(GTK_TREE_VIEW(search->view))) > 0)
+		gtk_tree_view_get_cursor(GTK_TREE_VIEW(search->view), &path, NULL);
+
+	if(path == NULL)
+	{
+		/* the first move selects the first (or last) result */
+		row = (event->keyval == GDK_Up || event->keyval == GDK_Page_Up) ? n_rows - 1 : 0;
+	}
+	else
+	{
+		row = gtk_tree_path_get_indices(path)[0];
+		gtk_tree_path_free(path);
+
+		switch(event->keyval)
+		{
+			case GDK_Up:		row -= 1; break;
+			case GDK_Down:		row += 1; break;
+			case GDK_Page_Up:	row -= 10; break;
+			case GDK_Page_Down:	row += 10; break;
+		}
+	}
+	row = CLAMP(row, 0, n_rows - 1);
+
+	path = gtk_tree_path_new_from_indices(row, -1);
+	gtk_tree_view_set_cursor(GTK_TREE_VIEW(search->view), path, NULL, FALSE);
+	gtk_tree_path_free(path);
+
+	return TRUE;
+}
+
+/**
+ * @brief 	Accept the dialog when a result is double-clicked
+ * @param 	GtkTreeView* view		the results view
+ * @param	GtkTreePath* path		not used
+ * @param	GtkTreeViewColumn* column	not used
+ * @param	GtkDialog* dialog		the dialog
+ * @return	void
+ * 
+ */
+static void
+on_result_activated(GtkTreeView* view, GtkTreePath* path, GtkTreeViewColumn* column, GtkDialog* dialog)
+{
+	gtk_dialog_response(dialog, GTK_RESPONSE_ACCEPT);
+}
+
 /**
  * @brief 	Create the dialog, return the entry object to get the
  * 		response from user 
  * @param 	GtkWidget **dialog			entry object
- * @param	GtkTreeModel *completion_model	completion object
+ * @param	GtkTreeModel *completion_model	completion object, NULL when
+ * 		the project files are searched instead
+ * @param	FuzzySearch *search		state of the search in the project
+ * 		files, NULL if there is no index
  * @return	GtkWidget* entry
  * 
  */
 static GtkWidget*
-create_dialog(GtkWidget **dialog, GtkTreeModel *completion_model)
+create_dialog(GtkWidget **dialog, GtkTreeModel *completion_model, FuzzySearch *search)
 {
 	GtkWidget *entry;
 	GtkWidget *label;
@@ -234,6 +483,49 @@ create_dialog(GtkWidget **dialog, GtkTreeModel *completion_model)
 	gtk_entry_set_max_length(GTK_ENTRY(entry), MAX_FILENAME_LENGTH);
 	gtk_entry_set_width_chars(GTK_ENTRY(entry), 40);
 	gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);   /* 'enter' key */
+
+	if (search != NULL)
+	{
+		GtkWidget *scroll;
+		GtkTreeViewColumn *column;
+
+		/* Results of the search in the whole project. The rows all have
+		 * the same height, so the view doesn't need to measure them. */
+		search->results = gtk_list_store_new(RESULT_NB_COLUMNS, G_TYPE_STRING, G_TYPE_STRING);
+		search->view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(search->results));
+		g_object_unref(search->results);
+		column = gtk_tree_view_column_new_with_attributes(NULL, gtk_cell_renderer_text_new(),
+															"text", RESULT_COLUMN_DISPLAY, NULL);
+		gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+		gtk_tree_view_append_column(GTK_TREE_VIEW(search->view), column);
+		gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(search->view), FALSE);
+		gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(search->view), TRUE);
+		GTK_WIDGET_UNSET_FLAGS(search->view, GTK_CAN_FOCUS);
+
+		scroll = gtk_scrolled_window_new(NULL, NULL);
+		gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+										GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+		gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scroll), GTK_SHADOW_IN);
+		gtk_widget_set_size_request(scroll, -1, 250);
+		gtk_container_add(GTK_CONTAINER(scroll), search->view);
+		gtk_box_pack_start(GTK_BOX(vbox), scroll, TRUE, TRUE, 0);
+
+		search->status_label = gtk_label_new(NULL);
+		gtk_misc_set_alignment(GTK_MISC(search->status_label), 0, 0.5);
+		gtk_box_pack_start(GTK_BOX(vbox), search->status_label, FALSE, FALSE, 0);
+
+		g_signal_connect_after(GTK_ENTRY(entry), "changed",
+                               G_CALLBACK(on_fuzzy_entry_changed), search);
+		g_signal_connect(entry, "key-press-event",
+                               G_CALLBACK(on_fuzzy_entry_key_press), search);
+		g_signal_connect(search->view, "row-activated",
+                               G_CALLBACK(on_result_activated), *dialog);
+
+		fuzzy_search_update(search, "");
+		gtk_widget_show_all(*dialog);
+
+		return entry;
+	}
     
 	/* Completion definition */
 	completion = gtk_entry_completion_new();
@@ -265,9 +557,11 @@ menu_item_activate(guint key_id)
 	GtkWidget* dialog;
 	GtkWidget* dialog_new = NULL;
 	GtkWidget* dialog_entry;
-	GtkTreeModel* completion_list;
+	GtkTreeModel* completion_list = NULL;
 	GeanyDocument* current_doc = document_get_current();
-	gchar *chosen_path;
+	FuzzySearch search = { NULL, 0, NULL, NULL, NULL, NULL };
+	gboolean use_index;
+	gchar *chosen_path = NULL;
 	const gchar *chosen_file;
 	gint response;
 
@@ -276,18 +570,42 @@ menu_item_activate(guint key_id)
 	if(current_doc == NULL || current_doc->file_name == NULL || current_doc->file_name[0] == '\0')
 		return;
 		
-	/* Build current directory listing */
 	directory_ref = g_path_get_dirname(current_doc->file_name);
-	completion_list = build_file_list(directory_ref, "");
+
+	/* Search the whole project if it's indexed, otherwise complete the
+	 * names in the current directory */
+	use_index = (file_index_get_root() != NULL);
+	if (!use_index)
+		completion_list = build_file_list(directory_ref, "");
 
 	/* Create the user dialog and get response */
-	dialog_entry = create_dialog(&dialog, completion_list);
+	dialog_entry = create_dialog(&dialog, completion_list, use_index ? &search : NULL);
 	response = gtk_dialog_run(GTK_DIALOG(dialog));
 
 	/* Filename */
 	chosen_file = gtk_entry_get_text(GTK_ENTRY(dialog_entry));
-	/* Path + Filename */
-	chosen_path = g_build_filename(directory_ref, chosen_file, NULL);
+
+	/* Path + Filename : the result the user selected if any, otherwise the text */
+	if (use_index && ! g_path_is_absolute(chosen_file))
+	{
+		GtkTreeModel *model;
+		GtkTreeIter iter;
+		gchar *relative_path;
+
+		if (gtk_tree_selection_get_selected(
+				gtk_tree_view_get_selection(GTK_TREE_VIEW(search.view)), &model, &iter))
+		{
+			gchar *locale_path;
+
+			gtk_tree_model_get(model, &iter, RESULT_COLUMN_PATH, &relative_path, -1);
+			locale_path = g_build_filename(file_index_get_root(), relative_path, NULL);
+			chosen_path = utils_get_utf8_from_locale(locale_path);
+			g_free(locale_path);
+			g_free(relative_path);
+		}
+	}
+	if (chosen_path == NULL)
+		chosen_path = g_build_filename(directory_ref, chosen_file, NULL);
 
 	if ( response == GTK_RESPONSE_ACCEPT )
 	{
@@ -310,11 +628,20 @@ menu_item_activate(guint key_id)
 			gtk_widget_destroy(dialog_new);
 		}
 		else
-			document_open_file(chosen_path, FALSE, NULL, NULL);
+		{
+			gchar *locale_path = utils_get_locale_from_utf8(chosen_path);
+			document_open_file(locale_path, FALSE, NULL, NULL);
+			g_free(locale_path);
+		}
 	}
 
 	/* Freeing memory */
 	gtk_widget_destroy(dialog);
+	g_free(chosen_path);
 	g_free(directory_ref);
-	g_object_unref (completion_list);
+	if (completion_list != NULL)
+		g_object_unref (completion_list);
+	if (search.matches != NULL)
+		g_array_free(search.matches, TRUE);
+	g_free(search.query);
 }
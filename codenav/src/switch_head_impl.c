@@ -27,6 +27,7 @@
 #include <geanyplugin.h>
 
 #include "switch_head_impl.h"
+#include "file_index.h"
 #include "utils.h"
 
 
@@ -41,6 +42,7 @@
 
 static GtkWidget* menu_item = NULL;
 static GSList* languages = NULL;	/* handled languages */
+static GHashTable* counterparts = NULL;	/* extension -> extensions of the counterpart */
 
 
 /**************************** Prototypes ******************************/
@@ -50,6 +52,9 @@ languages_clean(void);
 static void
 menu_item_activate(guint key_id);
 
+static void
+fill_counterparts_table(void);
+
 /********************** Functions for the feature *********************/
 
 /**
@@ -127,6 +132,45 @@ void languages_clean(void)
 	g_slist_free(languages);
 
 	languages = NULL;
+
+	if(counterparts != NULL)
+	{
+		g_hash_table_destroy(counterparts);
+		counterparts = NULL;
+	}
+}
+
+/**
+ * @brief	Map each known extension to the extensions of its counterpart,
+ * 			so that identifying a file doesn't need to walk all the lists.
+ * 			As before, the first language handling an extension wins.
+ * @param	void
+ * @return	void
+ *
+ */
+static void
+fill_counterparts_table(void)
+{
+	GSList* iter_lang = NULL;
+	GSList* iter_ext = NULL;
+
+	counterparts = g_hash_table_new(g_str_hash, g_str_equal);
+
+	for(iter_lang = languages ; iter_lang != NULL ; iter_lang = iter_lang->next)
+	{
+		Language* lang = (Language*)(iter_lang->data);
+
+		for(iter_ext = lang->head_extensions ; iter_ext != NULL ; iter_ext = iter_ext->next)
+		{
+			if(g_hash_table_lookup(counterparts, iter_ext->data) == NULL)
+				g_hash_table_insert(counterparts, iter_ext->data, lang->impl_extensions);
+		}
+		for(iter_ext = lang->impl_extensions ; iter_ext != NULL ; iter_ext = iter_ext->next)
+		{
+			if(g_hash_table_lookup(counterparts, iter_ext->data) == NULL)
+				g_hash_table_insert(counterparts, iter_ext->data, lang->head_extensions);
+		}
+	}
 }
 
 /**
@@ -171,6 +215,7 @@ fill_languages_list(const gchar** impl_list, const gchar** head_list, gsize n)
 	/* reverse the list to match correct order */
 	languages = g_slist_reverse(languages);
 
+	fill_counterparts_table();
 }
 
 /**
@@ -234,6 +279,93 @@ fill_default_languages_list(void)
 	/* Done : */
 	languages = g_slist_reverse(languages);
 
+	fill_counterparts_table();
+}
+
+/**
+ * @brief	Number of directories to go up and down to get from one
+ * 			directory to another.
+ * @param	a, b	directories split into their components
+ * @return	gint	the distance
+ *
+ */
+static gint
+path_distance(gchar** a, gchar** b)
+{
+	gint common = 0;
+	gint len_a = g_strv_length(a);
+	gint len_b = g_strv_length(b);
+
+	while(common < len_a && common < len_b && utils_str_equal(a[common], b[common]))
+		common++;
+
+	return (len_a - common) + (len_b - common);
+}
+
+/**
+ * @brief	Look for the counterpart of a file in the project's file index.
+ * 			If there are several, take the one nearest to the file, then the
+ * 			one with the extension listed first.
+ * @param	path					the current file (locale encoding)
+ * @param	basename_no_extension	e.g. : "file"
+ * @param	extensions				extensions of the counterpart
+ * @return	gchar*	newly-allocated path of the best candidate, or NULL
+ *
+ */
+static gchar*
+find_in_file_index(const gchar* path, const gchar* basename_no_extension, GSList* extensions)
+{
+	GPtrArray* candidates;
+	gchar* dirname;
+	gchar** dir_parts;
+	const gchar* best = NULL;
+	gint best_distance = G_MAXINT;
+	gint best_rank = G_MAXINT;
+	guint i;
+
+	candidates = file_index_lookup_basename(basename_no_extension);
+	if(candidates == NULL)
+		return NULL;
+
+	dirname = g_path_get_dirname(path);
+	dir_parts = g_strsplit(dirname, G_DIR_SEPARATOR_S, -1);
+
+	for(i = 0 ; i < candidates->len ; i++)
+	{
+		const gchar* candidate = g_ptr_array_index(candidates, i);
+		gchar* candidate_dirname;
+		gchar** candidate_parts;
+		gchar* extension;
+		GSList* found;
+		gint rank, distance;
+
+		extension = get_extension((gchar*)candidate);
+		found = extension ? g_slist_find_custom(extensions, extension, (GCompareFunc)(&compare_strings)) : NULL;
+		g_free(extension);
+		if(found == NULL)
+			continue;
+		rank = g_slist_position(extensions, found);
+
+		candidate_dirname = g_path_get_dirname(candidate);
+		candidate_parts = g_strsplit(candidate_dirname, G_DIR_SEPARATOR_S, -1);
+		distance = path_distance(dir_parts, candidate_parts);
+		g_strfreev(candidate_parts);
+		g_free(candidate_dirname);
+
+		log_debug("candidate \"%s\" : distance %d, rank %d", candidate, distance, rank);
+
+		if(distance < best_distance || (distance == best_distance && rank < best_rank))
+		{
+			best = candidate;
+			best_distance = distance;
+			best_rank = rank;
+		}
+	}
+
+	g_strfreev(dir_parts);
+	g_free(dirname);
+
+	return g_strdup(best);
 }
 
 /**
@@ -255,7 +387,6 @@ menu_item_activate(guint key_id)
 
 	GSList* filenames_to_test = NULL;	/* e.g. : ["f.cpp", "f.cxx", ...] */
 
-	GSList* iter_lang = NULL;
 	GSList* iter_ext = NULL;
 	GSList* iter_filename = NULL;
 	guint i=0;
@@ -295,25 +426,8 @@ menu_item_activate(guint key_id)
 			goto free_mem;
 
 		/* Identify the language and whether the file is a header or an implementation. */
-		/* For each recognized language : */
-		for(iter_lang = languages ; iter_lang != NULL ; iter_lang = iter_lang->next)
-		{
-			Language* lang = (Language*)(iter_lang->data);
-
-			/* Test the headers : */
-			if(g_slist_find_custom(lang->head_extensions, extension, (GCompareFunc)(&compare_strings)) != NULL)
-			{
-				p_extensions_to_test = lang->impl_extensions;
-				break;
-			}
-
-			/* Test the implementations : */
-			else if(g_slist_find_custom(lang->impl_extensions, extension, (GCompareFunc)(&compare_strings)) != NULL)
-			{
-				p_extensions_to_test = lang->head_extensions;
-				break;
-			}
-		}
+		if(counterparts != NULL)
+			p_extensions_to_test = g_hash_table_lookup(counterparts, extension);
 
 		if(p_extensions_to_test == NULL)
 			goto free_mem;
@@ -364,7 +478,23 @@ menu_item_activate(guint key_id)
 			}
 		}
 
-		/* Second : if not found, look for a corresponding file in the same directory.
+		/* Second : if not found, look for the nearest corresponding file in the
+		 * project, using the index built in the background. If found, open it. */
+		p_str = find_in_file_index(current_doc->real_path, basename_no_extension, p_extensions_to_test);
+		if(p_str != NULL)
+		{
+			log_debug("found \"%s\" in the project", p_str);
+
+			if(	document_open_file(p_str, FALSE, NULL, NULL) != NULL ||
+				document_open_file(p_str, TRUE, NULL, NULL) != NULL)
+			{
+				g_free(p_str);
+				goto free_mem;
+			}
+			g_free(p_str);
+		}
+
+		/* Third : if not found, look for a corresponding file in the same directory.
 		 * If found, open it.
 		 */
 		/* -> compute dirname */
@@ -395,7 +525,7 @@ menu_item_activate(guint key_id)
 			g_free(p_str2);
 		}
 
-		/* Third : if not found, ask the user if he wants to create it or not. */
+		/* Fourth : if not found, ask the user if he wants to create it or not. */
 		{
 			GtkWidget* dialog;
 
@@ -173,6 +173,32 @@ static gboolean on_mouse_leave(GtkWidget *widget, GdkEvent *event, gpointer user
 	return FALSE;
 }
 
+/*
+ * 	Editor and position a calltip is being evaluated for
+ */
+static ScintillaObject *calltip_sci = NULL;
+static int calltip_position = 0;
+
+/*
+ * 	Shows a calltip, that is hidden when mouse leaves the editor
+ */
+static void show_calltip(ScintillaObject *sci, int position, const gchar *calltip)
+{
+	leave_signal = g_signal_connect(G_OBJECT(sci), "leave-notify-event", G_CALLBACK(on_mouse_leave), NULL);
+	scintilla_send_message (sci, SCI_CALLTIPSHOW, position, (long)calltip);
+}
+
+/*
+ * 	Occures when a calltip requested on mouse dwell has been evaluated
+ */
+static void on_calltip_evaluated(const gchar *calltip)
+{
+	GeanyDocument *doc = document_get_current();
+	if (calltip_sci && doc && doc->editor->sci == calltip_sci)
+		show_calltip(calltip_sci, calltip_position, calltip);
+	calltip_sci = NULL;
+}
+
 /*
  * 	Occures on notify from editor.
  * 	Handles margin click to set/remove breakpoint 
@@ -224,11 +250,14 @@ gboolean on_editor_notify(
 			word = get_word_at_position(editor->sci, nt->position);
 			if (word->len)
 			{
-				gchar *calltip = debug_get_calltip_for_expression(word->str);
+				gchar *calltip = debug_get_calltip_for_expression(word->str, on_calltip_evaluated);
 				if (calltip)
+					show_calltip(editor->sci, nt->position, calltip);
+				else
 				{
-					leave_signal = g_signal_connect(G_OBJECT(editor->sci), "leave-notify-event", G_CALLBACK(on_mouse_leave), NULL);
-					scintilla_send_message (editor->sci, SCI_CALLTIPSHOW, nt->position, (long)calltip);
+					/* show when evaluated */
+					calltip_sci = editor->sci;
+					calltip_position = nt->position;
 				}
 			}
 				
@@ -238,6 +267,10 @@ gboolean on_editor_notify(
 		}
 		case SCN_DWELLEND:
 		{
+			/* don't show a calltip being evaluated */
+			debug_cancel_calltip();
+			calltip_sci = NULL;
+
 			if (leave_signal > 0)
 			{
 				g_signal_handler_disconnect(G_OBJECT(editor->sci), leave_signal);
@@ -99,6 +99,16 @@ static GIOChannel *gdb_ch_out;
 /* GDB output event source id */
 static guint gdb_id_out;
 
+/* maximum number of startup commands sent without waiting for their results
+(not to fill the pipes when GDB output is not being read) */
+#define MAX_COMMANDS_IN_FLIGHT 32
+
+/* startup commands queue: the next command to send, its token
+and the number of sent commands which results are not read yet */
+static GList *next_command = NULL;
+static int next_token = 0;
+static int commands_in_flight = 0;
+
 /* buffer for the error message */
 char err_message[1000];
 
@@ -114,6 +124,9 @@ static GList *watches = NULL;
 /* loaded files list */
 static GList *files = NULL;
 
+/* incremented each time files list is refreshed */
+static guint files_generation = 0;
+
 /* set to true if library was loaded/unloaded
 and it's nessesary to refresh files list */
 static gboolean file_refresh_needed = FALSE;
@@ -121,12 +134,28 @@ static gboolean file_refresh_needed = FALSE;
 /* current frame number */
 static int active_frame = 0;
 
+/* prefix for GDB variables created for calltips */
+#define CALLTIP_VAR_PREFIX "calltip"
+
+/* calltip being evaluated asyncronously: variable, its children
+and the number of GDB commands which output is still to be read */
+static variable *calltip_var = NULL;
+static GList *calltip_children = NULL;
+static int calltip_commands_left = 0;
+
+/* calltip GDB output event source id */
+static guint gdb_id_calltip = 0;
+
+/* counter to create unique calltip GDB variables names */
+static int calltip_count = 0;
+
 /* forward declarations */
 static void stop(void);
 static variable* add_watch(gchar* expression);
 static void update_watches(void);
 static void update_autos(void);
 static void update_files(void);
+static void finish_calltip(void);
 
 /*
  * print message using color, based on message type
@@ -191,6 +220,21 @@ static void on_gdb_exit(GPid pid, gint status, gpointer data)
 	g_list_foreach(files, (GFunc)g_free, NULL);
 	g_list_free(files);
 	files = NULL;
+
+	/* delete calltip being evaluated */
+	if (gdb_id_calltip)
+	{
+		g_source_remove(gdb_id_calltip);
+		gdb_id_calltip = 0;
+	}
+	if (calltip_var)
+	{
+		variable_free(calltip_var);
+		calltip_var = NULL;
+	}
+	g_list_foreach(calltip_children, (GFunc)variable_free, NULL);
+	g_list_free(calltip_children);
+	calltip_children = NULL;
 	
 	g_source_remove(gdb_src_id);
 	
@@ -212,10 +256,10 @@ static GList* read_until_prompt(void)
 			break;
 
 		line[terminator] = '\0';
-		lines = g_list_append (lines, line);
+		lines = g_list_prepend (lines, line);
 	}
 	
-	return lines;
+	return g_list_reverse(lines);
 }
 
 /*
@@ -225,15 +269,21 @@ static void gdb_input_write_line(const gchar *line)
 {
 	GIOStatus st;
 	GError *err = NULL;
-	gsize count;
-	
-	char command[1000];
-	sprintf(command, "%s\n", line);
+	gsize count, written = 0;
+	gsize length;
+	gchar *command;
+
+	/* read the output of a calltip being evaluated before sending anything else */
+	if (gdb_id_calltip)
+		finish_calltip();
+
+	command = g_strconcat(line, "\n", NULL);
+	length = strlen(command);
 	
-	while (strlen(command))
+	while (written < length)
 	{
-		st = g_io_channel_write_chars(gdb_ch_in, command, strlen(command), &count, &err);
-		strcpy(command, command + count);
+		st = g_io_channel_write_chars(gdb_ch_in, command + written, length - written, &count, &err);
+		written += count;
 		if (err || (st == G_IO_STATUS_ERROR) || (st == G_IO_STATUS_EOF))
 		{
 #ifdef DEBUG_OUTPUT
@@ -242,6 +292,7 @@ static void gdb_input_write_line(const gchar *line)
 			break;
 		}
 	}
+	g_free(command);
 
 	st = g_io_channel_flush(gdb_ch_in, &err);
 	if (err || (st == G_IO_STATUS_ERROR) || (st == G_IO_STATUS_EOF))
@@ -276,6 +327,7 @@ static void free_commands_queue(GList *queue)
 
 /*
  * add a new command ("queue_item" structure) to a list 
+ * (prepended, the list is reversed when complete)
  */
 static GList* add_to_queue(GList* queue, const gchar *message, const gchar *command, const gchar *error_message, gboolean format_error_message)
 {
@@ -294,111 +346,122 @@ static GList* add_to_queue(GList* queue, const gchar *message, const gchar *comm
 	}
 	item->format_error_message = format_error_message;
 
-	return g_list_append(queue, (gpointer)item);
+	return g_list_prepend(queue, (gpointer)item);
 } 
 
+/*
+ * sends startup commands until MAX_COMMANDS_IN_FLIGHT of them are awaiting results,
+ * each command is prefixed with its index in the queue as a token
+ */
+static void send_startup_commands(void)
+{
+	while (next_command && commands_in_flight < MAX_COMMANDS_IN_FLIGHT)
+	{
+		queue_item *item = (queue_item*)next_command->data;
+		gchar *command;
+
+		/* send message to debugger messages window */
+		if (item->message)
+		{
+			dbg_cbs->send_message(item->message->str, "grey");
+		}
+
+		command = g_strdup_printf("%i%s", next_token, item->command->str);
+		gdb_input_write_line(command);
+		g_free(command);
+
+		next_command = next_command->next;
+		next_token++;
+		commands_in_flight++;
+	}
+}
+
 /*
  * asyncronous output reader
- * reads from startup async commands.
- * looks for a command completion (normal or abnormal), if noraml - executes next command
+ * reads results of the startup commands, sending the next ones as results come.
+ * looks for a command completion (normal or abnormal), if all are normal - runs the target
  */
 static void exec_async_command(const gchar* command);
 static gboolean on_read_async_output(GIOChannel * src, GIOCondition cond, gpointer data)
 {
-	gchar *line;
+	gchar *line, *result;
 	gsize length;
+	int token;
+	GList *commands = (GList*)data;
 	
 	if (G_IO_STATUS_NORMAL != g_io_channel_read_line(src, &line, NULL, &length, NULL))
 		return TRUE;		
 
 	*(line + length) = '\0';
 
-	if ('^' == line[0])
+	/* skip everything but the tagged results */
+	token = strtol(line, &result, 10);
+	if (result == line || '^' != *result)
 	{
-		/* got some result */
-
-		GList *lines;
-		GList *commands = (GList*)data;
-		gchar *coma;
-
-		g_source_remove(gdb_id_out);
+		g_free(line);
+		return TRUE;
+	}
 
-		lines = read_until_prompt();
-		g_list_foreach(lines, (GFunc)g_free, NULL);
-		g_list_free (lines);
+	commands_in_flight--;
 
-		coma = strchr(line, ',');
-		if (coma)
+	if (g_str_has_prefix(result, "^done"))
+	{
+		/* command completed succesfully - send more commands if there are */
+		if (next_command)
 		{
-			*coma = '\0';
-			coma++;
+			send_startup_commands();
 		}
-		else
-			coma = line + strlen(line);
-		
-		if (!strcmp(line, "^done"))
+		else if (!commands_in_flight)
 		{
-			/* command completed succesfully - run next command if exists */
-			if (commands->next)
-			{
-				/* if there are commads left */
-				queue_item *item;
-
-				commands = commands->next;
-				item = (queue_item*)commands->data;
-
-				/* send message to debugger messages window */
-				if (item->message)
-				{
-					dbg_cbs->send_message(item->message->str, "grey");
-				}
+			/* all commands completed */
+			GList *lines = read_until_prompt();
+			g_list_foreach(lines, (GFunc)g_free, NULL);
+			g_list_free (lines);
 
-				gdb_input_write_line(item->command->str);
-
-				gdb_id_out = g_io_add_watch(gdb_ch_out, G_IO_IN, on_read_async_output, commands);
-			}
-			else
-			{
-				/* all commands completed */
-				free_commands_queue(commands);
+			free_commands_queue(commands);
+			g_free(line);
 
-				/* removing read callback */
-				g_source_remove(gdb_id_out);
+			/* update source files list */
+			update_files();
 
-				/* update source files list */
-				update_files();
+			/* -exec-run */
+			exec_async_command("-exec-run &");
 
-				/* -exec-run */
-				exec_async_command("-exec-run &");
-			}
+			/* removing read callback */
+			return FALSE;
 		}
-		else
+	}
+	else
+	{
+		queue_item *item = (queue_item*)g_list_nth_data(commands, token);
+		if(item && item->error_message)
 		{
-			queue_item *item = (queue_item*)commands->data;
-			if(item->error_message)
+			if (item->format_error_message)
 			{
-				if (item->format_error_message)
-				{
-					gchar* gdb_msg = g_strcompress(strstr(coma, "msg=\"") + strlen("msg=\""));
+				gchar* gdb_msg = g_strcompress(strstr(result, "msg=\"") + strlen("msg=\""));
 
-					GString *msg = g_string_new("");
-					g_string_printf(msg, item->error_message->str, gdb_msg);
-					dbg_cbs->report_error(msg->str);
+				GString *msg = g_string_new("");
+				g_string_printf(msg, item->error_message->str, gdb_msg);
+				dbg_cbs->report_error(msg->str);
 
-					g_free(gdb_msg);
-					g_string_free(msg, FALSE);
-				}
-				else
-				{
-					dbg_cbs->report_error(item->error_message->str);
-				}
+				g_free(gdb_msg);
+				g_string_free(msg, FALSE);
+			}
+			else
+			{
+				dbg_cbs->report_error(item->error_message->str);
 			}
-			
-			/* free commands queue */
-			free_commands_queue(commands);
-
-			stop();
 		}
+		
+		/* free commands queue */
+		free_commands_queue(commands);
+		next_command = NULL;
+
+		stop();
+
+		/* removing read callback */
+		g_free(line);
+		return FALSE;
 	}
 
 	g_free(line);
@@ -723,7 +786,6 @@ static gboolean run(const gchar* file, const gchar* commandline, GList* env, GLi
 	GList *commands = NULL;
 	GString *command;
 	int bp_index;
-	queue_item *item;
 
 	dbg_cbs = callbacks;
 
@@ -872,19 +934,16 @@ static gboolean run(const gchar* file, const gchar* commandline, GList* env, GLi
 	commands = add_to_queue(commands, NULL, command->str, NULL, FALSE);
 	g_string_free(command, TRUE);
 
+	commands = g_list_reverse(commands);
+
 	/* connect read callback to the output chanel */
 	gdb_id_out = g_io_add_watch(gdb_ch_out, G_IO_IN, on_read_async_output, commands);
 
-	item = (queue_item*)commands->data;
-
-	/* send message to debugger messages window */
-	if (item->message)
-	{
-		dbg_cbs->send_message(item->message->str, "grey");
-	}
-
-	/* send first command */
-	gdb_input_write_line(item->command->str);
+	/* send first commands, the rest is sent as results come */
+	next_command = commands;
+	next_token = 0;
+	commands_in_flight = 0;
+	send_startup_commands();
 
 	return TRUE;
 }
@@ -1111,16 +1170,18 @@ static void set_active_frame(int frame_number)
 }
 
 /*
- * gets stack
+ * gets stack frames from low to high (inclusive)
  */
-static GList* get_stack(void)
+static GList* get_stack(int low, int high)
 {
 	gchar* record = NULL;
 	GList *stack = NULL;
 	gchar **frames, **next;
 	result_class rc;
+	gchar command[100];
 
-	rc = exec_sync_command("-stack-list-frames", TRUE, &record);
+	sprintf(command, "-stack-list-frames %i %i", low, high);
+	rc = exec_sync_command(command, TRUE, &record);
 	if (RC_DONE != rc)
 		return NULL;
 
@@ -1193,7 +1254,7 @@ static GList* get_stack(void)
 		}
 		f->line = line;
 
-		stack = g_list_append(stack, f);
+		stack = g_list_prepend(stack, f);
 
 		next++;
 	}
@@ -1201,7 +1262,28 @@ static GList* get_stack(void)
 	
 	free(record);
 	
-	return stack;
+	return g_list_reverse(stack);
+}
+
+/*
+ * gets the number of frames of the current thread stack
+ */
+static int get_stack_depth(int max_depth)
+{
+	gchar *command, *record = NULL, *pos;
+	int depth = 0;
+
+	/* GDB stops unwinding at max_depth, deep stacks aren't walked entirely */
+	command = g_strdup_printf("-stack-info-depth %i", max_depth);
+	if (RC_DONE == exec_sync_command(command, TRUE, &record) &&
+		(pos = strstr(record, "depth=\"")))
+	{
+		depth = atoi(pos + strlen("depth=\""));
+	}
+	g_free(record);
+	g_free(command);
+
+	return depth;
 }
 
 /*
@@ -1436,11 +1518,13 @@ static void update_files(void)
 		if (!g_hash_table_lookup(ht, pos))
 		{
 			g_hash_table_insert(ht, (gpointer)pos, (gpointer)1);
-			files = g_list_append(files, g_strdup(pos));
+			files = g_list_prepend(files, g_strdup(pos));
 		}
 			
 		pos += strlen(pos) + 1;
 	}
+	files = g_list_reverse(files);
+	files_generation++;
 
 	g_hash_table_destroy(ht);
 	g_free(record);
@@ -1619,6 +1703,14 @@ static GList* get_files (void)
 	return g_list_copy(files);
 }
 
+/*
+ * get files list generation, changes each time files list is refreshed
+ */
+static guint get_files_generation (void)
+{
+	return files_generation;
+}
+
 /*
  * get list of children 
  */
@@ -1766,6 +1858,311 @@ static gchar *evaluate_expression(gchar *expression)
 	return unescape(pos);
 }
 
+/*
+ * finds key="value" in a GDB record starting from *pos,
+ * terminates the value (escaped quotes are skipped) and moves *pos after it
+ * returns value or NULL if not found
+ */
+static gchar* find_record_value(gchar **pos, const gchar *key)
+{
+	gchar *start, *end;
+	gchar pattern[100];
+
+	sprintf(pattern, "%s=\"", key);
+	if (!(start = strstr(*pos, pattern)))
+		return NULL;
+
+	start += strlen(pattern);
+	for (end = start; *end && '\"' != *end; end++)
+	{
+		if ('\\' == *end && *(end + 1))
+			end++;
+	}
+
+	if (*end)
+	{
+		*end = '\0';
+		*pos = end + 1;
+	}
+	else
+		*pos = end;
+
+	return start;
+}
+
+/*
+ * terminates a {...} tuple of a GDB record starting at tuple
+ * returns a pointer after the tuple
+ */
+static gchar* terminate_record_tuple(gchar *tuple)
+{
+	gboolean quoted = FALSE;
+	int depth = 0;
+
+	for (; *tuple; tuple++)
+	{
+		if (quoted)
+		{
+			if ('\\' == *tuple && *(tuple + 1))
+				tuple++;
+			else if ('\"' == *tuple)
+				quoted = FALSE;
+		}
+		else if ('\"' == *tuple)
+			quoted = TRUE;
+		else if ('{' == *tuple || '[' == *tuple)
+			depth++;
+		else if (('}' == *tuple || ']' == *tuple) && !--depth)
+		{
+			*tuple = '\0';
+			return tuple + 1;
+		}
+	}
+
+	return tuple;
+}
+
+/*
+ * handles a result record of the calltip GDB commands
+ * (variable creation, expression evaluation and children listing)
+ */
+static void on_calltip_result(gchar *line)
+{
+	int command = 3 - calltip_commands_left;
+	gboolean done = g_str_has_prefix(line, "^done");
+	gchar *pos = line, *value;
+
+	if (0 == command)
+	{
+		calltip_var->evaluated = done;
+		if (!done)
+			return;
+
+		if ((value = find_record_value(&pos, "name")))
+			g_string_assign(calltip_var->internal, value);
+		if ((value = find_record_value(&pos, "numchild")))
+			calltip_var->has_children = atoi(value) > 0;
+		if ((value = find_record_value(&pos, "value")))
+		{
+			value = unescape(value);
+			g_string_assign(calltip_var->value, value);
+			g_free(value);
+		}
+		if ((value = find_record_value(&pos, "type")))
+			g_string_assign(calltip_var->type, value);
+	}
+	else if (1 == command)
+	{
+		if (done && (value = find_record_value(&pos, "value")))
+		{
+			value = unescape(value);
+			g_string_assign(calltip_var->value, value);
+			g_free(value);
+		}
+	}
+	else if (done)
+	{
+		while ( (pos = strstr(pos, "child={")) )
+		{
+			gchar *next = terminate_record_tuple(pos + strlen("child="));
+			gchar *name, *internal, *numchild;
+			variable *var;
+
+			internal = find_record_value(&pos, "name");
+			name = find_record_value(&pos, "exp");
+			numchild = find_record_value(&pos, "numchild");
+			if (internal && name)
+			{
+				name = g_strcompress(name);
+				var = variable_new2(name, internal, VT_CHILD);
+				g_free(name);
+
+				var->evaluated = TRUE;
+				var->has_children = numchild && atoi(numchild) > 0;
+				if ((value = find_record_value(&pos, "value")))
+				{
+					value = unescape(value);
+					g_string_assign(var->value, value);
+					g_free(value);
+				}
+				if ((value = find_record_value(&pos, "type")))
+					g_string_assign(var->type, value);
+
+				calltip_children = g_list_prepend(calltip_children, var);
+			}
+
+			pos = next;
+		}
+		calltip_children = g_list_reverse(calltip_children);
+	}
+}
+
+/*
+ * handles a line of the calltip GDB commands output
+ * returns TRUE if all the commands output is read
+ */
+static gboolean read_calltip_line(gchar *line, gsize terminator)
+{
+	if (!strcmp(GDB_PROMPT, line))
+		return !--calltip_commands_left;
+
+	line[terminator] = '\0';
+	if ('^' == *line)
+		on_calltip_result(line);
+	else if ('&' != *line)
+		colorize_message(line);
+
+	return FALSE;
+}
+
+/*
+ * passes evaluated calltip to the debug module
+ */
+static void calltip_evaluated(void)
+{
+	variable *var = calltip_var;
+	GList *children = calltip_children;
+
+	calltip_var = NULL;
+	calltip_children = NULL;
+
+	if (gdb_id_calltip)
+	{
+		g_source_remove(gdb_id_calltip);
+		gdb_id_calltip = 0;
+	}
+
+	dbg_cbs->set_calltip(var, children);
+
+	variable_free(var);
+	g_list_foreach(children, (GFunc)variable_free, NULL);
+	g_list_free(children);
+}
+
+/*
+ * asyncronous calltip GDB output reader
+ */
+static gboolean on_read_calltip(GIOChannel * src, GIOCondition cond, gpointer data)
+{
+	gchar *line;
+	gsize terminator;
+	gboolean finished;
+
+	if (G_IO_STATUS_NORMAL != g_io_channel_read_line(src, &line, NULL, &terminator, NULL))
+		return TRUE;
+
+	finished = read_calltip_line(line, terminator);
+	g_free(line);
+
+	if (finished)
+	{
+		gdb_id_calltip = 0;
+		calltip_evaluated();
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * reads the rest of the calltip GDB commands output syncronously
+ */
+static void finish_calltip(void)
+{
+	gchar *line;
+	gsize terminator;
+
+	g_source_remove(gdb_id_calltip);
+	gdb_id_calltip = 0;
+
+	while (G_IO_STATUS_NORMAL == g_io_channel_read_line(gdb_ch_out, &line, NULL, &terminator, NULL))
+	{
+		gboolean finished = read_calltip_line(line, terminator);
+		g_free(line);
+
+		if (finished)
+			break;
+	}
+
+	calltip_evaluated();
+}
+
+/*
+ * starts asyncronous evaluation of an expression and its first children for a calltip,
+ * the result is passed to the set_calltip callback
+ */
+static gboolean request_calltip(gchar *expression, int max_children)
+{
+	gchar command[1000];
+	gchar *escaped;
+
+	/* a previous calltip is read first */
+	if (gdb_id_calltip)
+		finish_calltip();
+
+	calltip_var = variable_new(expression, VT_NONE);
+	calltip_commands_left = 3;
+
+	escaped = g_strescape(expression, NULL);
+
+	/* all three commands are sent at once, their output is read as it comes */
+	sprintf(command, "-var-create %s%i * \"%s\"", CALLTIP_VAR_PREFIX, ++calltip_count, escaped);
+	gdb_input_write_line(command);
+	sprintf(command, "-data-evaluate-expression \"%s\"", escaped);
+	gdb_input_write_line(command);
+	sprintf(command, "-var-list-children --all-values %s%i 0 %i", CALLTIP_VAR_PREFIX, calltip_count, max_children);
+	gdb_input_write_line(command);
+
+	g_free(escaped);
+
+	gdb_id_calltip = g_io_add_watch(gdb_ch_out, G_IO_IN, on_read_calltip, NULL);
+
+	return TRUE;
+}
+
+/*
+ * deletes GDB variable created for a calltip 
+ */
+static void release_calltip(gchar *internal)
+{
+	gchar command[1000];
+	sprintf(command, "-var-delete %s", internal);
+	exec_sync_command(command, TRUE, NULL);
+}
+
+/*
+ * updates calltips GDB variables
+ * returns list of names of the calltips variables which value
+ * has changed or which went out of scope
+ */
+static GList* update_calltips(void)
+{
+	GList *changed = NULL;
+	gchar *record = NULL, *pos, *name;
+
+	if (RC_DONE == exec_sync_command("-var-update 0 *", TRUE, &record))
+	{
+		pos = record;
+		while ( (name = find_record_value(&pos, "name")) )
+		{
+			gchar *dot;
+
+			if (!g_str_has_prefix(name, CALLTIP_VAR_PREFIX))
+				continue;
+
+			/* children changes invalidate the whole calltip */
+			if ((dot = strchr(name, '.')))
+				*dot = '\0';
+
+			if (!g_list_find_custom(changed, name, (GCompareFunc)strcmp))
+				changed = g_list_prepend(changed, g_strdup(name));
+		}
+	}
+	g_free(record);
+
+	return changed;
+}
+
 /*
  * request GDB interrupt 
  */
@@ -70,6 +70,16 @@ extern GeanyData		*geany_data;
 #define CALLTIP_HEIGHT 20
 #define CALLTIP_WIDTH 200
 
+/*
+ *  number of frames loaded at once
+ */
+#define STACK_PAGE_SIZE 64
+
+/*
+ *  number of calltips kept cached, with their GDB variables
+ */
+#define MAX_CACHED_CALLTIPS 100
+
 /* module description structure (name/module pointer) */
 typedef struct _module_description {
 	const gchar *title;
@@ -137,8 +147,10 @@ static GList* stack = NULL;
 
 /*
  * pages which are loaded in debugger and therefore, are set readonly
+ * (set of file names) and the files list generation it was built from
  */
-static GList *read_only_pages = NULL;
+static GHashTable *read_only_pages = NULL;
+static guint read_only_generation = 0;
 
 /* available modules */
 static module_description modules[] = 
@@ -147,9 +159,38 @@ static module_description modules[] =
 	{ NULL, NULL }
 };
 
-/* calltips cache  */
+/* cached calltip, its GDB variable name and its link in calltips_lru */
+typedef struct _calltip_entry {
+	gchar *text;
+	gchar *internal;
+	GList *link;
+} calltip_entry;
+
+/* calltips cache (key - thread, frame depth from the outermost frame,
+function and expression) */
 static GHashTable *calltips = NULL;
 
+/* calltips cache keys, most recently used first */
+static GQueue *calltips_lru = NULL;
+
+/* calltips cache keys by GDB variable names,
+to invalidate calltips which values have changed */
+static GHashTable *calltip_keys = NULL;
+
+/* frames the cached calltips were evaluated in (thread, depth and
+functions of the innermost frames) */
+static gchar *calltips_frames = NULL;
+
+/* key of the calltip being evaluated and a callback to call when it's ready */
+static gchar *calltip_pending = NULL;
+static calltip_callback calltip_cb = NULL;
+
+/* thread the debugger has been stopped in */
+static int stopped_thread_id = 0;
+
+/* depth of the stack of the stopped thread, -1 if not known yet */
+static int stack_depth = -1;
+
 /* 
  * remove stack margin markers
  */
@@ -645,12 +686,225 @@ static void on_debugger_run (void)
 }
 
 
+/*
+ * gets the depth of the stack of the stopped thread, counted up to
+ * STACK_PAGE_SIZE + 1 frames so that stepping in a deep stack doesn't
+ * unwind all of it
+ */
+static int get_stack_depth(void)
+{
+	if (stack_depth < 0)
+		stack_depth = active_module->get_stack_depth(STACK_PAGE_SIZE + 1);
+	return stack_depth;
+}
+
+/*
+ * gets calltips cache key for the expression in the active frame
+ * (frame is identified by its depth from the outermost frame and function,
+ * which stay the same while stepping in it; in stacks deeper than a page
+ * the depth is capped, the cache being cleared when the frames of the first
+ * page change anyway)
+ */
+static gchar* get_calltip_key(const gchar *expression)
+{
+	int frame_index = active_module->get_active_frame();
+	frame *f = (frame*)g_list_nth_data(stack, frame_index);
+
+	return g_strdup_printf("%i:%i:%s:%s", stopped_thread_id, get_stack_depth() - frame_index,
+		f ? f->function : "", expression);
+}
+
+/*
+ * describes the frames the debugger is stopped in (thread, stack depth
+ * and functions of the first page of frames)
+ */
+static gchar* get_frames_signature(void)
+{
+	GString *signature = g_string_new(NULL);
+	GList *iter;
+	int i;
+
+	g_string_printf(signature, "%i:%i", stopped_thread_id, get_stack_depth());
+	for (iter = stack, i = 0; iter && i < STACK_PAGE_SIZE; iter = iter->next, i++)
+	{
+		frame *f = (frame*)iter->data;
+		g_string_append_printf(signature, ":%s", f->function);
+	}
+
+	return g_string_free(signature, FALSE);
+}
+
+static void calltip_entry_free(calltip_entry *entry)
+{
+	g_free(entry->text);
+	g_free(entry->internal);
+	g_free(entry);
+}
+
+/*
+ * removes a calltip from the cache and deletes its GDB variable
+ */
+static void remove_calltip(const gchar *key)
+{
+	calltip_entry *entry = (calltip_entry*)g_hash_table_lookup(calltips, key);
+	if (!entry)
+		return;
+
+	g_queue_delete_link(calltips_lru, entry->link);
+	g_hash_table_remove(calltip_keys, entry->internal);
+	active_module->release_calltip(entry->internal);
+	g_hash_table_remove(calltips, key);
+}
+
+/*
+ * clears the calltips cache, deleting the GDB variables
+ * if the debugger is still running
+ */
+static void clear_calltips(gboolean release)
+{
+	if (calltips)
+	{
+		if (release)
+		{
+			while (!g_queue_is_empty(calltips_lru))
+				remove_calltip((gchar*)g_queue_peek_tail(calltips_lru));
+		}
+		g_hash_table_destroy(calltips);
+		g_hash_table_destroy(calltip_keys);
+		g_queue_free(calltips_lru);
+		calltips = calltip_keys = NULL;
+		calltips_lru = NULL;
+	}
+	g_free(calltips_frames);
+	calltips_frames = NULL;
+}
+
+/*
+ * loads next STACK_PAGE_SIZE frames to the stack and the stack tree
+ * returns the list part with the loaded frames
+ */
+static GList* load_stack_frames(void)
+{
+	int first = g_list_length(stack);
+	GList *frames, *iter, *extra;
+
+	/* one frame more is requested to know whether there are more frames */
+	frames = active_module->get_stack(first, first + STACK_PAGE_SIZE);
+	if ( (extra = g_list_nth(frames, STACK_PAGE_SIZE)) )
+	{
+		frames = g_list_remove_link(frames, extra);
+		frame_free((frame*)extra->data);
+		g_list_free(extra);
+	}
+
+	for (iter = frames; iter; iter = iter->next)
+	{
+		frame *f = (frame*)iter->data;
+		stree_add(f);
+	}
+	stree_set_more_frames(NULL != extra);
+
+	stack = g_list_concat(stack, frames);
+
+	return frames;
+}
+
+/*
+ * called from the stack tree when more frames are to be loaded
+ */
+static void on_load_more_frames(void)
+{
+	GList *iter;
+
+	if (DBS_STOPPED != debug_state)
+		return;
+
+	for (iter = load_stack_frames(); iter; iter = iter->next)
+	{
+		frame *f = (frame*)iter->data;
+		if (f->have_source)
+			markers_add_frame(f->file, f->line);
+	}
+}
+
+/*
+ * removes from the cache calltips which values have changed or went out of scope,
+ * or all of them if the debugger stopped in other frames
+ */
+static void update_calltips(void)
+{
+	GList *changed, *iter;
+	gchar *frames;
+
+	if (!calltip_keys || !g_hash_table_size(calltip_keys))
+		return;
+
+	frames = get_frames_signature();
+	if (calltips_frames && strcmp(frames, calltips_frames))
+	{
+		clear_calltips(TRUE);
+		g_free(frames);
+		return;
+	}
+	g_free(frames);
+
+	changed = active_module->update_calltips();
+	for (iter = changed; iter; iter = iter->next)
+	{
+		gchar *internal = (gchar*)iter->data;
+		gchar *key = g_hash_table_lookup(calltip_keys, internal);
+		if (key)
+			remove_calltip(key);
+		g_free(internal);
+	}
+	g_list_free(changed);
+}
+
+/*
+ * makes readonly the pages of the files loaded in debugger
+ * and writable those that were loaded but are not anymore
+ */
+static void update_read_only_pages(void)
+{
+	GHashTable *loaded = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, NULL);
+	GList *files, *iter;
+	int i;
+
+	files = active_module->get_files();
+	for (iter = files; iter; iter = iter->next)
+	{
+		gchar *file = g_strdup((gchar*)iter->data);
+		g_hash_table_insert(loaded, file, file);
+	}
+	g_list_free(files);
+
+	/* only the opened documents can change their state */
+	foreach_document(i)
+	{
+		GeanyDocument *doc = document_index(i);
+		gboolean was_loaded, is_loaded;
+
+		if (!doc->real_path)
+			continue;
+
+		was_loaded = read_only_pages && g_hash_table_lookup(read_only_pages, doc->real_path);
+		is_loaded = NULL != g_hash_table_lookup(loaded, doc->real_path);
+		if (was_loaded != is_loaded)
+			scintilla_send_message(doc->editor->sci, SCI_SETREADONLY, is_loaded, 0);
+	}
+
+	if (read_only_pages)
+		g_hash_table_destroy(read_only_pages);
+	read_only_pages = loaded;
+	read_only_generation = active_module->get_files_generation();
+}
+
 /* 
  * called from debug module when debugger is being stopped 
  */
 static void on_debugger_stopped (int thread_id)
 {
-	GList *iter, *files, *autos, *watches;
+	GList *autos, *watches;
 
 	/* update debug state */
 	debug_state = DBS_STOPPED;
@@ -661,8 +915,9 @@ static void on_debugger_stopped (int thread_id)
 		btnpanel_set_debug_state(debug_state);
 	}
 
-	/* clear calltips cache */
-	g_hash_table_remove_all(calltips);
+	/* remember thread for the calltips cache keys */
+	stopped_thread_id = thread_id;
+	stack_depth = -1;
 
 	/* if a stop was requested for asyncronous exiting -
 	 * stop debug module and exit */
@@ -687,63 +942,17 @@ static void on_debugger_stopped (int thread_id)
 	/* clear stack tree view */
 	stree_set_active_thread_id(thread_id);
 
-	/* get current stack trace and put in the tree view */
-	stack = active_module->get_stack();
-	for (iter = stack; iter; iter = iter->next)
-	{
-		frame *f = (frame*)iter->data;
-		stree_add(f);
-	}
+	/* get top of the current stack trace and put in the tree view,
+	the rest is loaded when scrolled to */
+	load_stack_frames();
 	stree_select_first_frame(TRUE);
 
-	/* files */
-	files = active_module->get_files();
-	/* remove from list and make writable those files,
-	that are not in the current list */
-	iter = read_only_pages;
-	while (iter)
-	{
-		if (!g_list_find_custom(files, iter->data, (GCompareFunc)g_strcmp0))
-		{
-			GList *next;
-
-			/* set document writable */
-			GeanyDocument *doc = document_find_by_real_path((const gchar*)iter->data);
-			if (doc)
-				scintilla_send_message(doc->editor->sci, SCI_SETREADONLY, 0, 0);
-
-			/* free file name */
-			g_free(iter->data);
-			/* save next item pointer */
-			next = iter->next;
-			/* remove current item */
-			read_only_pages = g_list_delete_link(read_only_pages, iter);
-
-			/* set next item and continue */
-			iter = next;
-			continue;
-		}
-
-		iter = iter->next;
-	}
-	/* add to the list and make readonly those files
-	from the current list that are new */
-	iter = files;
-	while (iter)
-	{
-		if (!g_list_find_custom(read_only_pages, iter->data, (GCompareFunc)g_strcmp0))
-		{
-			/* set document readonly */
-			GeanyDocument *doc = document_find_by_real_path((const gchar*)iter->data);
-			if (doc)
-				scintilla_send_message(doc->editor->sci, SCI_SETREADONLY, 1, 0);
+	/* remove calltips which values have changed from the cache */
+	update_calltips();
 
-			/* add new file to the list */
-			read_only_pages = g_list_append(read_only_pages, g_strdup((gchar*)iter->data));
-		}
-		iter = iter->next;
-	}
-	g_list_free(files);
+	/* files (refreshed by the module only when libraries are loaded or unloaded) */
+	if (read_only_generation != active_module->get_files_generation())
+		update_read_only_pages();
 
 	/* autos */
 	autos = active_module->get_autos();
@@ -782,7 +991,6 @@ static void on_debugger_exited (int code)
 {
 	GtkTextIter start, end;
 	GtkTextBuffer *buffer;
-	GList *iter;
 
 	/* remove marker for current instruction if was set */
 	if (stack)
@@ -818,21 +1026,27 @@ static void on_debugger_exited (int code)
 		bptree_set_readonly(FALSE);
 	
 	/* set files that was readonly during debug writable */
-	for (iter = read_only_pages; iter; iter = iter->next)
+	if (read_only_pages)
 	{
-		GeanyDocument *doc = document_find_by_real_path((const gchar*)iter->data);
-		if (doc)
-			scintilla_send_message(doc->editor->sci, SCI_SETREADONLY, 0, 0);
+		int i;
+		foreach_document(i)
+		{
+			GeanyDocument *doc = document_index(i);
+			if (doc->real_path && g_hash_table_lookup(read_only_pages, doc->real_path))
+				scintilla_send_message(doc->editor->sci, SCI_SETREADONLY, 0, 0);
+		}
 
-		/* free file name */
-		g_free(iter->data);
+		g_hash_table_destroy(read_only_pages);
+		read_only_pages = NULL;
 	}
-	g_list_free(read_only_pages);
-	read_only_pages = NULL;
+	read_only_generation = 0;
 
 	/* clear and destroy calltips cache */
-	g_hash_table_destroy(calltips);
-	calltips = NULL;
+	clear_calltips(FALSE);
+	stack_depth = -1;
+	g_free(calltip_pending);
+	calltip_pending = NULL;
+	calltip_cb = NULL;
 
 	/* enable widgets */
 	enable_sensitive_widgets(TRUE);
@@ -898,6 +1112,78 @@ static void on_thread_added (int thread_id)
 	stree_add_thread(thread_id);
 }
 
+/* 
+ * called from debugger module when a calltip has been evaluated 
+ */
+static void on_calltip_evaluated(variable *var, GList *children)
+{
+	GString *calltip_str;
+	gchar *calltip;
+	calltip_entry *entry;
+
+	if (!calltip_pending)
+	{
+		/* nothing waits for it, so the GDB variable isn't cached either */
+		if (var && var->internal->len)
+			active_module->release_calltip(var->internal->str);
+		return;
+	}
+
+	calltip_str = get_calltip_line(var, TRUE);
+	if (calltip_str)
+	{
+		int lines_left = MAX_CALLTIP_HEIGHT - 1;
+		GList *child = var->has_children ? children : NULL;
+		while (child && lines_left)
+		{
+			variable *varchild = (variable*)child->data;
+			GString *child_string = get_calltip_line(varchild, FALSE);
+			g_string_append_printf(calltip_str, "\n%s", child_string->str);
+			g_string_free(child_string, TRUE);
+
+			child = child->next;
+			lines_left--;
+		}
+		if (!lines_left && child)
+		{
+			g_string_append(calltip_str, "\n\t\t........");
+		}
+
+		calltip = g_string_free(calltip_str, FALSE);
+
+		if (!calltips)
+		{
+			calltips = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)calltip_entry_free);
+			calltip_keys = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)g_free);
+			calltips_lru = g_queue_new();
+		}
+		if (!calltips_frames)
+			calltips_frames = get_frames_signature();
+
+		entry = g_new(calltip_entry, 1);
+		entry->text = calltip;
+		entry->internal = g_strdup(var->internal->str);
+		g_queue_push_head(calltips_lru, calltip_pending);
+		entry->link = g_queue_peek_head_link(calltips_lru);
+		g_hash_table_insert(calltips, calltip_pending, entry);
+		g_hash_table_insert(calltip_keys, g_strdup(var->internal->str), g_strdup(calltip_pending));
+		calltip_pending = NULL;
+
+		/* the least recently used calltips make way for the new one */
+		while (g_hash_table_size(calltips) > MAX_CACHED_CALLTIPS)
+			remove_calltip((gchar*)g_queue_peek_tail(calltips_lru));
+
+		if (calltip_cb)
+			calltip_cb(calltip);
+	}
+	else
+	{
+		g_free(calltip_pending);
+		calltip_pending = NULL;
+	}
+	calltip_cb = NULL;
+}
+
 /* callbacks structure to pass to debugger module */
 dbg_callbacks callbacks = {
 	on_debugger_run,
@@ -908,6 +1194,7 @@ dbg_callbacks callbacks = {
 	on_debugger_error,
 	on_thread_added,
 	on_thread_removed,
+	on_calltip_evaluated,
 };
 
 /*
@@ -926,9 +1213,6 @@ static void on_select_frame(int frame_number)
 
 	active_module->set_active_frame(frame_number);
 	
-	/* clear calltips cache */
-	g_hash_table_remove_all(calltips);
-	
 	/* autos */
 	autos = active_module->get_autos();
 	update_variables(GTK_TREE_VIEW(atree), NULL, autos);
@@ -985,7 +1269,7 @@ void debug_init(void)
 	gtk_container_add(GTK_CONTAINER(tab_autos), atree);
 	
 	/* create stack trace page */
-	stree = stree_init(editor_open_position, on_select_frame);
+	stree = stree_init(editor_open_position, on_select_frame, on_load_more_frames);
 	tab_call_stack = gtk_scrolled_window_new(
 		gtk_tree_view_get_hadjustment(GTK_TREE_VIEW(stree )),
 		gtk_tree_view_get_vadjustment(GTK_TREE_VIEW(stree ))
@@ -1313,57 +1597,51 @@ gchar* debug_evaluate_expression(gchar *expression)
 }
 
 /*
- * return list of strings for the calltip
+ * return calltip for the expression in the current frame if it's cached,
+ * otherwise starts its asyncronous evaluation and returns NULL,
+ * cb is called when the evaluated calltip is ready (unless cancelled)
  * first line is a header, others should be shifted right with tab
  */
-gchar* debug_get_calltip_for_expression(gchar* expression)
+gchar* debug_get_calltip_for_expression(gchar* expression, calltip_callback cb)
 {
-	gchar *calltip = NULL;
-	if (!calltips || !(calltip = g_hash_table_lookup(calltips, expression)))
-	{
-		GString *calltip_str = NULL;
-		variable *var = active_module->add_watch(expression);
-		if (var)
-		{
-			calltip_str = get_calltip_line(var, TRUE);
-			if (var->has_children)
-			{
-				int lines_left = MAX_CALLTIP_HEIGHT - 1;
-				GList* children = active_module->get_children(var->internal->str); 
-				GList* child = children;
-				while(child && lines_left)
-				{
-					variable *varchild = (variable*)child->data;
-					GString *child_string = get_calltip_line(varchild, FALSE);
-					g_string_append_printf(calltip_str, "\n%s", child_string->str);
-					g_string_free(child_string, TRUE);
-
-					child = child->next;
-					lines_left--;
-				}
-				if (!lines_left && child)
-				{
-					g_string_append(calltip_str, "\n\t\t........");
-				}
-				g_list_foreach(children, (GFunc)variable_free, NULL);
-				g_list_free(children);
-			}
+	gchar *key = get_calltip_key(expression);
+	calltip_entry *entry = calltips ? (calltip_entry*)g_hash_table_lookup(calltips, key) : NULL;
+	gchar *calltip = entry ? entry->text : NULL;
 
-			active_module->remove_watch(var->internal->str);
-
-			calltip = g_string_free(calltip_str, FALSE);
-
-			if (!calltips)
-			{
-				calltips = g_hash_table_new_full(g_str_hash, g_str_equal, (GDestroyNotify)g_free, (GDestroyNotify)g_free);
-			}
-			g_hash_table_insert(calltips, g_strdup(expression), calltip);
-		}
+	if (entry)
+	{
+		/* cached, now the most recently used */
+		g_queue_unlink(calltips_lru, entry->link);
+		g_queue_push_head_link(calltips_lru, entry->link);
+		g_free(key);
 	}
+	else if (calltip_pending && !strcmp(calltip_pending, key))
+	{
+		/* already being evaluated */
+		g_free(key);
+	}
+	else if (active_module->request_calltip(expression, MAX_CALLTIP_HEIGHT - 1))
+	{
+		g_free(calltip_pending);
+		calltip_pending = key;
+	}
+	else
+		g_free(key);
+
+	calltip_cb = calltip ? NULL : cb;
 
 	return calltip;
 }
 
+/*
+ * cancels showing of the calltip being evaluated
+ * (it is still cached when ready)
+ */
+void debug_cancel_calltip(void)
+{
+	calltip_cb = NULL;
+}
+
 /*
  * check whether source for the current instruction
  * is avaiable
@@ -1390,7 +1668,7 @@ void debug_jump_to_current_instruction(void)
 void debug_on_file_open(GeanyDocument *doc)
 {
 	const gchar *file = DOC_FILENAME(doc);
-	if (g_list_find_custom(read_only_pages, (gpointer)file, (GCompareFunc)g_strcmp0))
+	if (read_only_pages && g_hash_table_lookup(read_only_pages, file))
 		scintilla_send_message(doc->editor->sci, SCI_SETREADONLY, 1, 0);
 }
 
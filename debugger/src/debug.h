@@ -30,6 +30,9 @@
 /* function type to execute on interrupt */
 typedef void	(*bs_callback)(gpointer);
 
+/* function type to execute when a calltip has been evaluated */
+typedef void	(*calltip_callback)(const gchar *calltip);
+
 void			debug_init(void);
 enum dbs		debug_get_state(void);
 void			debug_run(void);
@@ -50,7 +53,8 @@ gchar*			debug_evaluate_expression(gchar *expression);
 gboolean		debug_current_instruction_have_sources(void);
 void			debug_jump_to_current_instruction(void);
 void			debug_on_file_open(GeanyDocument *doc);
-gchar*			debug_get_calltip_for_expression(gchar* expression);
+gchar*			debug_get_calltip_for_expression(gchar* expression, calltip_callback cb);
+void			debug_cancel_calltip(void);
 GList*			debug_get_stack(void);
 void			debug_restart(void);
 int				debug_get_active_frame(void);
@@ -45,6 +45,7 @@ typedef struct _dbg_callbacks {
 	void (*report_error) (const gchar* message);
 	void (*add_thread) (int thread_id);
 	void (*remove_thread) (int thread_id);
+	void (*set_calltip) (struct _variable *var, GList *children);
 } dbg_callbacks;
 
 typedef enum _variable_type {
@@ -116,7 +117,8 @@ typedef struct _dbg_module {
 	gboolean (*set_break) (breakpoint* bp, break_set_activity bsa);
 	gboolean (*remove_break) (breakpoint* bp);
 
-	GList* (*get_stack) (void);
+	GList* (*get_stack) (int low, int high);
+	int (*get_stack_depth) (int max_depth);
 
 	void (*set_active_frame)(int frame_number);
 	int (*get_active_frame)(void);
@@ -125,12 +127,17 @@ typedef struct _dbg_module {
 	GList* (*get_watches) (void);
 	
 	GList* (*get_files) (void);
+	guint (*get_files_generation) (void);
 
 	GList* (*get_children) (gchar* path);
 	variable* (*add_watch)(gchar* expression);
 	void (*remove_watch)(gchar* path);
 
 	gchar* (*evaluate_expression)(gchar *expression);
+
+	gboolean (*request_calltip)(gchar *expression, int max_children);
+	void (*release_calltip)(gchar *internal);
+	GList* (*update_calltips)(void);
 	
 	gboolean (*request_interrupt) (void);
 	gchar* (*error_message) (void);
@@ -152,15 +159,20 @@ typedef struct _dbg_module {
 	set_break, \
 	remove_break, \
 	get_stack, \
+	get_stack_depth, \
 	set_active_frame, \
 	get_active_frame, \
 	get_autos, \
 	get_watches, \
 	get_files, \
+	get_files_generation, \
 	get_children, \
 	add_watch, \
 	remove_watch, \
 	evaluate_expression, \
+	request_calltip, \
+	release_calltip, \
+	update_calltips, \
 	request_interrupt, \
 	error_message, \
 	MODULE_FEATURES }
@@ -50,6 +50,7 @@ enum
    S_HAVE_SOURCE,
    S_THREAD_ID,
    S_ACTIVE,
+   S_MORE_FRAMES,
    S_N_COLUMNS
 };
 
@@ -63,6 +64,13 @@ static int active_frame_index = 0;
 /* callbacks */
 static select_frame_cb select_frame = NULL;
 static move_to_line_cb move_to_line = NULL;
+static load_more_frames_cb load_more_frames = NULL;
+
+/* trailing row of the active thread stack, if not all frames are loaded */
+static GtkTreeRowReference *more_frames = NULL;
+
+/* source id of the check whether more frames row is visible */
+static guint more_frames_check_id = 0;
 
 /* tree view, model and store handles */
 static GtkWidget *tree = NULL;
@@ -72,13 +80,88 @@ static GtkTreeStore *store = NULL;
 /* cell renderer for a frame arrow */
 static GtkCellRenderer *renderer_arrow = NULL;
 
+/* 
+ * checks whether the path is the one of more frames row
+ */
+static gboolean is_more_frames_path(GtkTreePath *path)
+{
+	gboolean more = FALSE;
+	if (more_frames && gtk_tree_row_reference_valid(more_frames))
+	{
+		GtkTreePath *more_path = gtk_tree_row_reference_get_path(more_frames);
+		more = !gtk_tree_path_compare(path, more_path);
+		gtk_tree_path_free(more_path);
+	}
+	return more;
+}
+
+/* 
+ * loads more frames if more frames row is visible
+ * (its thread is expanded and the row is scrolled into view)
+ */
+static gboolean on_check_more_frames(gpointer data)
+{
+	GtkTreePath *start, *end;
+
+	more_frames_check_id = 0;
+
+	if (more_frames && gtk_tree_row_reference_valid(more_frames) &&
+		gtk_tree_view_get_visible_range(GTK_TREE_VIEW(tree), &start, &end))
+	{
+		GtkTreePath *more_path = gtk_tree_row_reference_get_path(more_frames);
+		GtkTreePath *thread_path = gtk_tree_path_copy(more_path);
+		gboolean visible;
+
+		gtk_tree_path_up(thread_path);
+		visible = gtk_tree_view_row_expanded(GTK_TREE_VIEW(tree), thread_path) &&
+			gtk_tree_path_compare(start, more_path) <= 0 &&
+			gtk_tree_path_compare(more_path, end) <= 0;
+
+		gtk_tree_path_free(thread_path);
+		gtk_tree_path_free(more_path);
+		gtk_tree_path_free(start);
+		gtk_tree_path_free(end);
+
+		if (visible)
+			load_more_frames();
+	}
+
+	return FALSE;
+}
+
+/* 
+ * schedules a check whether more frames row is visible
+ */
+static void check_more_frames(void)
+{
+	if (more_frames && !more_frames_check_id)
+		more_frames_check_id = g_idle_add(on_check_more_frames, NULL);
+}
+
+/* 
+ * tree scrolled or resized callback
+ */
+static void on_adjustment_changed(GtkAdjustment *adjustment, gpointer user_data)
+{
+	check_more_frames();
+}
+
+/* 
+ * thread row expanded callback
+ */
+static void on_row_expanded(GtkTreeView *tree_view, GtkTreeIter *iter, GtkTreePath *path, gpointer user_data)
+{
+	check_more_frames();
+}
+
 /* 
  * frame arrow clicked callback
  */
 static void on_frame_arrow_clicked(CellRendererFrameIcon *cell_renderer, gchar *path, gpointer user_data)
 {
     GtkTreePath *new_active_frame = gtk_tree_path_new_from_string (path);
-    if (gtk_tree_path_get_indices(new_active_frame)[1] != active_frame_index)
+    if (gtk_tree_path_get_indices(new_active_frame)[1] != active_frame_index &&
+		!is_more_frames_path(new_active_frame))
 	{
 		GtkTreeIter iter;
 
@@ -154,20 +237,24 @@ static gboolean on_query_tooltip(GtkWidget *widget, gint x, gint y, gboolean key
 static void on_render_arrow(GtkTreeViewColumn *tree_column, GtkCellRenderer *cell, GtkTreeModel *tree_model,
 	GtkTreeIter *iter, gpointer data)
 {
+	gboolean more;
 	GtkTreePath *tpath = gtk_tree_model_get_path(model, iter);
-	g_object_set(cell, "visible", 1 != gtk_tree_path_get_depth(tpath), NULL);
+	gtk_tree_model_get(tree_model, iter, S_MORE_FRAMES, &more, -1);
+	g_object_set(cell, "visible", 1 != gtk_tree_path_get_depth(tpath) && !more, NULL);
 	gtk_tree_path_free(tpath);
 }
 
 /* 
- * empty line renderer text for thread row
+ * empty line renderer text for thread and more frames rows
  */
 static void on_render_line(GtkTreeViewColumn *tree_column, GtkCellRenderer *cell, GtkTreeModel *tree_model,
 	GtkTreeIter *iter, gpointer data)
 {
+	gboolean more;
 	GtkTreePath *tpath = gtk_tree_model_get_path(model, iter);
+	gtk_tree_model_get(tree_model, iter, S_MORE_FRAMES, &more, -1);
 
-	if (1 == gtk_tree_path_get_depth(tpath))
+	if (1 == gtk_tree_path_get_depth(tpath) || more)
 	{
 		g_object_set(cell, "text", "", NULL);
 	}
@@ -281,7 +368,12 @@ static void on_selection_changed(GtkTreeSelection *treeselection, gpointer user_
 	rows = gtk_tree_selection_get_selected_rows(treeselection, &model);
 	path = (GtkTreePath*)rows->data;
 
-	if (2 == gtk_tree_path_get_depth(path))
+	if (is_more_frames_path(path))
+	{
+		/* selecting more frames row loads them */
+		load_more_frames();
+	}
+	else if (2 == gtk_tree_path_get_depth(path))
 	{
 		gboolean have_source;
 		GtkTreeIter iter;
@@ -320,13 +412,15 @@ static void on_selection_changed(GtkTreeSelection *treeselection, gpointer user_
 /*
  *	inits stack trace tree
  */
-GtkWidget* stree_init(move_to_line_cb ml, select_frame_cb sf)
+GtkWidget* stree_init(move_to_line_cb ml, select_frame_cb sf, load_more_frames_cb lm)
 {
 	GtkTreeViewColumn *column;
 	GtkCellRenderer *renderer;
+	GtkAdjustment *vadjustment;
 
 	move_to_line = ml;
 	select_frame = sf;
+	load_more_frames = lm;
 
 	/* create tree view */
 	store = gtk_tree_store_new (
@@ -338,6 +432,7 @@ GtkWidget* stree_init(move_to_line_cb ml, select_frame_cb sf)
 		G_TYPE_STRING,
 		G_TYPE_INT,
 		G_TYPE_INT,
+		G_TYPE_INT,
 		G_TYPE_INT);
 		
 	model = GTK_TREE_MODEL(store);
@@ -356,6 +451,12 @@ GtkWidget* stree_init(move_to_line_cb ml, select_frame_cb sf)
 	g_signal_connect(G_OBJECT(tree), "button-press-event", G_CALLBACK(on_msgwin_button_press), NULL);
 	
 	g_signal_connect(G_OBJECT(tree), "query-tooltip", G_CALLBACK (on_query_tooltip), NULL);
+	g_signal_connect(G_OBJECT(tree), "row-expanded", G_CALLBACK (on_row_expanded), NULL);
+
+	/* load more frames when scrolled to the end of the loaded ones */
+	vadjustment = gtk_tree_view_get_vadjustment(GTK_TREE_VIEW(tree));
+	g_signal_connect(G_OBJECT(vadjustment), "value-changed", G_CALLBACK (on_adjustment_changed), NULL);
+	g_signal_connect(G_OBJECT(vadjustment), "changed", G_CALLBACK (on_adjustment_changed), NULL);
 
 	/* creating columns */
 	/* address */
@@ -484,6 +585,16 @@ void stree_select_first_frame(gboolean make_active)
  */
 void stree_destroy(void)
 {
+	if (more_frames_check_id)
+	{
+		g_source_remove(more_frames_check_id);
+		more_frames_check_id = 0;
+	}
+	if (more_frames)
+	{
+		gtk_tree_row_reference_free(more_frames);
+		more_frames = NULL;
+	}
 	if (threads)
 	{
 		g_hash_table_destroy(threads);
@@ -587,3 +698,46 @@ void stree_set_active_thread_id(int thread_id)
 {
 	active_thread_id = thread_id;
 }
+
+/*
+ *	adds or removes the trailing row of the active thread stack
+ *	that loads more frames when visible or selected
+ */
+void stree_set_more_frames(gboolean more)
+{
+	GtkTreeIter iter;
+
+	if (more_frames)
+	{
+		if (gtk_tree_row_reference_valid(more_frames))
+		{
+			GtkTreePath *path = gtk_tree_row_reference_get_path(more_frames);
+			gtk_tree_model_get_iter(model, &iter, path);
+			gtk_tree_store_remove(store, &iter);
+			gtk_tree_path_free(path);
+		}
+		gtk_tree_row_reference_free(more_frames);
+		more_frames = NULL;
+	}
+
+	if (more)
+	{
+		GtkTreeRowReference *reference = (GtkTreeRowReference*)g_hash_table_lookup(threads, (gpointer)active_thread_id);
+		GtkTreeIter thread_iter;
+		GtkTreePath *path = gtk_tree_row_reference_get_path(reference);
+		gtk_tree_model_get_iter(model, &thread_iter, path);
+		gtk_tree_path_free(path);
+
+		gtk_tree_store_append(store, &iter, &thread_iter);
+		gtk_tree_store_set (store, &iter,
+						S_ADRESS, "...",
+						S_MORE_FRAMES, TRUE,
+						-1);
+
+		path = gtk_tree_model_get_path(model, &iter);
+		more_frames = gtk_tree_row_reference_new(model, path);
+		gtk_tree_path_free(path);
+
+		check_more_frames();
+	}
+}
@@ -190,13 +190,12 @@ void glatex_bibtex_insert_cite(gchar *reference_name, gchar *option)
 	g_free(tmp);
 }
 
-/* Parses a given bib file and inserting found references into a given comboboy */
-void glatex_parse_bib_file(const gchar* file, gpointer combobox)
+/* Parses a given bib file and appends the found references to labels */
+void glatex_parse_bib_file(const gchar* file, GPtrArray *labels)
 {
 	gchar **bib_entries = NULL;
 	int i = 0;
 	LaTeXLabel *tmp;
-	gchar *tmp_label_name = NULL;
 
 	if (file != NULL)
 	{
@@ -217,13 +216,11 @@ void glatex_parse_bib_file(const gchar* file, gpointer combobox)
 				if  (g_str_has_prefix(bib_entries[i], "@"))
 				{
 					tmp = glatex_parseLine_bib(bib_entries[i]);
-					tmp_label_name = g_strdup(tmp->label_name);
-					gtk_combo_box_append_text(GTK_COMBO_BOX(combobox), tmp_label_name);
+					g_ptr_array_add(labels, (gchar *) tmp->label_name);
 					g_free(tmp);
-					g_free(tmp_label_name);
 				}
 			}
-			g_free(bib_entries);
+			g_strfreev(bib_entries);
 		}
 	}
 }
@@ -245,6 +242,12 @@ LaTeXLabel* glatex_parseLine_bib(const gchar *line)
 	{
 		x++;
 	}
+	/* Not an entry, e.g. a lonely @ */
+	if (*x == '\0')
+	{
+		label->label_name = g_strdup("");
+		return label;
+	}
 	tmp_string = x + 1;
 
 	while (*x != '\0' && *x != ',')
@@ -84,7 +84,7 @@ void glatex_insert_bibtex_entry(G_GNUC_UNUSED GtkMenuItem * menuitem, gpointer g
 void glatex_bibtex_write_entry(GPtrArray *entry, gint doctype);
 GPtrArray *glatex_bibtex_init_empty_entry(void);
 void glatex_bibtex_insert_cite(gchar *reference_name, gchar *option);
-void glatex_parse_bib_file(const gchar* file, gpointer combobox);
+void glatex_parse_bib_file(const gchar* file, GPtrArray *labels);
 LaTeXLabel* glatex_parseLine_bib(const gchar *line);
 
 
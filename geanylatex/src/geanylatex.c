@@ -539,6 +539,13 @@ static gboolean on_editor_notify(G_GNUC_UNUSED GObject *object, GeanyEditor *edi
 		{
 			switch (nt->ch)
 			{
+				case '{':
+				case ',':
+				{
+					/* Offer the known labels inside \ref{} and \cite{} */
+					glatex_autocomplete_label(editor, pos);
+					break;
+				}
 				case '\n':
 				case '\r':
 				{
@@ -893,8 +900,8 @@ glatex_insert_ref_activated(G_GNUC_UNUSED GtkMenuItem * menuitem,
 	GtkWidget *radio3 = NULL;
 	GtkWidget *tmp_entry = NULL;
 	GtkTreeModel *model = NULL;
+	GtkEntryCompletion *completion = NULL;
 	GeanyDocument *doc = NULL;
-	GSList *file_list = NULL;
 	gchar *dir;
 
 	doc = document_get_current();
@@ -913,20 +920,28 @@ glatex_insert_ref_activated(G_GNUC_UNUSED GtkMenuItem * menuitem,
 	gtk_table_set_row_spacings(GTK_TABLE(table), 6);
 
 	label_ref = gtk_label_new(_("Reference name:"));
-	textbox_ref = gtk_combo_box_entry_new_text();
 
+	/* The labels are cached, only changed .aux files are read again */
 	if (doc->real_path != NULL)
 	{
 		dir = g_path_get_dirname(doc->real_path);
-		file_list = utils_get_file_list_full(dir, TRUE, TRUE, NULL);
-		glatex_add_Labels(textbox_ref, file_list);
-		model = gtk_combo_box_get_model(GTK_COMBO_BOX(textbox_ref));
-		gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(model),
-			0, GTK_SORT_ASCENDING);
-		g_slist_foreach(file_list, (GFunc) g_free, NULL);
-		g_slist_free(file_list);
-		if (dir != NULL)
-			g_free(dir);
+		model = glatex_get_label_model(dir, GLATEX_LABELS_REF);
+		g_free(dir);
+	}
+	if (model != NULL)
+	{
+		textbox_ref = gtk_combo_box_entry_new_with_model(model, 0);
+		completion = gtk_entry_completion_new();
+		gtk_entry_completion_set_model(completion, model);
+		gtk_entry_completion_set_text_column(completion, 0);
+		gtk_entry_set_completion(GTK_ENTRY(gtk_bin_get_child(GTK_BIN(textbox_ref))),
+			completion);
+		g_object_unref(completion);
+		g_object_unref(model);
+	}
+	else
+	{
+		textbox_ref = gtk_combo_box_entry_new_text();
 	}
 
 
@@ -1260,6 +1275,7 @@ on_insert_bibtex_dialog_activate(G_GNUC_UNUSED GtkMenuItem *menuitem,
 	GtkWidget *table = NULL;
 	GtkWidget *tmp_entry = NULL;
 	GtkTreeModel *model = NULL;
+	GtkEntryCompletion *completion = NULL;
 	GeanyDocument *doc = NULL;
 
 	doc = document_get_current();
@@ -1278,34 +1294,30 @@ on_insert_bibtex_dialog_activate(G_GNUC_UNUSED GtkMenuItem *menuitem,
 	gtk_table_set_row_spacings(GTK_TABLE(table), 6);
 
 	label = gtk_label_new(_("BibTeX reference name:"));
-	textbox = gtk_combo_box_entry_new_text();
 
+	/* The keys are cached, only changed .bib files are read again */
 	if (doc->real_path != NULL)
 	{
-		GDir *dir;
 		gchar *tmp_dir;
-		const gchar *filename;
 
 		tmp_dir = g_path_get_dirname(doc->real_path);
-		dir = g_dir_open(tmp_dir, 0, NULL);
-
-		if(dir == NULL)
-			g_free(tmp_dir);
-		g_return_if_fail(dir != NULL);
-
-		foreach_dir(filename, dir)
-		{
-			gchar *fullpath = NULL;
-			fullpath = g_build_path(G_DIR_SEPARATOR_S, tmp_dir, filename, NULL);
-
-			glatex_parse_bib_file(fullpath, textbox);
-			g_free(fullpath);
-		}
+		model = glatex_get_label_model(tmp_dir, GLATEX_LABELS_CITE);
 		g_free(tmp_dir);
-		g_dir_close(dir);
-		model = gtk_combo_box_get_model(GTK_COMBO_BOX(textbox));
-		gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(model),
-			0, GTK_SORT_ASCENDING);
+	}
+	if (model != NULL)
+	{
+		textbox = gtk_combo_box_entry_new_with_model(model, 0);
+		completion = gtk_entry_completion_new();
+		gtk_entry_completion_set_model(completion, model);
+		gtk_entry_completion_set_text_column(completion, 0);
+		gtk_entry_set_completion(GTK_ENTRY(gtk_bin_get_child(GTK_BIN(textbox))),
+			completion);
+		g_object_unref(completion);
+		g_object_unref(model);
+	}
+	else
+	{
+		textbox = gtk_combo_box_entry_new_text();
 	}
 
 
@@ -2418,4 +2430,5 @@ plugin_cleanup(void)
 	g_free(glatex_ref_chapter_string);
 	g_free(glatex_ref_page_string);
 	g_free(glatex_ref_all_string);
+	glatex_free_label_cache();
 }
@@ -20,15 +20,49 @@
  */
 
 #include <string.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
 #include "reftex.h"
 #include "latexutils.h"
 
-void glatex_parse_aux_file(gchar *file, gpointer combobox)
+
+/* Labels found inside one .aux or .bib file. They are kept as long as
+ * the file doesn't change on disk. */
+typedef struct
+{
+	time_t mtime;
+	off_t size;
+	GPtrArray *labels;
+} LabelFile;
+
+/* All labels of one kind found inside one directory */
+typedef struct
+{
+	GHashTable *files;		/* path -> LabelFile */
+	GPtrArray *labels;		/* sorted and unique, strings owned by files */
+	GtkListStore *store;	/* the same for combo boxes, NULL until needed */
+} LabelIndex;
+
+/* directory -> LabelIndex, for each kind of label */
+static GHashTable *label_indexes[GLATEX_LABELS_N_KINDS];
+
+static const gchar *ref_commands[] =
+{
+	"ref", "pageref", "eqref", "autoref", "nameref", "vref", "cref", "Cref", NULL
+};
+
+static const gchar *cite_commands[] =
+{
+	"cite", "citep", "citet", "citeauthor", "citeyear", "nocite",
+	"parencite", "textcite", "autocite", "footcite", NULL
+};
+
+
+void glatex_parse_aux_file(const gchar *file, GPtrArray *labels)
 {
 	gchar **aux_entries = NULL;
 	int i = 0;
 	LaTeXLabel *tmp;
-	gchar *tmp_label_name = NULL;
 
 	if (file != NULL)
 	{
@@ -45,26 +79,321 @@ void glatex_parse_aux_file(gchar *file, gpointer combobox)
 				if  (g_str_has_prefix(aux_entries[i], "\\newlabel"))
 				{
 					tmp = glatex_parseLine(aux_entries[i]);
-					tmp_label_name = g_strdup(tmp->label_name);
-					gtk_combo_box_append_text(GTK_COMBO_BOX(combobox), tmp_label_name);
+					g_ptr_array_add(labels, (gchar *) tmp->label_name);
 					g_free(tmp);
-					g_free(tmp_label_name);
 				}
 			}
-			g_free(aux_entries);
+			g_strfreev(aux_entries);
+		}
+	}
+}
+
+
+static gboolean is_label_file(const gchar *file, gint kind)
+{
+	if (kind == GLATEX_LABELS_REF)
+		return g_str_has_suffix(file, ".aux");
+
+	/* Also try to ignore biblatex autogenerated files */
+	return g_str_has_suffix(file, ".bib") && !g_str_has_suffix(file, "-blx.bib");
+}
+
+
+static void label_file_free(LabelFile *label_file)
+{
+	g_ptr_array_free(label_file->labels, TRUE);
+	g_free(label_file);
+}
+
+
+static void label_index_free(LabelIndex *index)
+{
+	g_hash_table_destroy(index->files);
+	if (index->labels != NULL)
+		g_ptr_array_free(index->labels, TRUE);
+	if (index->store != NULL)
+		g_object_unref(index->store);
+	g_free(index);
+}
+
+
+static gint compare_labels(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(const gchar **) a, *(const gchar **) b);
+}
+
+
+/* Re-reads the files of the directory which changed since last time and
+ * rebuilds the sorted list of labels if anything changed. */
+static void label_index_update(LabelIndex *index, const gchar *dir, gint kind)
+{
+	GDir *gdir;
+	const gchar *filename;
+	GHashTable *seen;
+	GHashTableIter iter;
+	gpointer key, value;
+	gboolean changed = FALSE;
+	guint i, j;
+
+	seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+	gdir = g_dir_open(dir, 0, NULL);
+
+	if (gdir != NULL)
+	{
+		foreach_dir(filename, gdir)
+		{
+			gchar *fullpath;
+			struct stat st;
+			LabelFile *label_file;
+
+			if (!is_label_file(filename, kind))
+				continue;
+
+			fullpath = g_build_path(G_DIR_SEPARATOR_S, dir, filename, NULL);
+			if (g_stat(fullpath, &st) != 0 || !S_ISREG(st.st_mode))
+			{
+				g_free(fullpath);
+				continue;
+			}
+
+			label_file = g_hash_table_lookup(index->files, fullpath);
+			if (label_file == NULL ||
+				label_file->mtime != st.st_mtime || label_file->size != st.st_size)
+			{
+				label_file = g_new0(LabelFile, 1);
+				label_file->mtime = st.st_mtime;
+				label_file->size = st.st_size;
+				label_file->labels = g_ptr_array_new_with_free_func(g_free);
+
+				if (kind == GLATEX_LABELS_REF)
+					glatex_parse_aux_file(fullpath, label_file->labels);
+				else
+					glatex_parse_bib_file(fullpath, label_file->labels);
+
+				g_hash_table_insert(index->files, fullpath, label_file);
+				changed = TRUE;
+			}
+			else
+				g_free(fullpath);
+
+			g_hash_table_insert(seen, label_file, label_file);
+		}
+		g_dir_close(gdir);
+	}
+
+	/* Forget about deleted files */
+	g_hash_table_iter_init(&iter, index->files);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+	{
+		if (g_hash_table_lookup(seen, value) == NULL)
+		{
+			g_hash_table_iter_remove(&iter);
+			changed = TRUE;
+		}
+	}
+	g_hash_table_destroy(seen);
+
+	if (!changed && index->labels != NULL)
+		return;
+
+	/* Merge the labels of all files */
+	if (index->labels != NULL)
+		g_ptr_array_free(index->labels, TRUE);
+	index->labels = g_ptr_array_new();
+
+	g_hash_table_iter_init(&iter, index->files);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		LabelFile *label_file = value;
+
+		for (i = 0; i < label_file->labels->len; i++)
+			g_ptr_array_add(index->labels, g_ptr_array_index(label_file->labels, i));
+	}
+	g_ptr_array_sort(index->labels, compare_labels);
+
+	/* Remove duplicates and empty labels */
+	for (i = 0, j = 0; i < index->labels->len; i++)
+	{
+		const gchar *label = g_ptr_array_index(index->labels, i);
+
+		if (EMPTY(label) ||
+			(j > 0 && utils_str_equal(label, g_ptr_array_index(index->labels, j - 1))))
+			continue;
+		g_ptr_array_index(index->labels, j++) = (gpointer) label;
+	}
+	g_ptr_array_set_size(index->labels, j);
+
+	if (index->store != NULL)
+	{
+		g_object_unref(index->store);
+		index->store = NULL;
+	}
+}
+
+
+/* Returns the sorted labels (GLATEX_LABELS_REF) or BibTeX keys
+ * (GLATEX_LABELS_CITE) found in the files of dir. Files are only parsed
+ * again when they changed since the last call. The array is owned by
+ * the cache. */
+const GPtrArray *glatex_get_labels(const gchar *dir, gint kind)
+{
+	LabelIndex *index;
+
+	g_return_val_if_fail(dir != NULL, NULL);
+	g_return_val_if_fail(kind >= 0 && kind < GLATEX_LABELS_N_KINDS, NULL);
+
+	if (label_indexes[kind] == NULL)
+		label_indexes[kind] = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, (GDestroyNotify) label_index_free);
+
+	index = g_hash_table_lookup(label_indexes[kind], dir);
+	if (index == NULL)
+	{
+		index = g_new0(LabelIndex, 1);
+		index->files = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, (GDestroyNotify) label_file_free);
+		g_hash_table_insert(label_indexes[kind], g_strdup(dir), index);
+	}
+
+	label_index_update(index, dir, kind);
+
+	return index->labels;
+}
+
+
+/* Same as glatex_get_labels() as a one column model, e.g. for
+ * gtk_combo_box_entry_new_with_model(). The model is reused until the
+ * labels change. Unref it when done. */
+GtkTreeModel *glatex_get_label_model(const gchar *dir, gint kind)
+{
+	const GPtrArray *labels;
+	LabelIndex *index;
+	guint i;
+
+	labels = glatex_get_labels(dir, kind);
+	g_return_val_if_fail(labels != NULL, NULL);
+
+	index = g_hash_table_lookup(label_indexes[kind], dir);
+	if (index->store == NULL)
+	{
+		index->store = gtk_list_store_new(1, G_TYPE_STRING);
+		for (i = 0; i < labels->len; i++)
+		{
+			gtk_list_store_insert_with_values(index->store, NULL, -1,
+				0, g_ptr_array_index(labels, i), -1);
 		}
 	}
+
+	return g_object_ref(index->store);
 }
 
-void glatex_add_Labels(GtkWidget *combobox, GSList *dir)
+
+void glatex_free_label_cache(void)
 {
+	gint kind;
 
-	if (dir == NULL)
+	for (kind = 0; kind < GLATEX_LABELS_N_KINDS; kind++)
 	{
+		if (label_indexes[kind] != NULL)
+		{
+			g_hash_table_destroy(label_indexes[kind]);
+			label_indexes[kind] = NULL;
+		}
+	}
+}
+
+
+static gboolean command_in_list(const gchar *command, gsize len, const gchar **list)
+{
+	gint i;
+
+	for (i = 0; list[i] != NULL; i++)
+	{
+		if (strlen(list[i]) == len && strncmp(list[i], command, len) == 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+
+/* Called after a { or a , has been typed at pos: if it opens the argument
+ * of a \ref-like or \cite-like command, or separates keys of a \cite,
+ * offers the labels known for the document's directory. */
+void glatex_autocomplete_label(GeanyEditor *editor, gint pos)
+{
+	ScintillaObject *sci = editor->sci;
+	gchar *text;
+	gint i, end;
+	gint kind;
+	gchar last;
+	gchar *dir;
+	const GPtrArray *labels;
+	GString *list;
+	guint j;
+
+	if (editor->document->real_path == NULL || pos < 2)
 		return;
+
+	text = sci_get_contents_range(sci, MAX(0, pos - 100), pos);
+	i = strlen(text) - 1;
+	last = text[i];
+
+	/* After a comma, go back to the opening brace of the argument */
+	if (last == ',')
+	{
+		while (i >= 0 && text[i] != '{' && text[i] != '}' && text[i] != '\n')
+			i--;
+		if (i < 0 || text[i] != '{')
+			goto free_mem;
+	}
+	else if (last != '{')
+		goto free_mem;
+
+	/* Skip the optional arguments, e.g. \cite[p. 3]{ */
+	i--;
+	while (i >= 0 && text[i] == ']')
+	{
+		while (i >= 0 && text[i] != '[')
+			i--;
+		i--;
+	}
+	if (i >= 0 && text[i] == '*')
+		i--;
+
+	end = i + 1;
+	while (i >= 0 && g_ascii_isalpha(text[i]))
+		i--;
+	if (i < 0 || text[i] != '\\' || end == i + 1)
+		goto free_mem;
+
+	if (command_in_list(text + i + 1, end - i - 1, cite_commands))
+		kind = GLATEX_LABELS_CITE;
+	else if (last == '{' &&
+			 command_in_list(text + i + 1, end - i - 1, ref_commands))
+		kind = GLATEX_LABELS_REF;
+	else
+		goto free_mem;
+
+	dir = g_path_get_dirname(editor->document->real_path);
+	labels = glatex_get_labels(dir, kind);
+	g_free(dir);
+
+	if (labels == NULL || labels->len == 0)
+		goto free_mem;
+
+	list = g_string_sized_new(labels->len * 16);
+	for (j = 0; j < labels->len; j++)
+	{
+		if (j > 0)
+			g_string_append_c(list, '\n');
+		g_string_append(list, g_ptr_array_index(labels, j));
 	}
+	scintilla_send_message(sci, SCI_AUTOCSETSEPARATOR, '\n', 0);
+	scintilla_send_message(sci, SCI_AUTOCSHOW, 0, (sptr_t) list->str);
+	g_string_free(list, TRUE);
 
-	g_slist_foreach(dir, (GFunc) glatex_parse_aux_file, combobox);
+free_mem:
+	g_free(text);
 }
 
 
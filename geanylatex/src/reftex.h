@@ -25,10 +25,22 @@
 #include "geanylatex.h"
 
 
-void glatex_add_Labels(GtkWidget *combobox, GSList *dir);
+enum {
+	GLATEX_LABELS_REF = 0,
+	GLATEX_LABELS_CITE,
+	GLATEX_LABELS_N_KINDS
+};
+
+const GPtrArray *glatex_get_labels(const gchar *dir, gint kind);
+
+GtkTreeModel *glatex_get_label_model(const gchar *dir, gint kind);
+
+void glatex_free_label_cache(void);
+
+void glatex_autocomplete_label(GeanyEditor *editor, gint pos);
 
 LaTeXLabel *glatex_parseLine(const gchar *line);
 
-void glatex_parse_aux_file(gchar* file, gpointer combobox);
+void glatex_parse_aux_file(const gchar *file, GPtrArray *labels);
 
 #endif
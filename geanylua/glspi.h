@@ -144,4 +144,5 @@ void glspi_run_script(const gchar *script_file, gint caller, GKeyFile*proj, cons
 /* Pass TRUE to create hashes, FALSE to destroy them */
 void glspi_set_sci_cmd_hash(gboolean create);
 void glspi_set_key_cmd_hash(gboolean create);
+void glspi_set_script_cache(gboolean create);
 
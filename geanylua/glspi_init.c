@@ -450,6 +450,7 @@ void glspi_init (GeanyData *data, GeanyFunctions *functions, GeanyPlugin *plugin
 
 	glspi_set_sci_cmd_hash(TRUE);
 	glspi_set_key_cmd_hash(TRUE);
+	glspi_set_script_cache(TRUE);
 	build_menu();
 	hotkey_init();
 	if (g_file_test(local_data.on_init_script,G_FILE_TEST_IS_REGULAR)) {
@@ -503,6 +504,7 @@ void glspi_cleanup(void)
 	}
 	glspi_set_sci_cmd_hash(FALSE);
 	glspi_set_key_cmd_hash(FALSE);
+	glspi_set_script_cache(FALSE);
 
 }
 
@@ -6,6 +6,16 @@
 
 #define NEED_FAIL_ARG_TYPE
 #include "glspi.h"
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+
+/*
+	If a script directory contains a file with this name, all scripts in that
+	directory share one long-lived interpreter instead of getting a new one
+	for every invocation.
+*/
+#define PERSIST_MARKER "persistent.cfg"
 
 
 static KeyfileAssignFunc glspi_kfile_assign=NULL;
@@ -116,22 +126,43 @@ typedef struct _StateInfo {
 	GString *source;
 	gint line;
 	GTimer*timer;
-	gint counter;
+	gdouble painted;
 	gdouble remaining;
 	gdouble max;
-	gboolean optimized;
+	gboolean persistent;
+	gboolean busy;
 } StateInfo;
 
-static GSList *state_list=NULL;
+
+/* Number of VM instructions between checks for an expired timeout */
+#define HOOK_COUNT 1000
+
+/* Seconds between repaints of the main window while a script is running */
+#define REPAINT_INTERVAL 0.5
+
+/* Address used as the registry key for the StateInfo of an interpreter */
+static gint state_key;
+
+
+/* Precompiled script chunk, valid as long as the file is unchanged */
+typedef struct _ChunkInfo {
+	time_t mtime;
+	off_t size;
+	GByteArray *code;
+} ChunkInfo;
+
+static GHashTable *chunk_cache=NULL; /* script filename => ChunkInfo */
+static GHashTable *state_pool=NULL;  /* script directory => persistent lua_State */
 
 
 static StateInfo*find_state(lua_State *L)
 {
-	GSList*p=state_list;
-	for (p=state_list; p; p=p->next) {
-		if ( p->data && ((StateInfo*)p->data)->state==L ) { return p->data; }
-	}
-	return NULL;
+	StateInfo*si;
+	lua_pushlightuserdata(L, &state_key);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	si=lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	return si;
 }
 
 
@@ -149,6 +180,28 @@ static gchar *glspi_get_error_info(lua_State* L, gint *line)
 
 
 
+/*
+	Remember where the innermost Lua function on the stack is at, so the
+	error dialog can offer to jump there. This is only done when an error
+	occurs, so we don't need to track line numbers while the script runs.
+*/
+static void glspi_set_error_info(lua_State* L)
+{
+	StateInfo*si=find_state(L);
+	lua_Debug ar;
+	gint level;
+	if (!si) { return; }
+	for (level=0; lua_getstack(L, level, &ar); level++) {
+		if (lua_getinfo(L,"Sl",&ar) && (ar.currentline>0) && ar.source && (ar.source[0]=='@')) {
+			g_string_assign(si->source, ar.source+1);
+			si->line=ar.currentline;
+			return;
+		}
+	}
+}
+
+
+
 static gint glspi_timeout(lua_State* L)
 {
 	if (( lua_gettop(L) > 0 ) && lua_isnumber(L,1)) {
@@ -175,44 +228,38 @@ static gint glspi_yield(lua_State* L)
 
 static gint glspi_optimize(lua_State* L)
 {
-	StateInfo*si=find_state(L);
-	if (si) { si->optimized=TRUE; }
+	lua_sethook(L,NULL,0,0);
 	return 0;
 }
 
 
-/* Lua debug hook callback */
+/* Lua debug hook callback, called every HOOK_COUNT instructions */
 static void debug_hook(lua_State *L, lua_Debug *ar)
 {
 	StateInfo*si=find_state(L);
-	if (si && !si->optimized) {
-		if (lua_getinfo(L,"Sl",ar)) {
-			if (ar->source && (ar->source[0]=='@') && strcmp(si->source->str, ar->source+1)) {
-				g_string_assign(si->source, ar->source+1);
-			}
-			si->line=ar->currentline;
-		}
-		if (si->timer) {
-			if (si->timer && si->max && (g_timer_elapsed(si->timer,NULL)>si->remaining)) {
-				if ( glspi_show_question(_("Script timeout"), _(
-					"A Lua script seems to be taking excessive time to complete.\n"
-					"Do you want to continue waiting?"
-				), FALSE) )
-				{
-					si->remaining=si->max;
-					g_timer_start(si->timer);
-				} else
-				{
-					lua_pushstring(L, _("Script timeout exceeded."));
-					lua_error(L);
-				}
-			}
+	gdouble elapsed;
+	if (!(si && si->timer)) { return; }
+	elapsed=g_timer_elapsed(si->timer,NULL);
+	if (si->max && (elapsed>si->remaining)) {
+		if ( glspi_show_question(_("Script timeout"), _(
+			"A Lua script seems to be taking excessive time to complete.\n"
+			"Do you want to continue waiting?"
+		), FALSE) )
+		{
+			si->remaining=si->max;
+			si->painted=0;
+			g_timer_start(si->timer);
+			return;
+		} else
+		{
+			lua_pushstring(L, _("Script timeout exceeded."));
+			lua_error(L);
 		}
-		if (si->counter > 100000) {
-			gdk_window_invalidate_rect(gtk_widget_get_window(main_widgets->window), NULL, TRUE);
-			gdk_window_process_updates(gtk_widget_get_window(main_widgets->window), TRUE);
-			si->counter=0;
-		} else si->counter++;
+	}
+	if (elapsed-si->painted > REPAINT_INTERVAL) {
+		gdk_window_invalidate_rect(gtk_widget_get_window(main_widgets->window), NULL, TRUE);
+		gdk_window_process_updates(gtk_widget_get_window(main_widgets->window), TRUE);
+		si->painted=elapsed;
 	}
 }
 
@@ -234,6 +281,7 @@ static void glspi_pause_timer(gboolean pause, gpointer user_data)
 			if ( si->remaining < 0 ) si->remaining = 0;
 			g_timer_stop(si->timer);
 		} else {
+			si->painted=0;
 			g_timer_start(si->timer);
 		}
 	}
@@ -253,9 +301,10 @@ static lua_State *glspi_state_new(void)
 	si->remaining=DEFAULT_MAX_EXEC_TIME;
 	si->source=g_string_new("");
 	si->line=-1;
-	si->counter=0;
-	state_list=g_slist_append(state_list,si);
-	lua_sethook(L,debug_hook,LUA_MASKLINE,1);
+	lua_pushlightuserdata(L, &state_key);
+	lua_pushlightuserdata(L, si);
+	lua_rawset(L, LUA_REGISTRYINDEX);
+	lua_sethook(L,debug_hook,LUA_MASKCOUNT,HOOK_COUNT);
 	return L;
 }
 
@@ -263,6 +312,13 @@ static lua_State *glspi_state_new(void)
 static void glspi_state_done(lua_State *L)
 {
 	StateInfo*si=find_state(L);
+	if (si && si->persistent && si->busy) {
+		/* Keep pooled interpreter around for next time, just clean up after this run */
+		si->busy=FALSE;
+		lua_settop(L, 0);
+		lua_gc(L, LUA_GCSTEP, 0);
+		return;
+	}
 	if (si) {
 		if (si->timer) {
 			g_timer_destroy(si->timer);
@@ -271,7 +327,6 @@ static void glspi_state_done(lua_State *L)
 		if (si->source) {
 			g_string_free(si->source, TRUE);
 		}
-		state_list=g_slist_remove(state_list,si);
 		g_free(si);
 	}
 	lua_close(L);
@@ -293,6 +348,7 @@ static const struct luaL_reg glspi_timer_funcs[] = {
 /* Catch and report script errors */
 static gint glspi_traceback(lua_State *L)
 {
+	glspi_set_error_info(L);
 	lua_getfield(L, LUA_GLOBALSINDEX, "debug");
 	if (!lua_istable(L, -1)) {
 		lua_pop(L, 1);
@@ -427,16 +483,167 @@ gint luaopen_libgeanylua(lua_State *L)
 
 
 
+/* Reassign the per-invocation module variables of a pooled interpreter */
+static void glspi_reset_module(lua_State *L, const gchar *script_file, gint caller, GKeyFile*proj)
+{
+	set_boolean_token(L,tokenRectSel,FALSE);
+	set_numeric_token(L,tokenCaller, caller);
+	set_string_token(L,tokenScript,script_file);
+	lua_getglobal(L, LUA_MODULE_NAME);
+	if (lua_istable(L, -1)) {
+		lua_pushstring(L,tokenProject);
+		if (proj) { glspi_kfile_assign(L, proj); } else { lua_pushnil(L); }
+		lua_settable(L, -3);
+	}
+	lua_settop(L, 0);
+}
+
+
+
+/*
+	Get an interpreter to run the script in: either the shared one for the
+	script's directory if that directory has opted in, or a new one.
+	If the shared one is still busy (e.g. an event fired while a script
+	was showing a dialog) we fall back to a private interpreter.
+*/
+static lua_State *glspi_state_acquire(const gchar *script_file, gint caller, GKeyFile*proj, const gchar *script_dir)
+{
+	lua_State *L=NULL;
+	StateInfo*si;
+	if (state_pool) {
+		gchar *dir=g_path_get_dirname(script_file);
+		gchar *marker=g_build_filename(dir, PERSIST_MARKER, NULL);
+		if (g_file_test(marker, G_FILE_TEST_IS_REGULAR)) {
+			L=g_hash_table_lookup(state_pool, dir);
+			if (!L) {
+				L=glspi_state_new();
+				glspi_init_module(L, script_file, caller,proj,script_dir);
+				lua_settop(L, 0);
+				find_state(L)->persistent=TRUE;
+				g_hash_table_insert(state_pool, dir, L);
+				dir=NULL;
+			} else if (find_state(L)->busy) {
+				L=NULL;
+			} else {
+				glspi_reset_module(L, script_file, caller, proj);
+			}
+		}
+		g_free(marker);
+		g_free(dir);
+	}
+	if (!L) {
+		L=glspi_state_new();
+		glspi_init_module(L, script_file, caller,proj,script_dir);
+	}
+	si=find_state(L);
+	if (si) {
+		si->busy=TRUE;
+		si->line=-1;
+		si->painted=0;
+		si->max=DEFAULT_MAX_EXEC_TIME;
+		si->remaining=DEFAULT_MAX_EXEC_TIME;
+		g_string_assign(si->source, "");
+		g_timer_start(si->timer);
+	}
+	/* A previous run in a pooled interpreter might have called optimize() */
+	lua_sethook(L,debug_hook,LUA_MASKCOUNT,HOOK_COUNT);
+	return L;
+}
+
+
+
+static gint chunk_writer(lua_State *L, const void* p, size_t sz, void* ud)
+{
+	g_byte_array_append((GByteArray*)ud, p, sz);
+	return 0;
+}
+
+
+
+/*
+	Load the script, using the cached bytecode if the file has not
+	been modified since it was last compiled.
+*/
+static gint glspi_load_script(lua_State *L, const gchar *script_file)
+{
+	struct stat st;
+	ChunkInfo *ci;
+	gint status;
+	if (!chunk_cache || (g_stat(script_file, &st)!=0)) {
+		return luaL_loadfile(L, script_file);
+	}
+	ci=g_hash_table_lookup(chunk_cache, script_file);
+	if (ci && (ci->mtime==st.st_mtime) && (ci->size==st.st_size)) {
+		gchar *chunkname=g_strconcat("@", script_file, NULL);
+		status=luaL_loadbuffer(L, (const gchar*)ci->code->data, ci->code->len, chunkname);
+		g_free(chunkname);
+		return status;
+	}
+	status=luaL_loadfile(L, script_file);
+	if (0==status) {
+		ci=g_new0(ChunkInfo,1);
+		ci->mtime=st.st_mtime;
+		ci->size=st.st_size;
+		ci->code=g_byte_array_new();
+		if (0==lua_dump(L, chunk_writer, ci->code)) {
+			g_hash_table_insert(chunk_cache, g_strdup(script_file), ci);
+		} else {
+			g_byte_array_free(ci->code, TRUE);
+			g_free(ci);
+		}
+	}
+	return status;
+}
+
+
+
+static void free_chunk(gpointer data)
+{
+	ChunkInfo *ci=data;
+	g_byte_array_free(ci->code, TRUE);
+	g_free(ci);
+}
+
+
+
+static void free_pooled_state(gpointer data)
+{
+	StateInfo*si=find_state((lua_State*)data);
+	if (si) { si->persistent=FALSE; }
+	glspi_state_done((lua_State*)data);
+}
+
+
+
+/* Pass TRUE to create the script caches, FALSE to destroy them */
+void glspi_set_script_cache(gboolean create)
+{
+	if (create) {
+		chunk_cache=g_hash_table_new_full(g_str_hash,g_str_equal,g_free,free_chunk);
+		state_pool=g_hash_table_new_full(g_str_hash,g_str_equal,g_free,free_pooled_state);
+	} else {
+		if (state_pool) {
+			g_hash_table_destroy(state_pool);
+			state_pool=NULL;
+		}
+		if (chunk_cache) {
+			g_hash_table_destroy(chunk_cache);
+			chunk_cache=NULL;
+		}
+	}
+}
+
+
+
 /* Load and run the script */
 void glspi_run_script(const gchar *script_file, gint caller, GKeyFile*proj, const gchar *script_dir)
 {
 	gint status;
-	lua_State *L = glspi_state_new();
-	glspi_init_module(L, script_file, caller,proj,script_dir);
+	lua_State *L = glspi_state_acquire(script_file, caller,proj,script_dir);
 #if 0
 	while (gtk_events_pending()) { gtk_main_iteration(); }
 #endif
-	status = luaL_loadfile(L, script_file);
+	status = glspi_load_script(L, script_file);
 	switch (status) {
 	case 0: {
 		gint base = lua_gettop(L); /* function index */
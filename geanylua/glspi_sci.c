@@ -10,6 +10,10 @@
 #include "glspi.h"
 #include "glspi_sci.h"
 
+#ifndef SCI_GETRANGEPOINTER
+# define SCI_GETRANGEPOINTER 2643
+#endif
+
 
 /* Get or Set the entire text of the currently active Geany document */
 static gint glspi_text(lua_State* L)
@@ -20,12 +24,11 @@ static gint glspi_text(lua_State* L)
 	if (!doc) { return 0; }
 	if (0 == lua_gettop(L)) { /* Called with no args, GET the current text */
 		gint len = sci_get_length(doc->editor->sci);
-		gchar *txt = NULL;
 		if (len>0) {
-			txt = g_malloc0((guint)len+2);
-			sci_get_text(doc->editor->sci, len+1, txt);
-			lua_pushstring(L, (const gchar *) txt);
-			g_free(txt);
+			/* Copy straight from the editor's buffer, no intermediate copy */
+			const gchar *txt = (const gchar *)
+				scintilla_send_message(doc->editor->sci, SCI_GETCHARACTERPOINTER, 0, 0);
+			lua_pushlstring(L, txt, len);
 		} else {
 			lua_pushstring(L, "");
 		}
@@ -268,16 +271,41 @@ static gint glspi_word(lua_State* L)
 
 
 
+/*
+	Returns a pointer into the editor's buffer for the given range of text,
+	without copying it. The pointer is only valid until the document is
+	modified, so the caller must be done with it before calling any
+	function that might change the text.
+*/
+static const gchar* get_range_pointer(ScintillaObject*sci, gint start, gint len)
+{
+	const gchar *p=(const gchar*)scintilla_send_message(sci, SCI_GETRANGEPOINTER, start, len);
+	if (!p) { /* Older Scintilla without SCI_GETRANGEPOINTER */
+		p=(const gchar*)scintilla_send_message(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+		if (p) { p+=start; }
+	}
+	return p;
+}
+
+
+
 /*
 	Pushes the line of text onto the Lua stack from the specified
 	line number. Return FALSE only if the index is out of bounds.
 */
-static gchar* get_line_text(GeanyDocument*doc,gint linenum)
+static gboolean push_line_text(lua_State *L, ScintillaObject*sci, gint linenum)
 {
-	gint count=sci_get_line_count(doc->editor->sci);
+	gint count=sci_get_line_count(sci);
 	if ((linenum>0)&&(linenum<=count)) {
-		gchar *text=sci_get_line(doc->editor->sci, linenum-1);
-		return text?text:g_strdup("");
+		gint start=sci_get_position_from_line(sci, linenum-1);
+		gint len=scintilla_send_message(sci, SCI_LINELENGTH, linenum-1, 0);
+		const gchar *text=(len>0)?get_range_pointer(sci, start, len):NULL;
+		if (text) {
+			lua_pushlstring(L, text, len);
+		} else {
+			lua_pushstring(L, "");
+		}
+		return TRUE;
 	} else {
 		return FALSE;
 	}
@@ -292,13 +320,11 @@ static gint lines_closure(lua_State *L)
 {
 	gint idx=lua_tonumber(L, lua_upvalueindex(1))+1;
 	GeanyDocument *doc=lua_touserdata(L,lua_upvalueindex(2));
-	gchar *text=get_line_text(doc,idx);
-	if ( text ) {
-		push_number(L, idx);
-		lua_pushvalue(L, -1);
+	if ( !(doc && doc->is_valid) ) { return 0; }
+	push_number(L, idx);
+	if ( push_line_text(L, doc->editor->sci, idx) ) {
+		lua_pushvalue(L, -2);
 		lua_replace(L, lua_upvalueindex(1));
-		lua_pushstring(L,text);
-		g_free(text);
 		return 2;
 	} else {
 		return 0;
@@ -317,19 +343,278 @@ static gint glspi_lines(lua_State* L)
 		lua_pushcclosure(L, &lines_closure, 2);
 		return 1;
 	} else {
-		int idx;
-		gchar *text;
 		if (!lua_isnumber(L,1)) { return FAIL_NUMERIC_ARG(1); }
-		idx=lua_tonumber(L,1);
-		text=get_line_text(doc,idx);
-		if (text) {
-			lua_pushstring(L,text);
-			g_free(text);
-			return 1;
-		} else {
+		return push_line_text(L, doc->editor->sci, lua_tonumber(L,1))?1:0;
+	}
+}
+
+
+
+/*
+	A read-only "view" of a document, that reads directly from the editor's
+	buffer instead of copying the whole text into a Lua string.
+*/
+
+#define ViewMetaName "_geany_doc_view_metatable"
+
+static const gchar*LuaDocViewType="DocView";
+
+typedef struct _LuaDocView
+{
+	const gchar*id;
+	GeanyDocument*doc;
+} LuaDocView;
+
+
+
+/* Returns the editor for a view argument, raising an error if it is no longer valid */
+static ScintillaObject* toviewsci(lua_State *L, gint argnum, const gchar*func)
+{
+	LuaDocView*v=NULL;
+	if ( (lua_gettop(L)>=argnum) && lua_isuserdata(L,argnum) ) {
+		v=lua_touserdata(L,argnum);
+	}
+	if ( !(v && (v->id==LuaDocViewType)) ) {
+		glspi_fail_arg_type(L,func,argnum,LuaDocViewType);
+		return NULL;
+	}
+	if ( !(v->doc && v->doc->is_valid) ) {
+		lua_pushfstring(L, _("Error in module \"%s\" at function %s():\n"
+			" the document for this view has been closed\n"), LUA_MODULE_NAME, func+6);
+		lua_error(L);
+		return NULL;
+	}
+	return v->doc->editor->sci;
+}
+
+
+
+/* Get an optional position argument, clamped to the document */
+static gint view_pos_arg(lua_State *L, gint argnum, gint len, gint dflt, const gchar*func)
+{
+	gint pos;
+	if ( (lua_gettop(L)<argnum) || lua_isnil(L,argnum) ) { return dflt; }
+	if ( !lua_isnumber(L,argnum) ) { return glspi_fail_arg_type(L,func,argnum,"number"); }
+	pos=lua_tonumber(L,argnum);
+	if (pos<0) { pos=0; }
+	if (pos>len) { pos=len; }
+	return pos;
+}
+
+
+
+/* Create a view of the current document */
+static gint glspi_view(lua_State* L)
+{
+	LuaDocView*v;
+	DOC_REQUIRED
+	v=(LuaDocView*)lua_newuserdata(L,sizeof(LuaDocView));
+	v->id=LuaDocViewType;
+	v->doc=doc;
+	luaL_getmetatable(L, ViewMetaName);
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+
+
+static gint glspi_view_length(lua_State* L)
+{
+	ScintillaObject*sci=toviewsci(L,1,__FUNCTION__);
+	push_number(L, sci_get_length(sci));
+	return 1;
+}
+
+
+
+/* Return the text between two positions */
+static gint glspi_view_sub(lua_State* L)
+{
+	ScintillaObject*sci=toviewsci(L,1,__FUNCTION__);
+	gint len=sci_get_length(sci);
+	gint start=view_pos_arg(L,2,len,0,__FUNCTION__);
+	gint stop=view_pos_arg(L,3,len,len,__FUNCTION__);
+	const gchar*text=(stop>start)?get_range_pointer(sci, start, stop-start):NULL;
+	if (text) {
+		lua_pushlstring(L, text, stop-start);
+	} else {
+		lua_pushstring(L, "");
+	}
+	return 1;
+}
+
+
+
+/* Plain text search, returns the start and end positions of the match */
+static gint glspi_view_find(lua_State* L)
+{
+	ScintillaObject*sci=toviewsci(L,1,__FUNCTION__);
+	gint len=sci_get_length(sci);
+	gint start, stop;
+	size_t plen;
+	const gchar*phrase;
+	const gchar*text;
+	const gchar*p;
+	const gchar*end;
+	if ( (lua_gettop(L)<2) || !lua_isstring(L,2) ) { return FAIL_STRING_ARG(2); }
+	phrase=lua_tolstring(L,2,&plen);
+	start=view_pos_arg(L,3,len,0,__FUNCTION__);
+	stop=view_pos_arg(L,4,len,len,__FUNCTION__);
+	if ( (plen==0) || ((gint)plen>stop-start) ) { return 0; }
+	text=get_range_pointer(sci, start, stop-start);
+	if (!text) { return 0; }
+	end=text+(stop-start)-plen;
+	for (p=text; p && (p<=end); p++) {
+		p=memchr(p, phrase[0], end-p+1);
+		if (!p) { break; }
+		if (memcmp(p, phrase, plen)==0) {
+			push_number(L, start+(p-text));
+			push_number(L, start+(p-text)+plen);
+			return 2;
+		}
+	}
+	return 0;
+}
+
+
+
+/* Return the text of a single line */
+static gint glspi_view_line(lua_State* L)
+{
+	ScintillaObject*sci=toviewsci(L,1,__FUNCTION__);
+	if ( (lua_gettop(L)<2) || !lua_isnumber(L,2) ) { return FAIL_NUMERIC_ARG(2); }
+	return push_line_text(L, sci, lua_tonumber(L,2))?1:0;
+}
+
+
+
+/* Iterator closure for view:lines(), upvalues are the view and the last line index */
+static gint glspi_view_lines_closure(lua_State *L)
+{
+	ScintillaObject*sci;
+	gint idx=lua_tonumber(L, lua_upvalueindex(2))+1;
+	lua_settop(L, 0);
+	lua_pushvalue(L, lua_upvalueindex(1));
+	sci=toviewsci(L,1,__FUNCTION__);
+	push_number(L, idx);
+	if ( push_line_text(L, sci, idx) ) {
+		lua_pushvalue(L, -2);
+		lua_replace(L, lua_upvalueindex(2));
+		return 2;
+	} else {
+		return 0;
+	}
+}
+
+
+
+/* Iterate through the lines of the view, optionally starting from a given line */
+static gint glspi_view_lines(lua_State* L)
+{
+	gint first=1;
+	toviewsci(L,1,__FUNCTION__);
+	if ( (lua_gettop(L)>1) && !lua_isnil(L,2) ) {
+		if ( !lua_isnumber(L,2) ) { return FAIL_NUMERIC_ARG(2); }
+		first=lua_tonumber(L,2);
+	}
+	lua_pushvalue(L,1);
+	push_number(L,first-1);
+	lua_pushcclosure(L, &glspi_view_lines_closure, 2);
+	return 1;
+}
+
+
+
+static const struct luaL_reg glspi_view_funcs[] = {
+	{"length",  glspi_view_length},
+	{"sub",     glspi_view_sub},
+	{"find",    glspi_view_find},
+	{"line",    glspi_view_line},
+	{"lines",   glspi_view_lines},
+	{NULL,NULL}
+};
+
+
+
+typedef struct _ReplaceInfo
+{
+	gint start;
+	gint stop;
+	const gchar*text;
+	size_t len;
+} ReplaceInfo;
+
+
+static gint compare_replace_info(gconstpointer a, gconstpointer b)
+{
+	return ((const ReplaceInfo*)b)->start - ((const ReplaceInfo*)a)->start;
+}
+
+
+
+/*
+	Apply a list of replacements as a single undo action and redraw. Each element
+	of the table is itself a table of { start, stop, text }, with positions
+	referring to the document as it was before any of the replacements.
+*/
+static gint glspi_replace(lua_State* L)
+{
+	GArray*edits;
+	ReplaceInfo ri;
+	gint i, n, len;
+	DOC_REQUIRED
+	if ( (lua_gettop(L)<1) || !lua_istable(L,1) ) { return FAIL_TABLE_ARG(1); }
+	len=sci_get_length(doc->editor->sci);
+	n=lua_objlen(L,1);
+	edits=g_array_sized_new(FALSE, FALSE, sizeof(ReplaceInfo), n);
+	for (i=1; i<=n; i++) {
+		lua_rawgeti(L,1,i);
+		if (lua_istable(L,-1)) {
+			lua_rawgeti(L,-1,1);
+			lua_rawgeti(L,-2,2);
+			lua_rawgeti(L,-3,3);
+			if ( lua_isnumber(L,-3) && lua_isnumber(L,-2) && lua_isstring(L,-1) ) {
+				ri.start=lua_tonumber(L,-3);
+				ri.stop=lua_tonumber(L,-2);
+				/* String is still referenced from the argument table, so the pointer stays valid */
+				ri.text=lua_tolstring(L,-1,&ri.len);
+				lua_pop(L,4);
+				if ( (ri.start>=0) && (ri.start<=ri.stop) && (ri.stop<=len) ) {
+					g_array_append_val(edits, ri);
+					continue;
+				}
+			}
+		}
+		g_array_free(edits, TRUE);
+		return glspi_fail_elem_type(L, __FUNCTION__, 1, i, "{start,stop,text}");
+	}
+	/* Work from the end of the document back, so earlier positions stay valid */
+	g_array_sort(edits, compare_replace_info);
+	for (i=1; i<(gint)edits->len; i++) {
+		if (g_array_index(edits, ReplaceInfo, i).stop > g_array_index(edits, ReplaceInfo, i-1).start) {
+			g_array_free(edits, TRUE);
+			lua_pushfstring(L, _("Error in module \"%s\" at function %s():\n"
+				" overlapping ranges in argument #%d\n"), LUA_MODULE_NAME, &__FUNCTION__[6], 1);
+			lua_error(L);
 			return 0;
 		}
 	}
+	if (edits->len>0) {
+		ScintillaObject*sci=doc->editor->sci;
+		scintilla_send_message(sci, SCI_SETREDRAW, FALSE, 0);
+		sci_start_undo_action(sci);
+		for (i=0; i<(gint)edits->len; i++) {
+			ReplaceInfo*r=&g_array_index(edits, ReplaceInfo, i);
+			scintilla_send_message(sci, SCI_SETTARGETSTART, r->start, 0);
+			scintilla_send_message(sci, SCI_SETTARGETEND, r->stop, 0);
+			scintilla_send_message(sci, SCI_REPLACETARGET, r->len, (sptr_t)r->text);
+		}
+		sci_end_undo_action(sci);
+		scintilla_send_message(sci, SCI_SETREDRAW, TRUE, 0);
+	}
+	push_number(L, edits->len);
+	g_array_free(edits, TRUE);
+	return 1;
 }
 
 
@@ -863,9 +1148,17 @@ static const struct luaL_reg glspi_sci_funcs[] = {
 	{"byte",      glspi_byte},
 	{"scintilla", glspi_scintilla},
 	{"find",      glspi_find},
+	{"view",      glspi_view},
+	{"replace",   glspi_replace},
 	{NULL,NULL}
 };
 
 void glspi_init_sci_funcs(lua_State *L) {
 	luaL_register(L, NULL,glspi_sci_funcs);
+	luaL_newmetatable(L, ViewMetaName);
+	lua_pushstring(L, "__index");
+	lua_pushvalue(L, -2);
+	lua_settable(L, -3);
+	luaL_register(L, NULL, glspi_view_funcs);
+	lua_pop(L, 1);
 }
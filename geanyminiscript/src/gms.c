@@ -34,6 +34,9 @@
 
 /* headers */
 #include    <stdlib.h>
+#include    <signal.h>
+#include    <sys/wait.h>
+#include    <unistd.h>
 #include    <glib.h>
 #include    <glib/gstdio.h>
 
@@ -59,122 +62,374 @@ PLUGIN_SET_TRANSLATABLE_INFO(
     _("A tool to apply a script filter on a text selection or current document(s)"),
     "0.1" , _("Pascal BURLOT, a Geany user"))
 
+/*! \brief size of the chunks the filter input is written and its output read by */
+#define GMS_CHUNK_SIZE  (64*1024)
+
+/*! \brief definition of a running filter data structure */
+typedef struct {
+    GPid           pid       ; /*!< pid of the filter process */
+    GeanyDocument *doc       ; /*!< filtered document */
+    gint           pos       ; /*!< position of the next chunk of the input */
+    gint           start     ; /*!< start of the filtered text */
+    gint           end       ; /*!< end of the filtered text */
+    gchar         *chunk     ; /*!< chunk of the input being written */
+    gsize          chunk_len ; /*!< length of the chunk */
+    gsize          chunk_pos ; /*!< written part of the chunk */
+    GString       *out       ; /*!< filter output */
+    GString       *err       ; /*!< filter errors */
+    gint           status    ; /*!< exit status of the filter process */
+    gint           pending   ; /*!< number of the output pipes and the process not finished yet */
+    gboolean       cancelled ; /*!< filter cancelled by the user */
+    guint          sources[4]; /*!< event sources: input, output, errors and process */
+    gint           next_page ; /*!< next page to filter in session mode, -1 otherwise */
+} gms_filter_t ;
+
 static GtkWidget     *gms_item   = NULL ;
 static gms_handle_t gms_hnd     = NULL ;
 static gchar        *gms_command = NULL ;
+static gms_filter_t *gms_filter  = NULL ;
+
+
+static gboolean run_filter( GeanyDocument *doc, gint next_page );
+
+/**
+ * \brief the function updates the filtered text of the document
+ *        as a single undo action
+ */
+static void update_doc( gms_filter_t *filter, gchar * contents )
+{
+    ScintillaObject *sci = filter->doc->editor->sci ;
+
+    if (contents==NULL) return ;
+    sci_start_undo_action( sci ) ;
+    sci_set_selection_start( sci , filter->start ) ;
+    sci_set_selection_end( sci , filter->end ) ;
+    sci_replace_sel( sci, contents );
+    sci_end_undo_action( sci ) ;
+}
+/**
+ * \brief the function deletes the tempory files
+ */
+static void delete_tmp_files(void)
+{
+    if( g_file_test( gms_get_filter_filename(gms_hnd),G_FILE_TEST_EXISTS) == TRUE )
+        g_unlink( gms_get_filter_filename(gms_hnd) ) ;
+}
 
+/**
+ * \brief the function sets the menu item label according to the filter state
+ */
+static void update_menu_item( void )
+{
+    gtk_menu_item_set_label( GTK_MENU_ITEM(gms_item),
+            gms_filter ? _("Cancel _Mini-Script") : _("_Mini-Script") ) ;
+}
 
 /**
- * \brief the function creates from the current selection to the input file
+ * \brief the function stops watching the filter and frees it
  */
-static void create_selection_2_input_file( ScintillaObject *sci )
+static void free_filter( gms_filter_t *filter )
 {
-    gchar  *contents = NULL;
-    gint    size_buf = sci_get_selected_text_length(sci);
+    gint i ;
 
-    contents = GMS_G_MALLOC( gchar, size_buf + 1  ) ;
-    GMS_PNULL(contents) ;
+    for ( i = 0 ; i < 4 ; i++ )
+        if ( filter->sources[i] )
+            g_source_remove( filter->sources[i] ) ;
 
-    sci_get_selected_text( sci ,contents  );
+    g_spawn_close_pid( filter->pid ) ;
 
-    g_file_set_contents(gms_get_in_filename(gms_hnd), contents, -1 , NULL );
-    GMS_G_FREE(contents);
+    /* the document is editable again */
+    if ( DOC_VALID( filter->doc ) )
+        scintilla_send_message( filter->doc->editor->sci, SCI_SETREADONLY, filter->doc->readonly, 0 ) ;
+
+    GMS_G_FREE( filter->chunk ) ;
+    g_string_free( filter->out, TRUE ) ;
+    g_string_free( filter->err, TRUE ) ;
+    GMS_G_FREE( filter ) ;
 }
 
 /**
- * \brief the function reads the result file
+ * \brief the function applies the filter result when the filter is finished
  */
-static gchar *read_result_file( gchar *filename )
+static void finish_filter( gms_filter_t *filter )
 {
-    gchar *utf8     = NULL;
-    gchar *contents = NULL;
-    GError *error   = NULL ;
-    if (g_file_get_contents(filename, &contents, NULL, &error ))
+    gchar   *result = NULL ;
+    gint     next_page = filter->next_page ;
+    gboolean ok = FALSE ;
+
+    gms_filter = NULL ;
+
+    if ( filter->cancelled )
+    {
+        ui_set_statusbar( FALSE, _("Mini-Script filter cancelled") ) ;
+    }
+    else if ( ! WIFEXITED( filter->status ) || WEXITSTATUS( filter->status ) != 0 )
     {
-        if ( contents )
+        GtkWidget *dlg ;
+        result = g_locale_to_utf8( filter->err->str, filter->err->len, NULL, NULL, NULL ) ;
+
+        dlg = gtk_message_dialog_new( GTK_WINDOW(geany->main_widgets->window),
+                        GTK_DIALOG_DESTROY_WITH_PARENT,
+                        GTK_MESSAGE_ERROR,
+                        GTK_BUTTONS_CLOSE,
+                        "%s", result ? result : "");
+
+        gtk_dialog_run(GTK_DIALOG(dlg));
+        gtk_widget_destroy(GTK_WIDGET(dlg)) ;
+    }
+    else if ( DOC_VALID( filter->doc ) )
+    {
+        result = g_locale_to_utf8( filter->out->str, filter->out->len, NULL, NULL, NULL ) ;
+
+        scintilla_send_message( filter->doc->editor->sci, SCI_SETREADONLY, filter->doc->readonly, 0 ) ;
+
+        if ( gms_get_output_mode( gms_hnd) == OUT_CURRENT_DOC )
+            update_doc( filter, result ) ;
+        else
+            document_new_file( NULL, NULL, result ) ;
+        ok = TRUE ;
+    }
+    GMS_G_FREE( result ) ;
+    free_filter( filter ) ;
+
+    /* in session mode, filter the next document */
+    if ( ok && next_page >= 0 )
+    {
+        GeanyDocument *doc = document_get_from_page( next_page ) ;
+        if ( doc != NULL && run_filter( doc, next_page + 1 ) )
+            return ;
+    }
+
+    delete_tmp_files() ;
+    update_menu_item() ;
+}
+
+/**
+ * \brief the function is called when one of the filter outputs or the process is finished
+ */
+static void filter_part_finished( gms_filter_t *filter )
+{
+    if ( --filter->pending == 0 )
+        finish_filter( filter ) ;
+}
+
+/**
+ * \brief the function writes the filter input chunk by chunk
+ *        as the filter is reading it
+ */
+static gboolean on_filter_input( GIOChannel *channel, GIOCondition cond, gpointer data )
+{
+    gms_filter_t *filter = (gms_filter_t *) data ;
+
+    if ( ( cond & G_IO_OUT ) && DOC_VALID( filter->doc ) )
+    {
+        gsize     written = 0 ;
+        GIOStatus st ;
+
+        if ( filter->chunk == NULL && filter->pos < filter->end )
+        {
+            gint end = MIN( filter->pos + GMS_CHUNK_SIZE, filter->end ) ;
+            filter->chunk     = sci_get_contents_range( filter->doc->editor->sci, filter->pos, end ) ;
+            filter->chunk_len = end - filter->pos ;
+            filter->chunk_pos = 0 ;
+            filter->pos       = end ;
+        }
+
+        if ( filter->chunk != NULL )
         {
-            utf8 = g_locale_to_utf8 (contents, -1, NULL, NULL, NULL);
-            GMS_G_FREE(contents);
+            st = g_io_channel_write_chars( channel, filter->chunk + filter->chunk_pos,
+                            filter->chunk_len - filter->chunk_pos, &written, NULL ) ;
+            filter->chunk_pos += written ;
+            if ( filter->chunk_pos == filter->chunk_len )
+                GMS_G_FREE( filter->chunk ) ;
+
+            if ( st == G_IO_STATUS_NORMAL || st == G_IO_STATUS_AGAIN )
+                if ( filter->chunk != NULL || filter->pos < filter->end )
+                    return TRUE ;
         }
     }
-    return utf8 ;
+
+    /* all the input is written (or the filter stopped reading it) */
+    filter->sources[0] = 0 ;
+    return FALSE ;
+}
+
+/**
+ * \brief the function reads a filter pipe into a string as the filter is writing it
+ */
+static gboolean read_filter_pipe( GIOChannel *channel, GIOCondition cond, GString *str )
+{
+    gchar     buf[GMS_CHUNK_SIZE] ;
+    gsize     len = 0 ;
+    GIOStatus st  = G_IO_STATUS_NORMAL ;
+
+    if ( cond & ( G_IO_IN | G_IO_PRI ) )
+    {
+        while ( ( st = g_io_channel_read_chars( channel, buf, sizeof(buf), &len, NULL ) ) == G_IO_STATUS_NORMAL )
+            g_string_append_len( str, buf, len ) ;
+
+        if ( st == G_IO_STATUS_AGAIN )
+            return TRUE ;
+    }
+    else if ( ! ( cond & ( G_IO_HUP | G_IO_ERR | G_IO_NVAL ) ) )
+        return TRUE ;
+
+    /* end of file or error */
+    return FALSE ;
 }
+
 /**
- * \brief the function select entirely the document
+ * \brief the function reads the filter output
  */
-static void select_entirely_doc( ScintillaObject *sci  )
+static gboolean on_filter_output( GIOChannel *channel, GIOCondition cond, gpointer data )
 {
-    gint            size_buf = sci_get_length(sci);
+    gms_filter_t *filter = (gms_filter_t *) data ;
+
+    if ( read_filter_pipe( channel, cond, filter->out ) )
+        return TRUE ;
 
-    sci_set_selection_start( sci , 0 ) ;
-    sci_set_selection_end( sci , size_buf ) ;
+    filter->sources[1] = 0 ;
+    filter_part_finished( filter ) ;
+    return FALSE ;
 }
 
 /**
- * \brief the function updates the current document
+ * \brief the function reads the filter errors
  */
-static void update_doc( ScintillaObject *sci, gchar * contents )
+static gboolean on_filter_error( GIOChannel *channel, GIOCondition cond, gpointer data )
 {
-    if (contents==NULL) return ;
-    sci_replace_sel( sci, contents );
+    gms_filter_t *filter = (gms_filter_t *) data ;
+
+    if ( read_filter_pipe( channel, cond, filter->err ) )
+        return TRUE ;
+
+    filter->sources[2] = 0 ;
+    filter_part_finished( filter ) ;
+    return FALSE ;
 }
+
 /**
- * \brief the function deletes the tempory files
+ * \brief the function is called when the filter process exits
  */
-static void delete_tmp_files(void)
+static void on_filter_exit( GPid pid, gint status, gpointer data )
 {
-    if( g_file_test( gms_get_in_filename(gms_hnd),G_FILE_TEST_EXISTS) == TRUE )
-        g_unlink( gms_get_in_filename(gms_hnd) ) ;
-    if( g_file_test( gms_get_out_filename(gms_hnd),G_FILE_TEST_EXISTS) == TRUE )
-        g_unlink( gms_get_out_filename(gms_hnd) ) ;
-    if( g_file_test( gms_get_filter_filename(gms_hnd),G_FILE_TEST_EXISTS) == TRUE )
-        g_unlink( gms_get_filter_filename(gms_hnd) ) ;
+    gms_filter_t *filter = (gms_filter_t *) data ;
+
+    filter->status     = status ;
+    filter->sources[3] = 0 ;
+    filter_part_finished( filter ) ;
+}
+
+/**
+ * \brief the function watches a filter pipe
+ */
+static guint watch_filter_pipe( gint fd, gboolean input, GIOFunc func, gms_filter_t *filter )
+{
+    GIOChannel *channel = g_io_channel_unix_new( fd ) ;
+    guint       id ;
+
+    g_io_channel_set_encoding( channel, NULL, NULL ) ;
+    if ( input )
+        g_io_channel_set_buffered( channel, FALSE ) ;
+    g_io_channel_set_flags( channel, G_IO_FLAG_NONBLOCK, NULL ) ;
+    g_io_channel_set_close_on_unref( channel, TRUE ) ;
+
+    id = g_io_add_watch_full( channel, G_PRIORITY_DEFAULT,
+                input ? G_IO_OUT | G_IO_ERR | G_IO_HUP | G_IO_NVAL
+                      : G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+                func, filter, NULL ) ;
+    /* the watch keeps the channel, which is closed when the watch is removed */
+    g_io_channel_unref( channel ) ;
+    return id ;
+}
+
+/**
+ * \brief the function runs in the filter process before the script starts,
+ *        it puts the script and its children in their own process group
+ *        so that they can be stopped together
+ */
+static void filter_child_setup( gpointer data )
+{
+    setpgid( 0, 0 ) ;
 }
 
 /**
- * \brief the function updates the current document
+ * \brief the function starts the filter on the document.
+ *        The text is fed to the filter and its result read without
+ *        blocking, the document stays read-only until the filter is finished.
+ * \return TRUE if the filter is started
  */
-static gint run_filter( ScintillaObject *sci )
+static gboolean run_filter( GeanyDocument *doc, gint next_page )
 {
-    int r , ret = 0 ;
-    gchar *result = NULL ;
+    ScintillaObject *sci = doc->editor->sci ;
+    gms_filter_t    *filter ;
+    gchar           *argv[4] ;
+    gint             fd_in, fd_out, fd_err ;
+    GError          *error = NULL ;
 
     gms_command = gms_get_str_command(gms_hnd);
-    r = system( gms_command ) ;
-    if ( r != 0 )
+    argv[0] = "/bin/sh" ;
+    argv[1] = "-c" ;
+    argv[2] = gms_command ;
+    argv[3] = NULL ;
+
+    filter = GMS_G_MALLOC0( gms_filter_t, 1 ) ;
+    GMS_PNULL(filter) ;
+
+    if ( ! g_spawn_async_with_pipes( NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+                filter_child_setup, NULL, &filter->pid, &fd_in, &fd_out, &fd_err, &error ) )
     {
-        GtkWidget *dlg ;
-        result = read_result_file( gms_get_error_filename(gms_hnd) ) ;
+        ui_set_statusbar( TRUE, _("Cannot run the Mini-Script filter: %s"), error->message ) ;
+        g_error_free( error ) ;
+        GMS_G_FREE( filter ) ;
+        return FALSE ;
+    }
 
-        dlg = gtk_message_dialog_new( GTK_WINDOW(geany->main_widgets->window),
-                        GTK_DIALOG_DESTROY_WITH_PARENT,
-                        GTK_MESSAGE_ERROR,
-                        GTK_BUTTONS_CLOSE,
-                        "%s", result);
+    /* also from here, the group must exist before the filter can be cancelled */
+    setpgid( filter->pid, filter->pid ) ;
 
-        gtk_dialog_run(GTK_DIALOG(dlg));
-        gtk_widget_destroy(GTK_WIDGET(dlg)) ;
-		ret = -1 ;
+    filter->doc       = doc ;
+    filter->next_page = next_page ;
+    filter->out       = g_string_new( NULL ) ;
+    filter->err       = g_string_new( NULL ) ;
+    if ( gms_get_input_mode( gms_hnd) == IN_SELECTION )
+    {
+        filter->start = sci_get_selection_start( sci ) ;
+        filter->end   = sci_get_selection_end( sci ) ;
     }
     else
     {
-        result = read_result_file( gms_get_out_filename(gms_hnd) ) ;
+        filter->start = 0 ;
+        filter->end   = sci_get_length( sci ) ;
+    }
+    filter->pos = filter->start ;
 
-        if ( gms_get_output_mode( gms_hnd) == OUT_CURRENT_DOC )
-        {
-            if ( gms_get_input_mode( gms_hnd) != IN_SELECTION )
-                select_entirely_doc(  sci  ) ;
+    /* the filtered text must not change while the filter is running */
+    scintilla_send_message( sci, SCI_SETREADONLY, TRUE, 0 ) ;
 
-            update_doc( sci, result ) ;
-        }
-        else
-        {
-            document_new_file( NULL, NULL, result ) ;
-        }
-    }
-    GMS_G_FREE( result ) ;
+    /* the process and the two output pipes */
+    filter->pending    = 3 ;
+    filter->sources[0] = watch_filter_pipe( fd_in,  TRUE,  on_filter_input,  filter ) ;
+    filter->sources[1] = watch_filter_pipe( fd_out, FALSE, on_filter_output, filter ) ;
+    filter->sources[2] = watch_filter_pipe( fd_err, FALSE, on_filter_error,  filter ) ;
+    filter->sources[3] = g_child_watch_add( filter->pid, on_filter_exit, filter ) ;
 
-	return ret ;
+    gms_filter = filter ;
+    return TRUE ;
+}
+
+/**
+ * \brief the function cancels the running filter
+ */
+static void cancel_filter( void )
+{
+    if ( gms_filter == NULL )
+        return ;
+
+    /* the whole process group, so that no command started by the script
+     * keeps the pipes open after the shell is gone */
+    gms_filter->cancelled = TRUE ;
+    kill( -gms_filter->pid, SIGTERM ) ;
 }
 
 /**
@@ -183,10 +438,18 @@ static gint run_filter( ScintillaObject *sci )
 static void item_activate(GtkMenuItem *menuitem, gpointer gdata)
 {
     GeanyDocument   *doc = document_get_current();
-    ScintillaObject *sci = doc->editor->sci ;
+    gboolean         started = FALSE ;
+
     if ( gms_hnd  == NULL )
         return ;
 
+    /* while a filter is running, the menu item cancels it */
+    if ( gms_filter != NULL )
+    {
+        cancel_filter() ;
+        return ;
+    }
+
     if ( gms_dlg( gms_hnd ) == 0 )
         return ;
 
@@ -195,41 +458,24 @@ static void item_activate(GtkMenuItem *menuitem, gpointer gdata)
     switch ( gms_get_input_mode(gms_hnd) )
     {
         case IN_CURRENT_DOC :
-            select_entirely_doc(  sci  ) ;
-            create_selection_2_input_file(sci) ;
-            run_filter( sci ) ;
-            delete_tmp_files() ;
-            break;
         case IN_SELECTION :
-            create_selection_2_input_file(sci) ;
-            run_filter( sci ) ;
-            delete_tmp_files() ;
+            started = run_filter( doc, -1 ) ;
             break;
         case IN_DOCS_SESSION :
-            {
-                guint nb_doc = 0  , i=0;
-
-				/* find the opened document in the geany session */
-                while ( (doc = document_get_from_page(nb_doc))!=NULL ) nb_doc++;
-
-                /* For each document */
-                for( i=0; i<nb_doc;i++)
-                {
-                    doc = document_get_from_page(i) ;
-                    sci = doc->editor->sci ;
-                    select_entirely_doc(  sci  ) ;
-                    create_selection_2_input_file(sci) ;
-                    if ( run_filter( sci ) )
-						break ; /* if error then stop the loop */
-                }
-            }
-            delete_tmp_files() ;
+            /* the documents are filtered one after the other,
+             * the next one when the previous is finished */
+            doc = document_get_from_page( 0 ) ;
+            if ( doc != NULL )
+                started = run_filter( doc, 1 ) ;
             break;
         default:
-            delete_tmp_files() ;
-            return ;
+            break;
     }
 
+    if ( started )
+        update_menu_item() ;
+    else
+        delete_tmp_files() ;
 }
 
 
@@ -275,6 +521,20 @@ GtkWidget *plugin_configure(GtkDialog *dialog)
  */
 void plugin_cleanup(void)
 {
+    /* stop the running filter and forget its result */
+    if ( gms_filter != NULL )
+    {
+        GPid pid = gms_filter->pid ;
+
+        /* the process watch goes away with the plugin, so the process is
+         * killed for sure and reaped here not to leave a zombie */
+        kill( -pid, SIGKILL ) ;
+        free_filter( gms_filter ) ;
+        gms_filter = NULL ;
+        waitpid( pid, NULL, 0 ) ;
+        delete_tmp_files() ;
+    }
+
     if ( gms_hnd != NULL )
        gms_delete( &gms_hnd ) ;
 
@@ -92,10 +92,7 @@ typedef struct {
     GString    *cmd         ;                    /*!< Command string of filtering */
     GtkWidget  *mw          ;                    /*!< MainWindow of Geany */
     gms_gui_t   w           ;                    /*!< Widgets of minis-script gui */
-    GString    *input_name  ;                    /*!< filename of the filter input */
     GString    *filter_name ;                    /*!< filter filename */
-    GString    *output_name ;                    /*!< filename of the filter output */
-    GString    *error_name  ;                    /*!< errors filename */
     GString    *script_cmd[GMS_NB_TYPE_SCRIPT];  /*!< array of script command names */
 } gms_private_t  ;
 /*
@@ -112,10 +109,7 @@ static gchar bufline[GMS_MAX_LINE+1]; /*!< buffer used to read the configuration
 
 static const gchar pref_filename[]   = "gms.rc"    ; /*!< preferences filename */
 static const gchar prefix_filename[] = "/tmp/gms"  ; /*!< prefix filename */
-static const gchar in_ext[]          = ".in"       ; /*!< filename extension for the input file */
-static const gchar out_ext[]         = ".out"      ; /*!< filename extension for the output file */
 static const gchar filter_ext[]      = ".filter"   ; /*!< filename extension for the filter file */
-static const gchar error_ext[]       = ".error"    ; /*!< filename extension for the error file */
 
 /**< \brief It's the default script command */
 static const gchar *default_script_cmd[GMS_NB_TYPE_SCRIPT] = {
@@ -532,24 +526,12 @@ gms_handle_t gms_new(
         gtk_widget_show_all(GTK_WIDGET(vb_dlg));
         this->id  = ++inst_cnt ;
 
-        this->input_name = g_string_new(prefix_filename) ;
         this->filter_name= g_string_new(prefix_filename) ;
-        this->output_name= g_string_new(prefix_filename) ;
-        this->error_name = g_string_new(prefix_filename) ;
 
         size_pid = (gint)(2*sizeof(pid_t)) ;
-        g_string_append_printf( this->input_name,"%02x_%0*x%s",
-                    this->id,size_pid, getpid(), in_ext ) ;
-
         g_string_append_printf(this->filter_name,"%02x_%0*x%s",
                     this->id,size_pid, getpid(), filter_ext ) ;
 
-        g_string_append_printf(this->output_name,"%02x_%0*x%s",
-                    this->id,size_pid, getpid(), out_ext ) ;
-
-        g_string_append_printf(this->error_name,"%02x_%0*x%s",
-                    this->id,size_pid, getpid(), error_ext ) ;
-
         for ( i=0;i<GMS_NB_TYPE_SCRIPT ; i++ )
         {
             this->script_cmd[i]=g_string_new(default_script_cmd[i] ) ;
@@ -578,8 +560,6 @@ void gms_delete(
         GMS_FREE_FONTDESC(this->w.fontdesc );
         GMS_FREE_WIDGET(this->w.dlg);
 
-        g_string_free( this->input_name  ,flag) ;
-        g_string_free( this->output_name ,flag) ;
         g_string_free( this->filter_name ,flag) ;
         g_string_free( this->cmd         ,flag) ;
 
@@ -647,28 +627,6 @@ gms_output_t  gms_get_output_mode(
     return mode ;
 }
 
-/**
- * \brief the function get the input filename for filter input.
- */
-gchar *gms_get_in_filename(
-    gms_handle_t hnd /**< handle of mini-script data structure */
-    )
-{
-    gms_private_t *this = GMS_PRIVATE( hnd ) ;
-    return this->input_name->str ;
-}
-
-/**
- * \brief the function get the output filename for filter result.
- */
-gchar *gms_get_out_filename(
-    gms_handle_t hnd /**< handle of mini-script data structure */
-    )
-{
-    gms_private_t *this = GMS_PRIVATE( hnd ) ;
-    return this->output_name->str ;
-}
-
 /**
  * \brief the function get the output filename for filter script.
  */
@@ -678,17 +636,6 @@ gchar *gms_get_filter_filename( gms_handle_t hnd )
     return this->filter_name->str ;
 }
 
-/**
- * \brief the function get the error filename for filter script.
- */
-gchar *gms_get_error_filename(
-    gms_handle_t hnd /**< handle of mini-script data structure */
-    )
-{
-    gms_private_t *this = GMS_PRIVATE( hnd ) ;
-    return this->error_name->str ;
-}
-
 /**
  * \brief the function creates the filter file.
  */
@@ -711,6 +658,8 @@ void  gms_create_filter_file(
 
 /**
  * \brief the function creates the command string.
+ * \note the filter input and output are the standard input and output
+ *       of the command, they are connected to pipes by the caller.
  */
 gchar *gms_get_str_command(
     gms_handle_t hnd /**< handle of mini-script data structure */
@@ -719,12 +668,9 @@ gchar *gms_get_str_command(
     gms_private_t *this = GMS_PRIVATE( hnd ) ;
     gint ii_script = gtk_combo_box_get_active(GTK_COMBO_BOX(this->w.cb_st) ) ;
 
-    g_string_printf( this->cmd,"cat %s | %s %s > %s 2> %s",
-                                this->input_name->str,
-                                    this->script_cmd[ii_script]->str,
-                                        this->filter_name->str,
-                                            this->output_name->str,
-                                                this->error_name->str );
+    g_string_printf( this->cmd,"%s %s",
+                                this->script_cmd[ii_script]->str,
+                                    this->filter_name->str );
     return this->cmd->str  ;
 }
 
@@ -40,10 +40,7 @@ typedef enum {
 gms_handle_t gms_new(  GtkWidget *mw, gchar *font, gint tabs, gchar *config_dir);
 void        gms_delete( gms_handle_t *hnd );
 int         gms_dlg( gms_handle_t hnd ) ;
-gchar       *gms_get_in_filename( gms_handle_t hnd ) ;
-gchar       *gms_get_out_filename( gms_handle_t hnd ) ;
 gchar       *gms_get_filter_filename( gms_handle_t hnd ) ;
-gchar       *gms_get_error_filename( gms_handle_t hnd ) ;
 void        gms_create_filter_file( gms_handle_t hnd ) ;
 gchar       *gms_get_str_command( gms_handle_t hnd ) ;
 gms_input_t  gms_get_input_mode( gms_handle_t hnd );
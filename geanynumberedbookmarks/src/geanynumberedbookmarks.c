@@ -33,9 +33,6 @@ static const gint base64_char_to_int[]=
    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,255,255,255,255,255
 };
 
-static const gchar base64_int_to_char[]=
-  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
 /* define structures used in this plugin */
 typedef struct FileData
 {
@@ -43,7 +40,7 @@ typedef struct FileData
 	gint iBookmark[10];   /* holds bookmark lines or -1 for not set */
 	gint iBookmarkMarkerUsed[10]; /*holds which marker (2-24) is used for this bookmark */
 	gint iBookmarkLinePos[10]; /* holds position of cursor in line */
-	gchar *pcFolding;     /* holds which folds are open and which not */
+	gchar *pcFolding;     /* holds run length encoded fold states, open runs first */
 	gint LastChangedTime; /* time file was last changed by this editor */
 	gchar *pcBookmarks;   /* holds non-numbered bookmarks */
 	struct FileData * NextNode;
@@ -73,8 +70,15 @@ static gboolean bRememberBookmarks=TRUE;
 /* internal variables */
 static gint iShiftNumbers[]={41,33,34,163,36,37,94,38,42,40};
 static FileData *fdKnownFilesSettings=NULL;
+static FileData *fdKnownFilesLast=NULL;
+static GHashTable *htKnownFiles=NULL; /* filename -> FileData index into above list */
+static gint iJournalEntries=0;       /* records appended since settings.conf last written */
+static guint iCompactSourceId=0;
 static gulong key_release_signal_id;
 
+/* number of journal records to allow before rewriting settings.conf in the background */
+#define JOURNAL_COMPACT_THRESHOLD 64
+
 /* default config file */
 const gchar default_config[] =
 	"[Settings]\n"
@@ -311,54 +315,181 @@ static const gchar ** aszMarkerImages[]=
 */
 static FileData * GetFileData(gchar *pcFileName)
 {
-	FileData *fdTemp=fdKnownFilesSettings;
+	FileData *fdTemp;
 	gint i;
 
-	/* First handle if main pointer doesn't point to anything */
-	if(fdTemp==NULL)
+	/* untitled documents all share one entry */
+	if(pcFileName==NULL)
+		pcFileName="";
+
+	if(htKnownFiles==NULL)
+		htKnownFiles=g_hash_table_new(g_str_hash,g_str_equal);
+
+	/* if have found relavent FileData, then exit */
+	fdTemp=(FileData*)(g_hash_table_lookup(htKnownFiles,pcFileName));
+	if(fdTemp!=NULL)
+		return fdTemp;
+
+	/* otherwise add new entry to end of chain, and return it. */
+	if((fdTemp=(FileData*)(g_malloc(sizeof *fdTemp)))!=NULL)
 	{
-		if((fdKnownFilesSettings=(FileData*)(g_malloc(sizeof *fdTemp)))!=NULL)
-		{
-			fdKnownFilesSettings->pcFileName=g_strdup(pcFileName);
-			for(i=0;i<10;i++)
-				fdKnownFilesSettings->iBookmark[i]=-1;
-
-			/* don't need to initiate iBookmarkLinePos */
-			fdKnownFilesSettings->pcFolding=NULL;
-			fdKnownFilesSettings->LastChangedTime=-1;
-			fdKnownFilesSettings->pcBookmarks=NULL;
-			fdKnownFilesSettings->NextNode=NULL;
-		}
-		return fdKnownFilesSettings;
+		fdTemp->pcFileName=g_strdup(pcFileName);
+		for(i=0;i<10;i++)
+			fdTemp->iBookmark[i]=-1;
+
+		/* don't need to initiate iBookmarkLinePos */
+		fdTemp->pcFolding=NULL;
+		fdTemp->LastChangedTime=-1;
+		fdTemp->pcBookmarks=NULL;
+		fdTemp->NextNode=NULL;
+
+		if(fdKnownFilesLast==NULL)
+			fdKnownFilesSettings=fdTemp;
+		else
+			fdKnownFilesLast->NextNode=fdTemp;
+
+		fdKnownFilesLast=fdTemp;
+		g_hash_table_insert(htKnownFiles,fdTemp->pcFileName,fdTemp);
+	}
+
+	return fdTemp;
+}
+
+
+/* Fold states are stored as comma separated hex run lengths of fold points, alternating between
+ * open and closed runs, starting with an open run (which may be 0). A trailing open run is left
+ * off as folds default to open.
+*/
+typedef struct FoldRle
+{
+	GString *gsRuns;
+	gboolean bExpanded;   /* state of current run */
+	gint iRun;            /* length of current run */
+	gboolean bHasClosed;
+} FoldRle;
+
+
+static void FoldRleInit(FoldRle *frle)
+{
+	frle->gsRuns=g_string_sized_new(64);
+	frle->bExpanded=TRUE;
+	frle->iRun=0;
+	frle->bHasClosed=FALSE;
+}
+
+
+static void FoldRleAdd(FoldRle *frle,gboolean bExpanded)
+{
+	if(bExpanded!=frle->bExpanded)
+	{
+		g_string_append_printf(frle->gsRuns,"%X,",frle->iRun);
+		frle->bExpanded=bExpanded;
+		frle->iRun=0;
 	}
 
-	/* move through chain to the correct entry or the end of a chain */
-	while(TRUE)
+	frle->bHasClosed|=!bExpanded;
+	frle->iRun++;
+}
+
+
+/* returns NULL if all folds open, otherwise the encoded string which must be freed */
+static gchar * FoldRleFinish(FoldRle *frle)
+{
+	/* only need to store final run if it's closed */
+	if(!frle->bExpanded)
+		g_string_append_printf(frle->gsRuns,"%X",frle->iRun);
+	/* otherwise don't need trailing ',' */
+	else if(frle->gsRuns->len>0)
+		g_string_truncate(frle->gsRuns,frle->gsRuns->len-1);
+
+	return g_string_free(frle->gsRuns,!frle->bHasClosed);
+}
+
+
+/* convert old style base64 fold bitmap (6 fold points per character) to run length encoding */
+static gchar * FoldRleFromBase64(const gchar *pcFolding)
+{
+	FoldRle frle;
+	gint i,iBits;
+
+	FoldRleInit(&frle);
+	for(;*pcFolding!=0;pcFolding++)
+	{
+		iBits=base64_char_to_int[((gint)(*pcFolding))&127];
+		for(i=0;i<6;i++)
+			FoldRleAdd(&frle,((iBits>>i)&1)!=0);
+	}
+
+	return FoldRleFinish(&frle);
+}
+
+
+/* free any data held for file, and reset it to no bookmarks or folds */
+static void ClearFileData(FileData *fd)
+{
+	gint i;
+
+	for(i=0;i<10;i++)
+		fd->iBookmark[i]=-1;
+
+	g_free(fd->pcFolding);
+	fd->pcFolding=NULL;
+	g_free(fd->pcBookmarks);
+	fd->pcBookmarks=NULL;
+	fd->LastChangedTime=-1;
+}
+
+
+/* return comma separated list of numbered bookmark lines (or their positions within the line if
+ * bLinePos), with blank entries for unset bookmarks. returns NULL if no bookmarks set
+*/
+static gchar * NumberedBookmarksToString(FileData *fd,gboolean bLinePos)
+{
+	GString *gsMarkers;
+	gboolean bHasMarker=FALSE;
+	gint i;
+
+	gsMarkers=g_string_sized_new(100);
+	for(i=0;i<10;i++)
 	{
-		/* if have found relavent FileData, then exit */
-		if(utils_str_equal(pcFileName,fdTemp->pcFileName)==TRUE)
-			return fdTemp;
+		if(i>0)
+			g_string_append_c(gsMarkers,',');
 
-		/* if end of chain, then add new entry, and return it. */
-		if(fdTemp->NextNode==NULL)
+		if(fd->iBookmark[i]!=-1)
 		{
-			if((fdTemp->NextNode=(FileData*)(g_malloc(sizeof *fdTemp)))!=NULL)
-			{
-				fdTemp->NextNode->pcFileName=g_strdup(pcFileName);
-				for(i=0;i<10;i++)
-					fdTemp->NextNode->iBookmark[i]=-1;
-
-				/* don't need to initiate iBookmarkLinePos */
-				fdTemp->NextNode->pcFolding=NULL;
-				fdTemp->NextNode->LastChangedTime=-1;
-				fdTemp->NextNode->pcBookmarks=NULL;
-				fdTemp->NextNode->NextNode=NULL;
-			}
-			return fdTemp->NextNode;
+			g_string_append_printf(gsMarkers,"%d",
+			                       bLinePos?fd->iBookmarkLinePos[i]:fd->iBookmark[i]);
+			bHasMarker=TRUE;
+		}
+	}
+
+	return g_string_free(gsMarkers,!bHasMarker);
+}
+
+
+/* parse list produced by NumberedBookmarksToString back into array of 10 values. Blank entries
+ * leave array untouched
+*/
+static void NumberedBookmarksFromString(const gchar *pcMarkers,gint *iValues)
+{
+	gint l;
+
+	if(pcMarkers==NULL)
+		return;
 
+	for(l=0;l<10;l++)
+	{
+		if(pcMarkers[0]!=',' && pcMarkers[0]!=0)
+		{
+			iValues[l]=strtoll(pcMarkers,NULL,10);
+			while(pcMarkers[0]!=0 && pcMarkers[0]!=',')
+				pcMarkers++;
 		}
-		fdTemp=fdTemp->NextNode;
 
+		if(pcMarkers[0]==0)
+			break;
+
+		pcMarkers++;
 	}
 }
 
@@ -367,8 +498,7 @@ static FileData * GetFileData(gchar *pcFileName)
 static gboolean SaveIndividualSetting(GKeyFile *gkf,FileData *fd,gint iNumber,gchar *Filename)
 {
 	gchar *cKey;
-	gchar szMarkers[1000];
-	gchar *pszMarkers;
+	gchar *pcMarkers;
 	gint i;
 
 	/* first check if any bookmarks or folds for this file */
@@ -392,8 +522,8 @@ static gboolean SaveIndividualSetting(GKeyFile *gkf,FileData *fd,gint iNumber,gc
 	if(Filename!=NULL)
 		g_key_file_set_string(gkf,"FileData",cKey,Filename);
 
-	/* save folding data */
-	cKey[0]='B';
+	/* save folding data. Key B held the old base64 bitmap format, G holds run length encoding */
+	cKey[0]='G';
 	if(fd->pcFolding!=NULL && bRememberFolds==TRUE)
 		g_key_file_set_string(gkf,"FileData",cKey,fd->pcFolding);
 
@@ -404,53 +534,19 @@ static gboolean SaveIndividualSetting(GKeyFile *gkf,FileData *fd,gint iNumber,gc
 
 	/* save bookmarks */
 	cKey[0]='D';
-	pszMarkers=szMarkers;
-	pszMarkers[0]=0;
-	for(i=0;i<10;i++)
-	{
-		if(fd->iBookmark[i]!=-1)
-		{
-			sprintf(pszMarkers,"%d",fd->iBookmark[i]);
-			while(pszMarkers[0]!=0)
-				pszMarkers++;
-		}
-
-		pszMarkers[0]=',';
-		pszMarkers[1]=0;
-		pszMarkers++;
-	}
-
-	/* don't need a ',' after last position (have '\0' instead) */
-	pszMarkers--;
-	pszMarkers[0]=0;
-	/* only save markers if have any set. Will contain 9 commas only if none set */
-	if(szMarkers[9]!=0)
-		g_key_file_set_string(gkf,"FileData",cKey,szMarkers);
+	pcMarkers=NumberedBookmarksToString(fd,FALSE);
+	/* only save markers if have any set */
+	if(pcMarkers!=NULL)
+		g_key_file_set_string(gkf,"FileData",cKey,pcMarkers);
+	g_free(pcMarkers);
 
 	/* save positions in bookmarked lines */
 	cKey[0]='E';
-	pszMarkers=szMarkers;
-	pszMarkers[0]=0;
-	for(i=0;i<10;i++)
-	{
-		if(fd->iBookmark[i]!=-1)
-		{
-			sprintf(pszMarkers,"%d",fd->iBookmarkLinePos[i]);
-			while(pszMarkers[0]!=0)
-				pszMarkers++;
-		}
-
-		pszMarkers[0]=',';
-		pszMarkers[1]=0;
-		pszMarkers++;
-	}
-
-	/* don't need a ',' after last position (have '\0' instead) */
-	pszMarkers--;
-	pszMarkers[0]=0;
-	/* only save positions of markers if set. Will contain 9 commas only if none set */
-	if(szMarkers[9]!=0)
-		g_key_file_set_string(gkf,"FileData",cKey,szMarkers);
+	pcMarkers=NumberedBookmarksToString(fd,TRUE);
+	/* only save positions of markers if set */
+	if(pcMarkers!=NULL)
+		g_key_file_set_string(gkf,"FileData",cKey,pcMarkers);
+	g_free(pcMarkers);
 
 	/* save non-numbered bookmarks */
 	cKey[0]='F';
@@ -463,11 +559,30 @@ static gboolean SaveIndividualSetting(GKeyFile *gkf,FileData *fd,gint iNumber,gc
 }
 
 
-/* save settings (preferences, file data such as fold states, marker positions) */
-static void SaveSettings(gchar *filename)
+/* return name of file in settings directory, creating the directory if needed */
+static gchar * GetSettingsFilename(const gchar *pcName)
+{
+	gchar *config_dir,*config_file;
+
+	/* calculate setting directory name */
+	config_dir=g_build_filename(geany->app->configdir,"plugins","Geany_Numbered_Bookmarks",NULL);
+	/* ensure directory exists */
+	g_mkdir_with_parents(config_dir,0755);
+
+	config_file=g_build_filename(config_dir,pcName,NULL);
+	g_free(config_dir);
+
+	return config_file;
+}
+
+
+/* save settings (preferences, file data such as fold states, marker positions)
+ * This rewrites settings.conf with everything known, so any journal entries are no longer needed
+*/
+static void SaveSettings(void)
 {
 	GKeyFile *config=NULL;
-	gchar *config_file=NULL,*config_dir=NULL;
+	gchar *config_file=NULL;
 	gchar *data;
 	FileData* fdTemp=fdKnownFilesSettings;
 	gint i=0;
@@ -497,22 +612,147 @@ static void SaveSettings(gchar *filename)
 	/* turn config into data */
 	data=g_key_file_to_data(config,NULL,NULL);
 
-	/* calculate setting directory name */
-	config_dir=g_build_filename(geany->app->configdir,"plugins","Geany_Numbered_Bookmarks",NULL);
-	/* ensure directory exists */
-	g_mkdir_with_parents(config_dir,0755);
-
-	/* make config_file hold name of settings file */
-	config_file=g_build_filename(config_dir,"settings.conf",NULL);
-
 	/* write data */
+	config_file=GetSettingsFilename("settings.conf");
 	utils_write_file(config_file,data);
+	g_free(config_file);
+
+	/* journal has now been folded into settings file */
+	config_file=GetSettingsFilename("settings.journal");
+	g_remove(config_file);
+	iJournalEntries=0;
 
 	/* free memory */
-	g_free(config_dir);
 	g_free(config_file);
 	g_key_file_free(config);
 	g_free(data);
+}
+
+
+/* idle handler to fold journal back into settings file */
+static gboolean CompactJournal(gpointer data)
+{
+	iCompactSourceId=0;
+	SaveSettings();
+
+	return FALSE;
+}
+
+
+/* append details of one file to the journal rather than rewriting whole settings file
+ * Each line holds tab separated fields: escaped filename, last changed time, numbered bookmark
+ * lines, positions in those lines, fold states, and non-numbered bookmarks. Blank fields are unset.
+*/
+static void AppendToJournal(FileData *fd)
+{
+	gchar *config_file;
+	gchar *pcName,*pcLines,*pcPositions;
+	gchar *pcRecord;
+	FILE *fp;
+
+	pcName=g_strescape(fd->pcFileName,NULL);
+	pcLines=NumberedBookmarksToString(fd,FALSE);
+	pcPositions=NumberedBookmarksToString(fd,TRUE);
+	pcRecord=g_strdup_printf("%s\t%d\t%s\t%s\t%s\t%s\n",pcName,fd->LastChangedTime,
+	                         pcLines!=NULL?pcLines:"",
+	                         pcPositions!=NULL?pcPositions:"",
+	                         (fd->pcFolding!=NULL && bRememberFolds)?fd->pcFolding:"",
+	                         (fd->pcBookmarks!=NULL && bRememberBookmarks)?fd->pcBookmarks:"");
+
+	config_file=GetSettingsFilename("settings.journal");
+	fp=g_fopen(config_file,"a");
+	/* if can't append then fall back to rewriting settings file */
+	if(fp==NULL || fputs(pcRecord,fp)==EOF)
+		iJournalEntries=JOURNAL_COMPACT_THRESHOLD;
+	else
+		iJournalEntries++;
+
+	if(fp!=NULL)
+		fclose(fp);
+
+	/* once journal gets large, fold it back into settings file when idle */
+	if(iJournalEntries>=JOURNAL_COMPACT_THRESHOLD && iCompactSourceId==0)
+		iCompactSourceId=g_idle_add_full(G_PRIORITY_LOW,CompactJournal,NULL,NULL);
+
+	/* free memory */
+	g_free(config_file);
+	g_free(pcRecord);
+	g_free(pcPositions);
+	g_free(pcLines);
+	g_free(pcName);
+}
+
+
+/* replay journal over data loaded from settings file */
+static void LoadJournal(void)
+{
+	gchar *config_file;
+	gchar *pcContents=NULL;
+	gchar **pcLines,**pcFields;
+	gchar *pcName;
+	FileData *fd;
+	gint i;
+
+	config_file=GetSettingsFilename("settings.journal");
+	if(!g_file_get_contents(config_file,&pcContents,NULL,NULL))
+	{
+		g_free(config_file);
+		return;
+	}
+
+	pcLines=g_strsplit(pcContents,"\n",0);
+	for(i=0;pcLines[i]!=NULL;i++)
+	{
+		pcFields=g_strsplit(pcLines[i],"\t",0);
+		/* ignore partly written records */
+		if(g_strv_length(pcFields)!=6)
+		{
+			g_strfreev(pcFields);
+			continue;
+		}
+
+		pcName=g_strcompress(pcFields[0]);
+		fd=GetFileData(pcName);
+		g_free(pcName);
+
+		/* later records replace earlier ones */
+		ClearFileData(fd);
+		fd->LastChangedTime=strtoll(pcFields[1],NULL,10);
+		NumberedBookmarksFromString(pcFields[2],fd->iBookmark);
+		NumberedBookmarksFromString(pcFields[3],fd->iBookmarkLinePos);
+		if(pcFields[4][0]!=0 && bRememberFolds==TRUE)
+			fd->pcFolding=g_strdup(pcFields[4]);
+		if(pcFields[5][0]!=0 && bRememberBookmarks==TRUE)
+			fd->pcBookmarks=g_strdup(pcFields[5]);
+
+		iJournalEntries++;
+		g_strfreev(pcFields);
+	}
+
+	/* fold what was in journal into settings file once things have settled down */
+	if(iJournalEntries>0 && iCompactSourceId==0)
+		iCompactSourceId=g_idle_add_full(G_PRIORITY_LOW,CompactJournal,NULL,NULL);
+
+	/* free memory */
+	g_strfreev(pcLines);
+	g_free(pcContents);
+	g_free(config_file);
+}
+
+
+/* save details of a single file after it has been saved */
+static void SaveFileDetails(gchar *filename)
+{
+	GKeyFile *config=NULL;
+	gchar *config_file=NULL;
+	gchar *data;
+	FileData* fdTemp;
+
+	/* get pointer to data we're saving */
+	fdTemp=GetFileData(filename);
+
+	/* record change in journal rather than rewriting the settings for every file known */
+	AppendToJournal(fdTemp);
 
 	/* now consider if not purely saving file settings to main settings file */
 	/* return if not saving data with file */
@@ -522,9 +762,6 @@ static void SaveSettings(gchar *filename)
 	/* setup keyfile to hold values */
 	config=g_key_file_new();
 
-	/* get pointer to data we're saving */
-	fdTemp=GetFileData(filename);
-
 	/* calculate settings filename */
 	config_file=g_strdup_printf("%s%s",filename,FileDetailsSuffix);
 
@@ -553,8 +790,6 @@ static gboolean LoadIndividualSetting(GKeyFile *gkf,gint iNumber,gchar *Filename
 {
 	gchar *pcKey=NULL;
 	gchar *pcTemp;
-	gchar *pcTemp2;
-	gint l;
 	FileData *fd=NULL;
 
 	/* if loading from local file then no fiilename in file and no number in key*/
@@ -584,12 +819,21 @@ static gboolean LoadIndividualSetting(GKeyFile *gkf,gint iNumber,gchar *Filename
 		g_free(pcTemp);
 	}
 
-	/* get folding data */
-	pcKey[0]='B';
+	/* get folding data, converting from old base64 bitmap if that's all there is */
+	g_free(fd->pcFolding);
+	fd->pcFolding=NULL;
 	if(bRememberFolds==TRUE)
+	{
+		pcKey[0]='G';
 		fd->pcFolding=(gchar*)(utils_get_setting_string(gkf,"FileData",pcKey,NULL));
-	else
-		fd->pcFolding=NULL;
+		pcKey[0]='B';
+		if(fd->pcFolding==NULL &&
+		   (pcTemp=(gchar*)(utils_get_setting_string(gkf,"FileData",pcKey,NULL)))!=NULL)
+		{
+			fd->pcFolding=FoldRleFromBase64(pcTemp);
+			g_free(pcTemp);
+		}
+	}
 
 	/* load last saved time */
 	pcKey[0]='C';
@@ -598,48 +842,25 @@ static gboolean LoadIndividualSetting(GKeyFile *gkf,gint iNumber,gchar *Filename
 	pcKey[0]='D';
 	pcTemp=(gchar*)(utils_get_setting_string(gkf,"FileData",pcKey,NULL));
 	/* pcTemp contains comma seperated numbers (or blank for -1) */
-	pcTemp2=pcTemp;
-	if(pcTemp!=NULL) for(l=0;l<10;l++)
-	{
-		/* Bookmark entries are initialized to -1, so only need to parse non-empty slots */
-		if(pcTemp2[0]!=',' && pcTemp2[0]!=0)
-		{
-			fd->iBookmark[l]=strtoll(pcTemp2,NULL,10);
-			while(pcTemp2[0]!=0 && pcTemp2[0]!=',')
-				pcTemp2++;
-		}
-
-		pcTemp2++;
-	}
+	NumberedBookmarksFromString(pcTemp,fd->iBookmark);
 	g_free(pcTemp);
 
 	/* get position in bookmarked lines */
 	pcKey[0]='E';
 	pcTemp=(gchar*)(utils_get_setting_string(gkf,"FileData",pcKey,NULL));
 	/* pcTemp contains comma seperated numbers (or blank for -1) */
-	pcTemp2=pcTemp;
-	if(pcTemp!=NULL) for(l=0;l<10;l++)
-	{
-		/* Bookmark entries are initialized to -1, so only need to parse non-empty slots */
-		if(pcTemp2[0]!=',' && pcTemp2[0]!=0)
-		{
-			fd->iBookmarkLinePos[l]=strtoll(pcTemp2,NULL,10);
-			while(pcTemp2[0]!=0 && pcTemp2[0]!=',')
-				pcTemp2++;
-		}
-
-		pcTemp2++;
-	}
+	NumberedBookmarksFromString(pcTemp,fd->iBookmarkLinePos);
+	g_free(pcTemp);
 
 	/* get non-numbered bookmarks */
 	pcKey[0]='F';
+	g_free(fd->pcBookmarks);
 	if(bRememberBookmarks==TRUE)
 		fd->pcBookmarks=(gchar*)(utils_get_setting_string(gkf,"FileData",pcKey,NULL));
 	else
 		fd->pcBookmarks=NULL;
 
 	/* free used memory */
-	g_free(pcTemp);
 	g_free(pcKey);
 
 	return TRUE;
@@ -651,16 +872,10 @@ static void LoadSettings(void)
 {
 	gint i;
 	gchar *config_file=NULL;
-	gchar *config_dir=NULL;
 	GKeyFile *config=NULL;
 
-	/* Make config_dir hold directory name of settings file */
-	config_dir=g_build_filename(geany->app->configdir,"plugins","Geany_Numbered_Bookmarks",NULL);
-	/* ensure directory exists */
-	g_mkdir_with_parents(config_dir,0755);
-
 	/* make config_file hold name of settings file */
-	config_file=g_build_filename(config_dir,"settings.conf",NULL);
+	config_file=GetSettingsFilename("settings.conf");
 
 	/* either load settings file, or create one from default */
 	config=g_key_file_new();
@@ -684,8 +899,10 @@ static void LoadSettings(void)
 	while(LoadIndividualSetting(config,i,NULL))
 		i++;
 
+	/* apply any changes made since settings file was last written */
+	LoadJournal();
+
 	/* free memory */
-	g_free(config_dir);
 	g_free(config_file);
 	g_key_file_free(config);
 }
@@ -952,8 +1169,8 @@ static void on_document_open(GObject *obj, GeanyDocument *doc, gpointer user_dat
 	GtkWidget *dialog;
 	gchar *cFoldData=NULL;
 	gchar *pcTemp;
-	/* keep compiler happy & initialise iBits: will logically be initiated anyway */
-	gint iBits=0,iFlags,iBitCounter;
+	gint iFlags,iRun;
+	gboolean bExpanded;
 
 	/* if saving details in file alongside file we're editing then load it up */
 	if(WhereToSaveFileDetails==1)
@@ -993,28 +1210,34 @@ ill not be loaded.\nPress Ignore to try an load markers anyway."),doc->file_name
 
 				iLineCount=scintilla_send_message(sci,SCI_GETLINECOUNT,0,0);
 
+				/* first run is of open folds */
+				bExpanded=TRUE;
+				iRun=strtoll(cFoldData,&cFoldData,16);
+
 				/* go through lines setting fold status */
-				for(i=0,iBitCounter=6;i<iLineCount;i++)
+				for(i=0;i<iLineCount;i++)
 				{
 					iFlags=scintilla_send_message(sci,SCI_GETFOLDLEVEL,i,0);
 					/* ignore non-folding lines */
 					if((iFlags & SC_FOLDLEVELHEADERFLAG)==0)
 						continue;
 
-					/* get next 6 fold states if needed */
-					if(iBitCounter==6)
+					/* move on to next run if reached end of this one */
+					while(iRun==0 && cFoldData[0]==',')
 					{
-						iBitCounter=0;
-						iBits=base64_char_to_int[(gint)(*cFoldData)];
-						cFoldData++;
+						iRun=strtoll(cFoldData+1,&cFoldData,16);
+						bExpanded=!bExpanded;
 					}
 
+					/* remaining folds are all open so nothing left to do */
+					if(iRun==0)
+						break;
+
 					/* set fold if needed */
-					if(((iBits>>iBitCounter)&1)==0)
+					if(!bExpanded)
 						scintilla_send_message(sci,SCI_TOGGLEFOLD,i,0);
 
-					/* increment counter */
-					iBitCounter++;
+					iRun--;
 				}
 			}
 
@@ -1056,12 +1279,12 @@ ill not be loaded.\nPress Ignore to try an load markers anyway."),doc->file_name
 static void on_document_save(GObject *obj, GeanyDocument *doc, gpointer user_data)
 {
 	FileData *fd;
-	gint i,iLineCount,iFlags,iBitCounter=0;
+	gint i,iLineCount,iFlags;
 	ScintillaObject* sci=doc->editor->sci;
 	struct stat sBuf;
 	GByteArray *gbaFoldData=NULL;
-	guint8 guiFold=0;
-	gboolean bHasClosedFold=FALSE,bHasBookmark=FALSE;
+	FoldRle frle;
+	gboolean bHasBookmark=FALSE;
 	gchar szLine[20];
 
 	/* update markerpos */
@@ -1071,9 +1294,10 @@ static void on_document_save(GObject *obj, GeanyDocument *doc, gpointer user_dat
 		                                        1<<(fd->iBookmarkMarkerUsed[i]));
 
 	/* save fold state */
+	g_free(fd->pcFolding);
 	if(bRememberFolds==TRUE)
 	{
-		gbaFoldData=g_byte_array_sized_new(1000);
+		FoldRleInit(&frle);
 
 		iLineCount=scintilla_send_message(sci,SCI_GETLINECOUNT,0,0);
 		/* go through each line */
@@ -1084,40 +1308,19 @@ static void on_document_save(GObject *obj, GeanyDocument *doc, gpointer user_dat
 			if((iFlags & SC_FOLDLEVELHEADERFLAG)==0)
 				continue;
 
-			iFlags=scintilla_send_message(sci,SCI_GETFOLDEXPANDED,i,0);
-			/* make note of if any folds closed or not */
-			bHasClosedFold|=((iFlags&1)==0);
 			/* remember if folded or not */
-			guiFold|=(iFlags&1)<<iBitCounter;
-			iBitCounter++;
-			if(iBitCounter<6)
-				continue;
-
-			/* if have 6 bits then store these */
-			iBitCounter=0;
-			guiFold=(guint8)base64_int_to_char[guiFold];
-			g_byte_array_append(gbaFoldData,&guiFold,1);
-			guiFold=0;
-		}
-
-		/* flush buffer */
-		if(iBitCounter!=0)
-		{
-			guiFold=(guint8)base64_int_to_char[guiFold];
-			g_byte_array_append(gbaFoldData,&guiFold,1);
+			iFlags=scintilla_send_message(sci,SCI_GETFOLDEXPANDED,i,0);
+			FoldRleAdd(&frle,(iFlags&1)!=0);
 		}
 
-		/* transfer data to text string if have closed fold. Default will leave them open*/
-		fd->pcFolding=(!bHasClosedFold)?NULL:g_strndup((gchar*)(gbaFoldData->data),
-	                                               gbaFoldData->len);
-
-		/* free byte array space */
-		g_byte_array_free(gbaFoldData,TRUE);
+		/* will be NULL if no closed folds. Default will leave them open */
+		fd->pcFolding=FoldRleFinish(&frle);
 	}
 	else
 		fd->pcFolding=NULL;
 
 	/* now save off bookmarks */
+	g_free(fd->pcBookmarks);
 	if(bRememberBookmarks==TRUE)
 	{
 		gbaFoldData=g_byte_array_sized_new(1000);
@@ -1149,7 +1352,7 @@ static void on_document_save(GObject *obj, GeanyDocument *doc, gpointer user_dat
 		fd->LastChangedTime=sBuf.st_mtime;
 
 	/* save settings */
-	SaveSettings(doc->file_name);
+	SaveFileDetails(doc->file_name);
 }
 
 
@@ -1204,7 +1407,7 @@ static void on_configure_response(GtkDialog *dialog, gint response, gpointer use
 
 	/* now save new settings if they have changed */
 	if(bSettingsHaveChanged)
-		SaveSettings(NULL);
+		SaveSettings();
 }
 
 
@@ -1546,6 +1749,13 @@ void plugin_cleanup(void)
 	/* uncouple keypress monitor */
 	g_signal_handler_disconnect(geany->main_widgets->window,key_release_signal_id);
 
+	/* fold any outstanding journal entries into settings file */
+	if(iCompactSourceId!=0)
+		g_source_remove(iCompactSourceId);
+
+	if(iJournalEntries>0)
+		SaveSettings();
+
 	/* go through all documents removing markers (?needed) */
 	for(i=0;i<GEANY(documents_array)->len;i++)
 		if(documents[i]->is_valid) {
@@ -1559,6 +1769,9 @@ void plugin_cleanup(void)
 		}
 
 	/* Clear memory used to hold file details */
+	if(htKnownFiles!=NULL)
+		g_hash_table_destroy(htKnownFiles);
+
 	while(fdTemp!=NULL)
 	{
 		/* free filename */
@@ -21,9 +21,23 @@
 
 #include "geanypg.h"
 
+static gpgme_error_t geanypg_decrypt_verify_op(encrypt_data * ed, gpgme_data_t cipher, gpointer user_data)
+{
+    gpgme_data_t plain = (gpgme_data_t) user_data;
+    gpgme_error_t err = gpgme_op_decrypt_verify(ed->ctx, cipher, plain);
+    if (gpgme_err_code(err) == GPG_ERR_NO_DATA) /* no encription, but maybe signatures */
+    {
+        /* start over */
+        gpgme_data_seek(cipher, 0, SEEK_SET);
+        gpgme_data_seek(plain, 0, SEEK_SET);
+        err = gpgme_op_verify(ed->ctx, cipher, NULL, plain);
+    }
+    return err;
+}
+
 static void geanypg_decrypt_verify(encrypt_data * ed)
 {
-    gpgme_data_t plain, cipher;
+    gpgme_data_t plain;
     gpgme_error_t err;
     FILE * tempfile;
 
@@ -35,20 +49,10 @@ static void geanypg_decrypt_verify(encrypt_data * ed)
     }
     gpgme_data_new_from_stream(&plain, tempfile);
 
-    geanypg_load_buffer(&cipher);
-
-    err = gpgme_op_decrypt_verify(ed->ctx, cipher, plain);
-    if (gpgme_err_code(err) == GPG_ERR_NO_DATA) /* no encription, but maybe signatures */
-    {
-        /* maybe reaload cipher */
-        gpgme_data_release(cipher);
-        geanypg_load_buffer(&cipher);
-        rewind(tempfile);
-        err = gpgme_op_verify(ed->ctx, cipher, NULL, plain);
-    }
-    if (err != GPG_ERR_NO_ERROR)
+    err = geanypg_run_op(ed, geanypg_decrypt_verify_op, plain, _("Decrypting"));
+    if (err != GPG_ERR_NO_ERROR && gpgme_err_code(err) != GPG_ERR_CANCELED)
         geanypg_show_err_msg(err);
-    else
+    else if (gpgme_err_code(err) != GPG_ERR_CANCELED)
     {
         rewind(tempfile);
         geanypg_write_file(tempfile);
@@ -57,7 +61,6 @@ static void geanypg_decrypt_verify(encrypt_data * ed)
 
     fclose(tempfile);
     /* release buffers */
-    gpgme_data_release(cipher);
     gpgme_data_release(plain);
 }
 
@@ -70,7 +73,6 @@ void geanypg_decrypt_cb(GtkMenuItem * menuitem, gpointer user_data)
     if (err && geanypg_show_err_msg(err))
         return;
     gpgme_set_protocol(ed.ctx, GPGME_PROTOCOL_OpenPGP);
-    gpgme_set_passphrase_cb(ed.ctx, geanypg_passphrase_cb, NULL);
     if (geanypg_get_keys(&ed) && geanypg_get_secret_keys(&ed))
         geanypg_decrypt_verify(&ed);
     geanypg_release_keys(&ed);
@@ -21,10 +21,28 @@
 
 #include "geanypg.h"
 
+typedef struct
+{
+    gpgme_key_t * recp;
+    int sign;
+    int flags;
+    gpgme_data_t cipher;
+} encrypt_args;
+
+static gpgme_error_t geanypg_encrypt_op(encrypt_data * ed, gpgme_data_t plain, gpointer user_data)
+{
+    encrypt_args * args = (encrypt_args *) user_data;
+    if (args->sign)
+        return gpgme_op_encrypt_sign(ed->ctx, args->recp, args->flags, plain, args->cipher);
+    else
+        return gpgme_op_encrypt(ed->ctx, args->recp, args->flags, plain, args->cipher);
+}
+
 static void geanypg_encrypt(encrypt_data * ed, gpgme_key_t * recp, int sign, int flags)
 {   /* FACTORIZE */
-    gpgme_data_t plain, cipher;
+    gpgme_data_t cipher;
     gpgme_error_t err;
+    encrypt_args args;
     FILE * tempfile;
     tempfile = tmpfile();
     if (!(tempfile))
@@ -35,13 +53,12 @@ static void geanypg_encrypt(encrypt_data * ed, gpgme_key_t * recp, int sign, int
     gpgme_data_new_from_stream(&cipher, tempfile);
     gpgme_data_set_encoding(cipher, GPGME_DATA_ENCODING_ARMOR);
 
-    geanypg_load_buffer(&plain);
-
     /* do the actual encryption */
-    if (sign)
-        err = gpgme_op_encrypt_sign(ed->ctx, recp, flags, plain, cipher);
-    else
-        err = gpgme_op_encrypt(ed->ctx, recp, flags, plain, cipher);
+    args.recp = recp;
+    args.sign = sign;
+    args.flags = flags;
+    args.cipher = cipher;
+    err = geanypg_run_op(ed, geanypg_encrypt_op, &args, _("Encrypting"));
     if (err != GPG_ERR_NO_ERROR && gpgme_err_code(err) != GPG_ERR_CANCELED)
         geanypg_show_err_msg(err);
     else if(gpgme_err_code(err) != GPG_ERR_CANCELED)
@@ -52,7 +69,6 @@ static void geanypg_encrypt(encrypt_data * ed, gpgme_key_t * recp, int sign, int
 
     fclose(tempfile);
     /* release buffers */
-    gpgme_data_release(plain);
     gpgme_data_release(cipher);
 }
 
@@ -66,7 +82,6 @@ void geanypg_encrypt_cb(GtkMenuItem * menuitem, gpointer user_data)
     if (err && geanypg_show_err_msg(err))
         return;
     gpgme_set_armor(ed.ctx, 1);
-    gpgme_set_passphrase_cb(ed.ctx, geanypg_passphrase_cb, NULL);
     if (geanypg_get_keys(&ed) && geanypg_get_secret_keys(&ed))
     {
         gpgme_key_t * recp = NULL;
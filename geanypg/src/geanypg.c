@@ -70,12 +70,20 @@ void plugin_init(GeanyData *data)
     GtkWidget * decrypt;
     GtkWidget * verify;
 
-    gpgme_error_t err = geanypg_init_gpgme();
+    gpgme_error_t err;
+
+    /* operations run in a worker thread */
+    if (! g_thread_supported())
+        g_thread_init(NULL);
+
+    err = geanypg_init_gpgme();
     if (err)
     {
         geanypg_show_err_msg(err);
         return;
     }
+    geanypg_keyring_init();
+
     /* Create a new menu item and show it */
     main_menu_item = gtk_menu_item_new_with_mnemonic("GeanyPG");
     gtk_widget_show(main_menu_item);
@@ -117,4 +125,5 @@ void plugin_cleanup(void)
 {
     if (main_menu_item)
         gtk_widget_destroy(main_menu_item);
+    geanypg_keyring_cleanup();
 }
@@ -52,18 +52,26 @@ typedef struct
     unsigned long nskeys;
 } encrypt_data;
 
+/* an operation on the current document, run in a worker thread */
+typedef gpgme_error_t (*geanypg_op_func)(encrypt_data * ed, gpgme_data_t buffer, gpointer user_data);
+
 extern GeanyPlugin     *geany_plugin;
 extern GeanyData       *geany_data;
 extern GeanyFunctions  *geany_functions;
 
 /* auxiliary functions (helper_functions.c) */
 void geanypg_init_ed(encrypt_data * ed);
-int geanypg_get_keys(encrypt_data * ed);
-int geanypg_get_secret_keys(encrypt_data * ed);
 void geanypg_release_keys(encrypt_data * ed);
-void geanypg_load_buffer(gpgme_data_t * buffer);
+gpgme_error_t geanypg_run_op(encrypt_data * ed, geanypg_op_func func, gpointer user_data, const char * title);
 void geanypg_write_file(FILE * file);
 
+/* cached key listing (keyring.c) */
+void geanypg_keyring_init(void);
+void geanypg_keyring_cleanup(void);
+int geanypg_get_keys(encrypt_data * ed);
+int geanypg_get_secret_keys(encrypt_data * ed);
+gpgme_key_t geanypg_find_key(const char * fpr);
+
 /* some more auxiliary functions (verify_aux.c) */
 void geanypg_handle_signatures(encrypt_data * ed, int need_error);
 void geanypg_check_sig(encrypt_data * ed, gpgme_signature_t sig);
@@ -80,7 +88,8 @@ void geanypg_sign_cb(GtkMenuItem * menuitem, gpointer user_data);
 void geanypg_decrypt_cb(GtkMenuItem * menuitem, gpointer user_data);
 void geanypg_verify_cb(GtkMenuItem * menuitem, gpointer user_data);
 
-/* pinentry callback */
+/* pinentry callback, hook is NULL or where to report an error message
+ * to show once the operation is done */
 gpgme_error_t geanypg_passphrase_cb(void *hook,
                                     const char *uid_hint,
                                     const char *passphrase_info,
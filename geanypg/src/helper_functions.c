@@ -29,82 +29,6 @@ void geanypg_init_ed(encrypt_data * ed)
     ed->nskeys = 0;
 }
 
-int geanypg_get_keys(encrypt_data * ed)
-{
-    gpgme_error_t err;
-    unsigned long size = SIZE;
-    /* initialize idx to 0 */
-    unsigned long idx = 0;
-    /* allocate array of size 1N */
-    gpgme_key_t * key;
-    ed->key_array = (gpgme_key_t*) malloc(SIZE * sizeof(gpgme_key_t));
-    err = gpgme_op_keylist_start(ed->ctx, NULL, 0);
-    while (!err)
-    {
-        key = ed->key_array + idx;
-        err = gpgme_op_keylist_next(ed->ctx, key);
-        if (err)
-            break;
-        if ((*key)->revoked  || /* key cannot be used */
-            (*key)->expired  ||
-            (*key)->disabled ||
-            (*key)->invalid)
-           gpgme_key_unref(*key);
-        else /* key is valid */
-            ++idx;
-        if (idx >= size)
-        {
-            size += SIZE;
-            ed->key_array = (gpgme_key_t*) realloc(ed->key_array, size * sizeof(gpgme_key_t));
-        }
-    }
-    ed->nkeys = idx;
-    if (gpg_err_code(err) != GPG_ERR_EOF)
-    {
-        geanypg_show_err_msg(err);
-        return 0;
-    }
-    return 1;
-}
-
-int geanypg_get_secret_keys(encrypt_data * ed)
-{
-    gpgme_error_t err;
-    unsigned long size = SIZE;
-    /* initialize idx to 0 */
-    unsigned long idx = 0;
-    /* allocate array of size 1N */
-    gpgme_key_t * key;
-    ed->skey_array = (gpgme_key_t*) malloc(SIZE * sizeof(gpgme_key_t));
-    err = gpgme_op_keylist_start(ed->ctx, NULL, 1);
-    while (!err)
-    {
-        key = ed->skey_array + idx;
-        err = gpgme_op_keylist_next(ed->ctx, key);
-        if (err)
-            break;
-        if ((*key)->revoked  || /* key cannot be used */
-            (*key)->expired  ||
-            (*key)->disabled ||
-            (*key)->invalid)
-           gpgme_key_unref(*key);
-        else /* key is valid */
-            ++idx;
-        if (idx >= size)
-        {
-            size += SIZE;
-            ed->skey_array = (gpgme_key_t*) realloc(ed->skey_array, size * sizeof(gpgme_key_t));
-        }
-    }
-    ed->nskeys = idx;
-    if (gpg_err_code(err) != GPG_ERR_EOF)
-    {
-        geanypg_show_err_msg(err);
-        return 0;
-    }
-    return 1;
-}
-
 void geanypg_release_keys(encrypt_data * ed)
 {
     gpgme_key_t * ptr;
@@ -129,36 +53,200 @@ void geanypg_release_keys(encrypt_data * ed)
 }
 
 
-void geanypg_load_buffer(gpgme_data_t * buffer)
+/* state of an operation running on the current document */
+typedef struct
+{
+    encrypt_data * ed;
+    geanypg_op_func func;
+    gpointer user_data;
+    gpgme_data_t buffer;
+    const char * text;       /* the document text, read in place */
+    off_t size;
+    off_t pos;
+    volatile gint progress;  /* per thousand of the text read */
+    volatile gint cancelled;
+    gpgme_error_t err;
+    const char * message;    /* error reported by the worker, shown when it's done */
+    GMainLoop * loop;
+    GtkWidget * dialog;
+    GtkWidget * progress_bar;
+    guint progress_id;
+    guint show_id;
+} geanypg_job;
+
+static ssize_t geanypg_read_cb(void * handle, void * buffer, size_t size)
+{
+    geanypg_job * job = (geanypg_job *) handle;
+    if (g_atomic_int_get(&job->cancelled))
+    {
+        errno = ECANCELED;
+        return -1;
+    }
+    if ((off_t) size > job->size - job->pos)
+        size = job->size - job->pos;
+    memcpy(buffer, job->text + job->pos, size);
+    job->pos += size;
+    g_atomic_int_set(&job->progress, job->size ? (gint) (job->pos * 1000 / job->size) : 1000);
+    return size;
+}
+
+static off_t geanypg_seek_cb(void * handle, off_t offset, int whence)
+{
+    geanypg_job * job = (geanypg_job *) handle;
+    switch (whence)
+    {
+        case SEEK_SET: break;
+        case SEEK_CUR: offset += job->pos; break;
+        case SEEK_END: offset += job->size; break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+    if (offset < 0 || offset > job->size)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    job->pos = offset;
+    return offset;
+}
+
+static struct gpgme_data_cbs geanypg_cbs = { geanypg_read_cb, NULL, geanypg_seek_cb, NULL };
+
+static gboolean geanypg_worker_done(gpointer data)
+{
+    geanypg_job * job = (geanypg_job *) data;
+    g_main_loop_quit(job->loop);
+    return FALSE;
+}
+
+static gpointer geanypg_worker(gpointer data)
+{
+    geanypg_job * job = (geanypg_job *) data;
+    job->err = job->func(job->ed, job->buffer, job->user_data);
+    /* wake up the main loop waiting for the operation */
+    g_idle_add(geanypg_worker_done, job);
+    return NULL;
+}
+
+static gboolean geanypg_update_progress(gpointer data)
+{
+    geanypg_job * job = (geanypg_job *) data;
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(job->progress_bar),
+                                  g_atomic_int_get(&job->progress) / 1000.0);
+    return TRUE;
+}
+
+static gboolean geanypg_show_progress(gpointer data)
+{
+    geanypg_job * job = (geanypg_job *) data;
+    job->show_id = 0;
+    gtk_widget_show_all(job->dialog);
+    job->progress_id = g_timeout_add(100, geanypg_update_progress, job);
+    return FALSE;
+}
+
+static void geanypg_progress_response(GtkDialog * dialog, gint response, gpointer data)
+{
+    geanypg_job * job = (geanypg_job *) data;
+    /* stop gpgme, including a running gpg process, the worker returns soon */
+    g_atomic_int_set(&job->cancelled, 1);
+    gpgme_cancel_async(job->ed->ctx);
+    gtk_dialog_set_response_sensitive(dialog, GTK_RESPONSE_CANCEL, FALSE);
+}
+
+/* Runs the main loop until the worker is done.  If it takes a while, a
+ * progress dialog allows to cancel the operation. */
+static void geanypg_wait(geanypg_job * job, const char * title)
+{
+    GtkWidget * vbox;
+    job->dialog = gtk_dialog_new_with_buttons(title,
+                                              GTK_WINDOW(geany->main_widgets->window),
+                                              GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                              GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+                                              NULL);
+    vbox = ui_dialog_vbox_new(GTK_DIALOG(job->dialog));
+    job->progress_bar = gtk_progress_bar_new();
+    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(job->progress_bar), title);
+    gtk_box_pack_start(GTK_BOX(vbox), job->progress_bar, FALSE, FALSE, 6);
+    g_signal_connect(job->dialog, "response", G_CALLBACK(geanypg_progress_response), job);
+    /* closing the dialog cancels the operation, the dialog stays until it's done */
+    g_signal_connect(job->dialog, "delete-event", G_CALLBACK(gtk_true), NULL);
+
+    /* don't bother showing the progress of quick operations */
+    job->show_id = g_timeout_add(200, geanypg_show_progress, job);
+    job->loop = g_main_loop_new(NULL, FALSE);
+    /* the dialog is modal even before it's shown */
+    gtk_grab_add(job->dialog);
+    g_main_loop_run(job->loop);
+    gtk_grab_remove(job->dialog);
+    g_main_loop_unref(job->loop);
+
+    if (job->show_id)
+        g_source_remove(job->show_id);
+    if (job->progress_id)
+        g_source_remove(job->progress_id);
+    gtk_widget_destroy(job->dialog);
+}
+
+/* Runs func on the text of the current document (or its selection), which
+ * gpgme reads in place without copying it.  The operation runs in a worker
+ * thread; if it takes a while, a progress dialog allows to cancel it. */
+gpgme_error_t geanypg_run_op(encrypt_data * ed, geanypg_op_func func, gpointer user_data, const char * title)
 {
-    /* gpgme_data_new_from_mem(buffer, text, size, 0); */
     GeanyDocument * doc = document_get_current();
-    char * data = NULL;
-    unsigned long size = 0;
-    if (sci_has_selection(doc->editor->sci))
+    ScintillaObject * sci = doc->editor->sci;
+    geanypg_job job;
+    GThread * thread;
+    int start, end;
+
+    memset(&job, 0, sizeof job);
+    job.ed = ed;
+    job.func = func;
+    job.user_data = user_data;
+    if (sci_has_selection(sci))
     {
-        size = scintilla_send_message(doc->editor->sci, SCI_GETSELTEXT, 0, 0) - 1;
-        data = (char *) malloc(size + 1);
-        scintilla_send_message(doc->editor->sci, SCI_GETSELTEXT, 0, (sptr_t)data);
-        gpgme_data_new_from_mem(buffer, data, size, 1);
+        start = sci_get_selection_start(sci);
+        end = sci_get_selection_end(sci);
     }
     else
     {
-        size = scintilla_send_message(doc->editor->sci, SCI_GETLENGTH, 0, 0);
-        data = (char *) malloc(size + 1);
-        scintilla_send_message(doc->editor->sci, SCI_GETTEXT, (uptr_t)(size + 1), (sptr_t)data);
-        gpgme_data_new_from_mem(buffer, data, size, 1);
+        start = 0;
+        end = sci_get_length(sci);
     }
-    if (data) /* if there is no text data may still be NULL */
-        free(data);
-    gpgme_data_set_encoding(*buffer, GPGME_DATA_ENCODING_BINARY);
+    /* the pointer stays valid as long as the document isn't modified */
+    job.text = (const char *) scintilla_send_message(sci, SCI_GETCHARACTERPOINTER, 0, 0) + start;
+    job.size = end - start;
+    gpgme_data_new_from_cbs(&job.buffer, &geanypg_cbs, &job);
+    gpgme_data_set_encoding(job.buffer, GPGME_DATA_ENCODING_BINARY);
+    /* the worker can't show dialogs, the callback reports errors in the job */
+    gpgme_set_passphrase_cb(ed->ctx, geanypg_passphrase_cb, &job.message);
+
+    scintilla_send_message(sci, SCI_SETREADONLY, 1, 0);
+    thread = g_thread_create(geanypg_worker, &job, TRUE, NULL);
+    if (!thread)
+        job.err = func(ed, job.buffer, user_data);
+    else
+    {
+        geanypg_wait(&job, title);
+        g_thread_join(thread);
+    }
+    gpgme_set_passphrase_cb(ed->ctx, geanypg_passphrase_cb, NULL);
+    scintilla_send_message(sci, SCI_SETREADONLY, doc->readonly, 0);
+    if (job.message)
+        dialogs_show_msgbox(GTK_MESSAGE_ERROR, "%s", job.message);
+
+    gpgme_data_release(job.buffer);
+    if (job.cancelled)
+        return gpgme_error(GPG_ERR_CANCELED);
+    return job.err;
 }
 
 void geanypg_write_file(FILE * file)
 {
-#define BUFSIZE 2048
+#define BUFSIZE (1024 * 1024)
     unsigned long size;
-    char buffer[BUFSIZE] = {0};
+    char * buffer = (char *) malloc(BUFSIZE);
     GeanyDocument * doc = document_get_current();
     sci_start_undo_action(doc->editor->sci);
     if (sci_has_selection(doc->editor->sci))
@@ -176,5 +264,6 @@ void geanypg_write_file(FILE * file)
             scintilla_send_message(doc->editor->sci, SCI_APPENDTEXT, (uptr_t) size, (sptr_t) buffer);
     }
     sci_end_undo_action(doc->editor->sci);
+    free(buffer);
 #undef BUFSIZE
 }
@@ -0,0 +1,388 @@
+/*      keyring.c
+ *
+ *      Copyright 2011 Hans Alves <alves.h88@gmail.com>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+/* Listing a large keyring takes seconds, so the usable keys are listed once
+ * in a background thread and cached.  When the keyring files change, they are
+ * listed again in the background while the cached keys are still served.
+ * Failed listings aren't cached. */
+
+#include "geanypg.h"
+#include <glib/gstdio.h>
+
+typedef struct
+{
+    gpgme_key_t * key_array;
+    unsigned long nkeys;
+    gpgme_key_t * skey_array;
+    unsigned long nskeys;
+    GHashTable * fpr_index; /* subkey fingerprint -> public key */
+    gchar * stamp;          /* state of the keyring files when listed */
+    gpgme_error_t err;
+} geanypg_keyring;
+
+static GMutex * keyring_mutex = NULL;
+static GCond * keyring_cond = NULL;
+static geanypg_keyring * keyring = NULL;
+static gboolean refresh_running = FALSE;
+static gboolean refresh_again = FALSE;
+static GThread * refresh_thread = NULL;
+static GFileMonitor * keyring_monitor = NULL;
+static guint refresh_source = 0;
+
+/* the keyring files, whose changes make the keys to be listed again */
+static const char * keyring_files[] = { "pubring.gpg", "pubring.kbx", "secring.gpg",
+                                        "private-keys-v1.d", "trustdb.gpg", NULL };
+
+static gchar * geanypg_keyring_home(void)
+{
+    gpgme_engine_info_t info;
+    const gchar * env;
+    if (!gpgme_get_engine_info(&info))
+    {
+        for (; info; info = info->next)
+        {
+            if (info->protocol == GPGME_PROTOCOL_OpenPGP && info->home_dir)
+                return g_strdup(info->home_dir);
+        }
+    }
+    env = g_getenv("GNUPGHOME");
+    if (env && *env)
+        return g_strdup(env);
+    return g_build_filename(g_get_home_dir(), ".gnupg", NULL);
+}
+
+/* describes the keyring files so that changes can be noticed */
+static gchar * geanypg_keyring_stamp(void)
+{
+    const char ** file;
+    gchar * home = geanypg_keyring_home();
+    GString * stamp = g_string_new(NULL);
+    for (file = keyring_files; *file; ++file)
+    {
+        struct stat st;
+        gchar * path = g_build_filename(home, *file, NULL);
+        if (g_stat(path, &st) == 0)
+            g_string_append_printf(stamp, "%s:%ld:%ld;", *file, (long) st.st_mtime, (long) st.st_size);
+        g_free(path);
+    }
+    g_free(home);
+    return g_string_free(stamp, FALSE);
+}
+
+static gpgme_error_t geanypg_list_keys(gpgme_ctx_t ctx, int secret, gpgme_key_t ** array, unsigned long * nkeys)
+{
+    gpgme_error_t err;
+    unsigned long size = SIZE;
+    unsigned long idx = 0;
+    gpgme_key_t * key;
+    *array = (gpgme_key_t*) malloc(size * sizeof(gpgme_key_t));
+    err = gpgme_op_keylist_start(ctx, NULL, secret);
+    while (!err)
+    {
+        key = *array + idx;
+        err = gpgme_op_keylist_next(ctx, key);
+        if (err)
+            break;
+        if ((*key)->revoked  || /* key cannot be used */
+            (*key)->expired  ||
+            (*key)->disabled ||
+            (*key)->invalid)
+           gpgme_key_unref(*key);
+        else /* key is valid */
+            ++idx;
+        if (idx >= size)
+        {
+            size *= 2;
+            *array = (gpgme_key_t*) realloc(*array, size * sizeof(gpgme_key_t));
+        }
+    }
+    *nkeys = idx;
+    return gpg_err_code(err) == GPG_ERR_EOF ? GPG_ERR_NO_ERROR : err;
+}
+
+static void geanypg_keyring_free(geanypg_keyring * kr)
+{
+    encrypt_data ed;
+    if (!kr)
+        return;
+    ed.key_array = kr->key_array;
+    ed.nkeys = kr->nkeys;
+    ed.skey_array = kr->skey_array;
+    ed.nskeys = kr->nskeys;
+    geanypg_release_keys(&ed);
+    g_hash_table_destroy(kr->fpr_index);
+    g_free(kr->stamp);
+    g_free(kr);
+}
+
+static geanypg_keyring * geanypg_keyring_new(void)
+{
+    geanypg_keyring * kr = g_new0(geanypg_keyring, 1);
+    gpgme_ctx_t ctx;
+    unsigned long idx;
+
+    kr->fpr_index = g_hash_table_new(g_str_hash, g_str_equal);
+    /* taken before listing so that changes made meanwhile aren't missed */
+    kr->stamp = geanypg_keyring_stamp();
+    kr->err = gpgme_new(&ctx);
+    if (kr->err)
+        return kr;
+    gpgme_set_protocol(ctx, GPGME_PROTOCOL_OpenPGP);
+    kr->err = geanypg_list_keys(ctx, 0, &kr->key_array, &kr->nkeys);
+    if (!kr->err)
+        kr->err = geanypg_list_keys(ctx, 1, &kr->skey_array, &kr->nskeys);
+    gpgme_release(ctx);
+
+    for (idx = 0; idx < kr->nkeys; ++idx)
+    {
+        gpgme_subkey_t sub;
+        for (sub = kr->key_array[idx]->subkeys; sub; sub = sub->next)
+        {
+            if (sub->fpr)
+                g_hash_table_insert(kr->fpr_index, sub->fpr, kr->key_array[idx]);
+        }
+    }
+    return kr;
+}
+
+/* must be called with keyring_mutex locked */
+static void geanypg_keyring_replace(geanypg_keyring * kr)
+{
+    geanypg_keyring_free(keyring);
+    keyring = kr;
+}
+
+static gpointer geanypg_keyring_worker(gpointer data)
+{
+    gboolean again = TRUE;
+    while (again)
+    {
+        geanypg_keyring * kr = geanypg_keyring_new();
+        g_mutex_lock(keyring_mutex);
+        /* on errors, the keys listed before are kept */
+        if (kr->err)
+            geanypg_keyring_free(kr);
+        else
+            geanypg_keyring_replace(kr);
+        again = refresh_again;
+        refresh_again = FALSE;
+        refresh_running = again;
+        g_cond_broadcast(keyring_cond);
+        g_mutex_unlock(keyring_mutex);
+    }
+    return NULL;
+}
+
+/* lists the keys again in the background */
+static void geanypg_keyring_refresh(void)
+{
+    g_mutex_lock(keyring_mutex);
+    if (refresh_running)
+        refresh_again = TRUE;
+    else
+    {
+        /* the last worker is done, or about to return */
+        if (refresh_thread)
+            g_thread_join(refresh_thread);
+        refresh_thread = g_thread_create(geanypg_keyring_worker, NULL, TRUE, NULL);
+        refresh_running = refresh_thread != NULL;
+    }
+    g_mutex_unlock(keyring_mutex);
+}
+
+static gboolean geanypg_keyring_refresh_timeout(gpointer data)
+{
+    refresh_source = 0;
+    geanypg_keyring_refresh();
+    return FALSE;
+}
+
+static void geanypg_keyring_changed(GFileMonitor * monitor, GFile * file, GFile * other_file,
+                                    GFileMonitorEvent event_type, gpointer user_data)
+{
+    gchar * name = g_file_get_basename(file);
+    const char ** keyring_file = keyring_files;
+
+    /* gpg also writes lock and random seed files, which don't matter */
+    while (*keyring_file && strcmp(name, *keyring_file))
+        ++keyring_file;
+    g_free(name);
+    if (!*keyring_file)
+        return;
+
+    /* gpg usually writes several files, refresh once it's done */
+    if (refresh_source)
+        g_source_remove(refresh_source);
+    refresh_source = g_timeout_add(500, geanypg_keyring_refresh_timeout, NULL);
+}
+
+void geanypg_keyring_init(void)
+{
+    gchar * home = geanypg_keyring_home();
+    GFile * dir = g_file_new_for_path(home);
+
+    keyring_mutex = g_mutex_new();
+    keyring_cond = g_cond_new();
+
+    keyring_monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_NONE, NULL, NULL);
+    if (keyring_monitor)
+        g_signal_connect(keyring_monitor, "changed", G_CALLBACK(geanypg_keyring_changed), NULL);
+    g_object_unref(dir);
+    g_free(home);
+
+    /* have the keys ready when they are first needed */
+    geanypg_keyring_refresh();
+}
+
+void geanypg_keyring_cleanup(void)
+{
+    if (!keyring_mutex)
+        return;
+    if (refresh_source)
+        g_source_remove(refresh_source);
+    refresh_source = 0;
+    if (keyring_monitor)
+    {
+        g_file_monitor_cancel(keyring_monitor);
+        g_object_unref(keyring_monitor);
+        keyring_monitor = NULL;
+    }
+
+    g_mutex_lock(keyring_mutex);
+    refresh_again = FALSE;
+    g_mutex_unlock(keyring_mutex);
+    /* the worker must be gone before the plugin is unloaded */
+    if (refresh_thread)
+        g_thread_join(refresh_thread);
+    refresh_thread = NULL;
+
+    g_mutex_lock(keyring_mutex);
+    geanypg_keyring_replace(NULL);
+    g_mutex_unlock(keyring_mutex);
+
+    g_cond_free(keyring_cond);
+    g_mutex_free(keyring_mutex);
+    keyring_cond = NULL;
+    keyring_mutex = NULL;
+}
+
+static gpgme_key_t * geanypg_copy_keys(gpgme_key_t * array, unsigned long nkeys)
+{
+    unsigned long idx;
+    gpgme_key_t * copy = (gpgme_key_t*) malloc((nkeys + 1) * sizeof(gpgme_key_t));
+    for (idx = 0; idx < nkeys; ++idx)
+    {
+        gpgme_key_ref(array[idx]);
+        copy[idx] = array[idx];
+    }
+    return copy;
+}
+
+/* Nothing is cached until the keys are first listed, so waits for that to
+ * be done if it's running.  Must be called with keyring_mutex locked. */
+static void geanypg_keyring_wait_first(void)
+{
+    while (!keyring && refresh_running)
+        g_cond_wait(keyring_cond, keyring_mutex);
+}
+
+/* Gets the usable public (and/or secret) keys from the cache.  If the keyring
+ * files changed, the cached keys are served while they are listed again in
+ * the background.  They are only listed on the spot if nothing is cached. */
+static gpgme_error_t geanypg_keyring_get(encrypt_data * ed, int public, int secret)
+{
+    gchar * stamp = geanypg_keyring_stamp();
+    gpgme_error_t err = GPG_ERR_NO_ERROR;
+    gboolean changed = FALSE;
+
+    g_mutex_lock(keyring_mutex);
+    geanypg_keyring_wait_first();
+    if (!keyring)
+    {
+        geanypg_keyring * kr;
+        g_mutex_unlock(keyring_mutex);
+        kr = geanypg_keyring_new();
+        g_mutex_lock(keyring_mutex);
+        err = kr->err;
+        /* unless a refresh was quicker */
+        if (!err && !keyring)
+            geanypg_keyring_replace(kr);
+        else
+            geanypg_keyring_free(kr);
+    }
+    if (keyring)
+    {
+        /* unless they are being listed already */
+        changed = !refresh_running && strcmp(keyring->stamp, stamp) != 0;
+        if (public)
+        {
+            ed->key_array = geanypg_copy_keys(keyring->key_array, keyring->nkeys);
+            ed->nkeys = keyring->nkeys;
+        }
+        if (secret)
+        {
+            ed->skey_array = geanypg_copy_keys(keyring->skey_array, keyring->nskeys);
+            ed->nskeys = keyring->nskeys;
+        }
+    }
+    g_mutex_unlock(keyring_mutex);
+    g_free(stamp);
+
+    if (changed)
+        geanypg_keyring_refresh();
+    return err;
+}
+
+int geanypg_get_keys(encrypt_data * ed)
+{
+    gpgme_error_t err = geanypg_keyring_get(ed, 1, 0);
+    if (err)
+    {
+        geanypg_show_err_msg(err);
+        return 0;
+    }
+    return 1;
+}
+
+int geanypg_get_secret_keys(encrypt_data * ed)
+{
+    gpgme_error_t err = geanypg_keyring_get(ed, 0, 1);
+    if (err)
+    {
+        geanypg_show_err_msg(err);
+        return 0;
+    }
+    return 1;
+}
+
+/* Finds the usable public key with a subkey of fingerprint fpr. The returned
+ * key must be released with gpgme_key_unref(). */
+gpgme_key_t geanypg_find_key(const char * fpr)
+{
+    gpgme_key_t key = NULL;
+    g_mutex_lock(keyring_mutex);
+    geanypg_keyring_wait_first();
+    if (keyring)
+        key = g_hash_table_lookup(keyring->fpr_index, fpr);
+    if (key)
+        gpgme_key_ref(key);
+    g_mutex_unlock(keyring_mutex);
+    return key;
+}
@@ -196,7 +196,9 @@ gpgme_error_t geanypg_passphrase_cb(void *hook,
                                     int prev_was_bad ,
                                     int fd)
 {
-    dialogs_show_msgbox(GTK_MESSAGE_ERROR, _("Error, Passphrase input without using gpg-agent is not supported on Windows yet."));
+    /* called from the worker thread, the message is shown once it's done */
+    if (hook)
+        *(const char **) hook = _("Error, Passphrase input without using gpg-agent is not supported on Windows yet.");
     return gpgme_err_make(GPG_ERR_SOURCE_PINENTRY, GPG_ERR_CANCELED);
 }
 #endif
@@ -21,9 +21,14 @@
 
 #include "geanypg.h"
 
+static gpgme_error_t geanypg_sign_op(encrypt_data * ed, gpgme_data_t plain, gpointer user_data)
+{
+    return gpgme_op_sign(ed->ctx, plain, (gpgme_data_t) user_data, GPGME_SIG_MODE_CLEAR);
+}
+
 static void geanypg_sign(encrypt_data * ed)
 {
-    gpgme_data_t plain, cipher;
+    gpgme_data_t cipher;
     gpgme_error_t err;
     FILE * tempfile;
 
@@ -36,12 +41,10 @@ static void geanypg_sign(encrypt_data * ed)
     gpgme_data_new_from_stream(&cipher, tempfile);
     gpgme_data_set_encoding(cipher, GPGME_DATA_ENCODING_ARMOR);
 
-    geanypg_load_buffer(&plain);
-
-    err = gpgme_op_sign(ed->ctx, plain , cipher, GPGME_SIG_MODE_CLEAR);
+    err = geanypg_run_op(ed, geanypg_sign_op, cipher, _("Signing"));
     if (err != GPG_ERR_NO_ERROR && gpgme_err_code(err) != GPG_ERR_CANCELED)
         geanypg_show_err_msg(err);
-    else
+    else if (gpgme_err_code(err) != GPG_ERR_CANCELED)
     {
         rewind(tempfile);
         geanypg_write_file(tempfile);
@@ -49,7 +52,6 @@ static void geanypg_sign(encrypt_data * ed)
 
     fclose(tempfile);
     /* release buffers */
-    gpgme_data_release(plain);
     gpgme_data_release(cipher);
 }
 
@@ -64,7 +66,6 @@ void geanypg_sign_cb(GtkMenuItem * menuitem, gpointer user_data)
     ed.key_array = NULL;
     ed.nkeys = 0;
     /*gpgme_set_armor(ed.ctx, 1);*/
-    gpgme_set_passphrase_cb(ed.ctx, geanypg_passphrase_cb, NULL);
     if (geanypg_get_secret_keys(&ed))
     {
         if (geanypg_sign_selection_dialog(&ed))
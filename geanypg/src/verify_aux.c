@@ -24,38 +24,29 @@
 
 static void geanypg_get_keys_with_fp(encrypt_data * ed, char * buffer)
 {
-    unsigned long idx, found = 0;
     char empty_string = '\0';
-    for (idx = 0; idx < ed->nkeys && ! found; ++idx)
+    gpgme_key_t key = geanypg_find_key(buffer);
+    if (key)
     {
-        gpgme_subkey_t sub = ed->key_array[idx]->subkeys;
-        while (sub && !found)
+        char * name = (key->uids && key->uids->name)
+                       ?
+                       key->uids->name
+                       :
+                       &empty_string;
+        char * email = (key->uids && key->uids->email)
+                        ?
+                        key->uids->email
+                        :
+                        &empty_string;
+        if (strlen(name) + strlen(email) < 500)
+            sprintf(buffer, "%s <%s>", name, email);
+        else
         {
-            if (sub->fpr && !strncmp(sub->fpr, buffer, 40))
-            {
-
-                char * name = (ed->key_array[idx]->uids && ed->key_array[idx]->uids->name)
-                               ?
-                               ed->key_array[idx]->uids->name
-                               :
-                               &empty_string;
-                char * email = (ed->key_array[idx]->uids && ed->key_array[idx]->uids->email)
-                                ?
-                                ed->key_array[idx]->uids->email
-                                :
-                                &empty_string;
-                if (strlen(name) + strlen(email) < 500)
-                    sprintf(buffer, "%s <%s>", name, email);
-                else
-                {
-                    char tmp[62] = {0};
-                    strncpy(tmp, buffer, 41);
-                    sprintf(buffer, "%s %s", _("a key with fingerprint"), tmp);
-                }
-                found = 1;
-            }
-            sub = sub->next;
+            char tmp[62] = {0};
+            strncpy(tmp, buffer, 41);
+            sprintf(buffer, "%s %s", _("a key with fingerprint"), tmp);
         }
+        gpgme_key_unref(key);
     }
 }
 
@@ -38,23 +38,26 @@ static char * geanypg_choose_sig(void)
     return file;
 }
 
+static gpgme_error_t geanypg_verify_op(encrypt_data * ed, gpgme_data_t text, gpointer user_data)
+{
+    return gpgme_op_verify(ed->ctx, (gpgme_data_t) user_data, text, NULL);
+}
+
 static void geanypg_verify(encrypt_data * ed, char * signame)
 {
-    gpgme_data_t sig, text;
+    gpgme_data_t sig;
     gpgme_error_t err;
     FILE * sigfile = fopen(signame, "r");
     gpgme_data_new_from_stream(&sig, sigfile);
-    geanypg_load_buffer(&text);
 
-    err = gpgme_op_verify(ed->ctx, sig, text, NULL);
+    err = geanypg_run_op(ed, geanypg_verify_op, sig, _("Verifying"));
 
-    if (err != GPG_ERR_NO_ERROR)
+    if (err != GPG_ERR_NO_ERROR && gpgme_err_code(err) != GPG_ERR_CANCELED)
         geanypg_show_err_msg(err);
-    else
+    else if (gpgme_err_code(err) != GPG_ERR_CANCELED)
         geanypg_handle_signatures(ed, 1);
 
     gpgme_data_release(sig);
-    gpgme_data_release(text);
     fclose(sigfile);
 }
 
@@ -68,7 +71,6 @@ void geanypg_verify_cb(GtkMenuItem * menuitem, gpointer user_data)
     if (err && geanypg_show_err_msg(err))
         return;
     gpgme_set_protocol(ed.ctx, GPGME_PROTOCOL_OpenPGP);
-    gpgme_set_passphrase_cb(ed.ctx, geanypg_passphrase_cb, NULL);
     if (geanypg_get_keys(&ed) && geanypg_get_secret_keys(&ed))
     {
         sigfile = geanypg_choose_sig();
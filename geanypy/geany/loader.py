@@ -1,10 +1,15 @@
 import os
 import imp
+import json
 from collections import namedtuple
 import geany
 
 PluginInfo = namedtuple('PluginInfo', 'filename, name, version, description, author, cls')
 
+# Name of the file (in the user's plugin dir) remembering plugin metadata
+# so that plugin modules don't need to be imported just to list them.
+CACHE_FILE = '.plugin_cache'
+
 
 class PluginLoader(object):
 
@@ -14,6 +19,10 @@ class PluginLoader(object):
 
 		self.plugin_dirs = plugin_dirs
 
+		self.plugin_classes = {}
+		self.info_cache = self.read_info_cache()
+		self.info_cache_dirty = False
+
 		self.available_plugins = []
 		for plugin in self.iter_plugin_info():
 			self.available_plugins.append(plugin)
@@ -36,6 +45,44 @@ class PluginLoader(object):
 						raise
 
 
+	def get_info_cache_file(self):
+		if self.plugin_dirs:
+			return os.path.join(self.plugin_dirs[-1], CACHE_FILE)
+		return None
+
+
+	def read_info_cache(self):
+		cache_file = self.get_info_cache_file()
+		if cache_file and os.path.exists(cache_file):
+			try:
+				with open(cache_file) as f:
+					cache = json.load(f)
+				if isinstance(cache, dict):
+					return cache
+			except (IOError, ValueError):
+				pass
+		return {}
+
+
+	def write_info_cache(self):
+		cache_file = self.get_info_cache_file()
+		if not self.info_cache_dirty or not cache_file:
+			return
+		# forget about plugin files that went away
+		for filename in list(self.info_cache):
+			if not os.path.exists(filename):
+				del self.info_cache[filename]
+		try:
+			with open(cache_file, 'w') as f:
+				json.dump(self.info_cache, f)
+			self.info_cache_dirty = False
+		except IOError as err:
+			if err.errno == 13: #perms
+				pass
+			else:
+				raise
+
+
 	def restore_loaded_plugins(self):
 		loaded_plugins = []
 		for path in reversed(self.plugin_dirs):
@@ -93,18 +140,45 @@ class PluginLoader(object):
 						#loop around results if its fails to load will never reach yield
 						for p in self.load_plugin_info(d,current_file):
 							yield p
+
+		self.write_info_cache()
 								
 	def load_plugin_info(self,d,f):
 		filename = os.path.abspath(os.path.join(d, f))
 		if filename.endswith("test.py"):
 			pass
-		text = open(filename).read()
+		try:
+			mtime = os.path.getmtime(filename)
+		except OSError:
+			return
+		cached = self.info_cache.get(filename)
+		if not cached or cached.get('mtime') != mtime:
+			infos = self.import_plugin_info(filename)
+			if infos is None:
+				return
+			cached = {'mtime': mtime, 'plugins': []}
+			for inf in infos:
+				cached['plugins'].append([inf.name, inf.version,
+					inf.description, inf.author])
+			self.info_cache[filename] = cached
+			self.info_cache_dirty = True
+		for name, version, description, author in cached['plugins']:
+			yield PluginInfo(filename, name, version, description, author,
+				self.plugin_classes.get((filename, name)))
+
+
+	def import_plugin_info(self, filename):
+		"""
+		Imports the module at `filename` and returns a list of PluginInfo for
+		the plugin classes in it, or None if it could not be imported.
+		"""
+		infos = []
 		module_name = os.path.basename(filename)[:-3]
 		try:
 			module = imp.load_source(module_name, filename)
 		except ImportError as exc:
 			print "Error: failed to import settings module ({})".format(exc)
-			module=None
+			return None
 		if module:	
 			for k, v in module.__dict__.iteritems():
 				if k == geany.Plugin.__name__:
@@ -118,17 +192,35 @@ class PluginLoader(object):
 								getattr(v, '__plugin_description__', ''),
 								getattr(v, '__plugin_author__', ''),
 								v)
-						yield inf
+						self.plugin_classes[(filename, inf.name)] = v
+						infos.append(inf)
 						
 				except TypeError:
 					continue
+		return infos
+
+
+	def get_plugin_class(self, plugin_info):
+		"""
+		Returns the plugin class for `plugin_info`, importing its module
+		first if the info only came from the metadata cache.
+		"""
+		if plugin_info.cls is not None:
+			return plugin_info.cls
+		key = (plugin_info.filename, plugin_info.name)
+		if key not in self.plugin_classes:
+			self.import_plugin_info(plugin_info.filename)
+		return self.plugin_classes.get(key)
 
 
 	def load_plugin(self, filename):
 
 		for avail in self.available_plugins:
 			if avail.filename == filename:
-				inst = avail.cls()
+				cls = self.get_plugin_class(avail)
+				if cls is None:
+					return None
+				inst = cls()
 				self.plugins[filename] = inst
 				self.update_loaded_plugins_file()
 				geany.ui_utils.set_statusbar('GeanyPy: plugin activated: %s' %
@@ -161,7 +253,7 @@ class PluginLoader(object):
 
 		for plugin_info in self.iter_plugin_info():
 			if plugin_info.filename == filename:
-				return hasattr(plugin_info.cls, 'show_help')
+				return hasattr(self.get_plugin_class(plugin_info), 'show_help')
 
 
 	def plugin_has_configure(self, filename):
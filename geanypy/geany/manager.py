@@ -70,7 +70,7 @@ class PluginManager(gtk.Dialog):
 		filename = model.get_value(iter, 2)
 		for plugin in self.loader.available_plugins:
 			if plugin.filename == filename:
-				plugin.cls.show_help()
+				self.loader.get_plugin_class(plugin).show_help()
 				break
 		else:
 			print("Plugin does not support help function")
@@ -10,6 +10,11 @@ import gobject
 class SignalManager(gobject.GObject):
 	"""
 	Manages callback functions for events emitted by Geany's internal GObject.
+
+	The 'editor-notify' signal is detailed, connecting to for example
+	'editor-notify::update-ui' only calls the handler for that kind of
+	notification and lets the C side skip wrapping all the others.
+	Connecting without a detail still receives every notification.
 	"""
 	__gsignals__ = {
 		'build-start':				(gobject.SIGNAL_RUN_LAST, gobject.TYPE_NONE,
@@ -30,7 +35,8 @@ class SignalManager(gobject.GObject):
 										(gobject.TYPE_PYOBJECT,)),
 		'document-save':			(gobject.SIGNAL_RUN_LAST, gobject.TYPE_NONE,
 										(gobject.TYPE_PYOBJECT,)),
-		'editor-notify':			(gobject.SIGNAL_RUN_LAST, gobject.TYPE_BOOLEAN,
+		'editor-notify':			(gobject.SIGNAL_RUN_LAST | gobject.SIGNAL_DETAILED,
+										gobject.TYPE_BOOLEAN,
 										(gobject.TYPE_PYOBJECT, gobject.TYPE_PYOBJECT)),
 		'geany-startup-complete':	(gobject.SIGNAL_RUN_LAST, gobject.TYPE_NONE,
 										()),
@@ -4,6 +4,10 @@
 
 #include "geanypy.h"
 
+#ifndef SCI_GETRANGEPOINTER
+# define SCI_GETRANGEPOINTER 2643
+#endif
+
 
 /* Bail-out when ScintillaObject being wrapped is NULL. */
 #define SCI_RET_IF_FAIL(obj) { \
@@ -171,26 +175,204 @@ Scintilla_get_col_from_position(Scintilla *self, PyObject *args, PyObject *kwarg
 }
 
 
+/* Clamps start/end to the document and returns a pointer to that text
+ * inside Scintilla's own buffer, which stays valid until the next change. */
+static const gchar *
+get_range_pointer(ScintillaObject *sci, gint *start, gint *end)
+{
+	gint len = sci_get_length(sci);
+
+	*start = CLAMP(*start, 0, len);
+	if (*end < 0 || *end > len)
+		*end = len;
+	if (*end < *start)
+		*end = *start;
+
+	return (const gchar *) scintilla_send_message(sci, SCI_GETRANGEPOINTER,
+		(uptr_t) *start, (sptr_t) (*end - *start));
+}
+
+
+/* A read-only buffer over the text of the document inside Scintilla, which is
+ * released as soon as the text changes: reading it afterwards raises an error
+ * rather than reading moved or freed memory. */
+typedef struct
+{
+	PyObject_HEAD
+	ScintillaObject *sci;	/* NULL once released */
+	const gchar *text;
+	Py_ssize_t len;
+	gulong notify_id;
+	gulong destroy_id;
+} ScintillaBuffer;
+
+
+static void
+ScintillaBuffer_release(ScintillaBuffer *self)
+{
+	if (self->sci)
+	{
+		g_signal_handler_disconnect(self->sci, self->notify_id);
+		g_signal_handler_disconnect(self->sci, self->destroy_id);
+		self->sci = NULL;
+		self->text = NULL;
+		self->len = 0;
+	}
+}
+
+
+static void
+on_buffer_sci_notify(ScintillaObject *sci, gint param, SCNotification *nt, gpointer data)
+{
+	if (nt->nmhdr.code == SCN_MODIFIED && (nt->modificationType &
+		(SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT | SC_MOD_BEFOREINSERT | SC_MOD_BEFOREDELETE)))
+	{
+		ScintillaBuffer_release((ScintillaBuffer *) data);
+	}
+}
+
+
+static void
+on_buffer_sci_destroy(GtkWidget *widget, gpointer data)
+{
+	ScintillaBuffer_release((ScintillaBuffer *) data);
+}
+
+
+static void
+ScintillaBuffer_dealloc(ScintillaBuffer *self)
+{
+	ScintillaBuffer_release(self);
+	self->ob_type->tp_free((PyObject *) self);
+}
+
+
+static Py_ssize_t
+ScintillaBuffer_get_read_buffer(ScintillaBuffer *self, Py_ssize_t segment, void **ptr)
+{
+	if (segment != 0)
+	{
+		PyErr_SetString(PyExc_SystemError, "accessing non-existent buffer segment");
+		return -1;
+	}
+	if (!self->sci)
+	{
+		PyErr_SetString(PyExc_ValueError,
+			"buffer released by a change of the document");
+		return -1;
+	}
+	*ptr = (void *) self->text;
+	return self->len;
+}
+
+
+static Py_ssize_t
+ScintillaBuffer_get_seg_count(ScintillaBuffer *self, Py_ssize_t *len)
+{
+	if (len)
+		*len = self->len;
+	return 1;
+}
+
+
+static Py_ssize_t
+ScintillaBuffer_length(ScintillaBuffer *self)
+{
+	void *ptr;
+	return ScintillaBuffer_get_read_buffer(self, 0, &ptr);
+}
+
+
+static PySequenceMethods ScintillaBuffer_as_sequence = {
+	(lenfunc) ScintillaBuffer_length,				/* sq_length */
+};
+
+
+/* no write buffer, the text is read-only */
+static PyBufferProcs ScintillaBuffer_as_buffer = {
+	(readbufferproc) ScintillaBuffer_get_read_buffer,	/* bf_getreadbuffer */
+	0,													/* bf_getwritebuffer */
+	(segcountproc) ScintillaBuffer_get_seg_count,		/* bf_getsegcount */
+	(charbufferproc) ScintillaBuffer_get_read_buffer,	/* bf_getcharbuffer */
+};
+
+
+static PyTypeObject ScintillaBufferType = {
+	PyObject_HEAD_INIT(NULL)
+	0,												/* ob_size */
+	"geany.scintilla.Buffer",						/* tp_name */
+	sizeof(ScintillaBuffer),						/* tp_basicsize */
+	0,												/* tp_itemsize */
+	(destructor) ScintillaBuffer_dealloc,			/* tp_dealloc */
+	0, 0, 0, 0, 0, 0,								/* tp_print - tp_as_number */
+	&ScintillaBuffer_as_sequence,					/* tp_as_sequence */
+	0, 0, 0, 0, 0, 0,								/* tp_as_mapping - tp_setattro */
+	&ScintillaBuffer_as_buffer,						/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,								/* tp_flags */
+	"Read-only buffer over the text of a document, released when the "
+	"document changes.",							/* tp_doc */
+};
+
+
+static PyObject *
+Scintilla_get_buffer(Scintilla *self, PyObject *args, PyObject *kwargs)
+{
+	gint start = 0, end = -1, len;
+	const gchar *text;
+	ScintillaBuffer *buffer;
+	static gchar *kwlist[] = { "start", "end", NULL };
+
+	SCI_RET_IF_FAIL(self);
+
+	if (PyArg_ParseTupleAndKeywords(args, kwargs, "|ii", kwlist, &start, &end))
+	{
+		len = sci_get_length(self->sci);
+		start = CLAMP(start, 0, len);
+		if (end < 0 || end > len)
+			end = len;
+		if (end < start)
+			end = start;
+		/* unlike a range pointer, the character pointer moves the gap to the
+		 * end, so reading other ranges doesn't move the text until it changes */
+		text = (const gchar *) scintilla_send_message(self->sci, SCI_GETCHARACTERPOINTER, 0, 0);
+		if (text == NULL)
+			Py_RETURN_NONE;
+
+		buffer = PyObject_New(ScintillaBuffer, &ScintillaBufferType);
+		if (buffer == NULL)
+			return NULL;
+		buffer->sci = self->sci;
+		buffer->text = text + start;
+		buffer->len = end - start;
+		buffer->notify_id = g_signal_connect(self->sci, "sci-notify",
+			G_CALLBACK(on_buffer_sci_notify), buffer);
+		buffer->destroy_id = g_signal_connect(self->sci, "destroy",
+			G_CALLBACK(on_buffer_sci_destroy), buffer);
+		return (PyObject *) buffer;
+	}
+
+	Py_RETURN_NONE;
+}
+
+
 static PyObject *
 Scintilla_get_contents(Scintilla *self, PyObject *args, PyObject *kwargs)
 {
-	gint len = -1;
-	gchar *text;
-	PyObject *py_text;
+	gint start = 0, len = -1;
+	const gchar *text;
 	static gchar *kwlist[] = { "len", NULL };
 
 	SCI_RET_IF_FAIL(self);
 
 	if (PyArg_ParseTupleAndKeywords(args, kwargs, "|i", kwlist, &len))
 	{
-		if (len == -1)
-			len = sci_get_length(self->sci) + 1;
-		text = sci_get_contents(self->sci, len);
+		/* like sci_get_contents(), len includes the terminating NUL */
+		if (len != -1)
+			len = MAX(len - 1, 0);
+		text = get_range_pointer(self->sci, &start, &len);
 		if (text == NULL)
 			Py_RETURN_NONE;
-		py_text = PyString_FromString(text);
-		g_free(text);
-		return py_text;
+		return PyString_FromStringAndSize(text, len);
 	}
 
 	Py_RETURN_NONE;
@@ -201,24 +383,17 @@ static PyObject *
 Scintilla_get_contents_range(Scintilla *self, PyObject *args, PyObject *kwargs)
 {
 	gint start = -1, end = -1;
-	gchar *text;
-	PyObject *py_text;
+	const gchar *text;
 	static gchar *kwlist[] = { "start", "end", NULL };
 
 	SCI_RET_IF_FAIL(self);
 
 	if (PyArg_ParseTupleAndKeywords(args, kwargs, "|ii", kwlist, &start, &end))
 	{
-		if (start == -1)
-			start = 0;
-		if (end == -1)
-			end = sci_get_length(self->sci) + 1;
-		text = sci_get_contents_range(self->sci, start, end);
+		text = get_range_pointer(self->sci, &start, &end);
 		if (text == NULL)
 			Py_RETURN_NONE;
-		py_text = PyString_FromString(text);
-		g_free(text);
-		return py_text;
+		return PyString_FromStringAndSize(text, end - start);
 	}
 
 	Py_RETURN_NONE;
@@ -598,6 +773,91 @@ Scintilla_is_marker_set_at_line(Scintilla *self, PyObject *args, PyObject *kwarg
 }
 
 
+typedef struct
+{
+	gint start;
+	gint end;
+	const gchar *text;
+	gint len;
+}
+RangeEdit;
+
+
+static gint
+compare_range_edits(gconstpointer a, gconstpointer b)
+{
+	/* sort descending so earlier edits don't move later ones */
+	return ((const RangeEdit *) b)->start - ((const RangeEdit *) a)->start;
+}
+
+
+static PyObject *
+Scintilla_replace_ranges(Scintilla *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *py_edits, *seq;
+	RangeEdit *edits;
+	Py_ssize_t i, n;
+	gint doc_len;
+	static gchar *kwlist[] = { "edits", NULL };
+
+	SCI_RET_IF_FAIL(self);
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", kwlist, &py_edits))
+		return NULL;
+
+	seq = PySequence_Fast(py_edits, "edits must be a sequence of (start, end, text) tuples");
+	if (seq == NULL)
+		return NULL;
+
+	n = PySequence_Fast_GET_SIZE(seq);
+	edits = g_new(RangeEdit, n);
+	doc_len = sci_get_length(self->sci);
+	for (i = 0; i < n; i++)
+	{
+		RangeEdit *e = &edits[i];
+		if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, i), "iis#",
+				&e->start, &e->end, &e->text, &e->len))
+			goto fail;
+		if (e->start < 0 || e->end < e->start || e->end > doc_len)
+		{
+			PyErr_Format(PyExc_ValueError, "invalid range %d-%d", e->start, e->end);
+			goto fail;
+		}
+	}
+
+	qsort(edits, n, sizeof(RangeEdit), compare_range_edits);
+	for (i = 1; i < n; i++)
+	{
+		if (edits[i].end > edits[i - 1].start)
+		{
+			PyErr_Format(PyExc_ValueError, "ranges %d-%d and %d-%d overlap",
+				edits[i].start, edits[i].end, edits[i - 1].start, edits[i - 1].end);
+			goto fail;
+		}
+	}
+
+	scintilla_send_message(self->sci, SCI_SETREDRAW, FALSE, 0);
+	sci_start_undo_action(self->sci);
+	for (i = 0; i < n; i++)
+	{
+		scintilla_send_message(self->sci, SCI_SETTARGETSTART, edits[i].start, 0);
+		scintilla_send_message(self->sci, SCI_SETTARGETEND, edits[i].end, 0);
+		scintilla_send_message(self->sci, SCI_REPLACETARGET, edits[i].len, (sptr_t) edits[i].text);
+	}
+	sci_end_undo_action(self->sci);
+	scintilla_send_message(self->sci, SCI_SETREDRAW, TRUE, 0);
+
+	g_free(edits);
+	Py_DECREF(seq);
+	Py_RETURN_NONE;
+
+fail:
+	g_free(edits);
+	Py_DECREF(seq);
+	return NULL;
+}
+
+
 static PyObject *
 Scintilla_replace_sel(Scintilla *self, PyObject *args, PyObject *kwargs)
 {
@@ -799,6 +1059,11 @@ static PyMethodDef Scintilla_methods[] = {
 	{ "get_col_from_position", (PyCFunction) Scintilla_get_col_from_position, METH_KEYWORDS,
 		"Gets the column number relative to the start of the line that "
 		"pos is on." },
+	{ "get_buffer", (PyCFunction) Scintilla_get_buffer, METH_KEYWORDS,
+		"Gets a read-only buffer over the text between start and end, "
+		"taken straight from the document without copying it.  The buffer "
+		"is released when the document changes, reading it afterwards "
+		"raises ValueError." },
 	{ "get_contents", (PyCFunction) Scintilla_get_contents, METH_KEYWORDS,
 		"Gets all text inside a given text length." },
 	{ "get_contents_range", (PyCFunction) Scintilla_get_contents_range, METH_KEYWORDS,
@@ -851,6 +1116,9 @@ static PyMethodDef Scintilla_methods[] = {
 		"Inserts text at pos." },
 	{ "is_marker_set_at_line", (PyCFunction) Scintilla_is_marker_set_at_line, METH_KEYWORDS,
 		"Checks if a line has a marker set." },
+	{ "replace_ranges", (PyCFunction) Scintilla_replace_ranges, METH_KEYWORDS,
+		"Replaces several non-overlapping (start, end, text) ranges as a "
+		"single undo action." },
 	{ "replace_sel", (PyCFunction) Scintilla_replace_sel, METH_KEYWORDS,
 		"Replaces selection." },
 	{ "scroll_caret", (PyCFunction) Scintilla_scroll_caret, METH_NOARGS,
@@ -907,7 +1175,40 @@ static PyTypeObject ScintillaType = {
 	0, 0,											/* tp_alloc - tp_new */
 };
 
-static PyMethodDef ScintillaModule_methods[] = { { NULL } };
+
+static PyObject *
+Scintilla_watch_modifications(PyObject *module, PyObject *args, PyObject *kwargs)
+{
+	gint mask;
+	static gchar *kwlist[] = { "mask", NULL };
+
+	if (PyArg_ParseTupleAndKeywords(args, kwargs, "i", kwlist, &mask))
+		signal_manager_watch_modifications(mask);
+	Py_RETURN_NONE;
+}
+
+
+static PyObject *
+Scintilla_unwatch_modifications(PyObject *module, PyObject *args, PyObject *kwargs)
+{
+	gint mask;
+	static gchar *kwlist[] = { "mask", NULL };
+
+	if (PyArg_ParseTupleAndKeywords(args, kwargs, "i", kwlist, &mask))
+		signal_manager_unwatch_modifications(mask);
+	Py_RETURN_NONE;
+}
+
+
+static PyMethodDef ScintillaModule_methods[] = {
+	{ "watch_modifications", (PyCFunction) Scintilla_watch_modifications, METH_KEYWORDS,
+		"Requests 'editor-notify::modified' notifications for the given "
+		"MOD_* flags.  Once any flags are watched, modifications matching "
+		"none of them are not passed to detailed handlers." },
+	{ "unwatch_modifications", (PyCFunction) Scintilla_unwatch_modifications, METH_KEYWORDS,
+		"Releases flags previously passed to watch_modifications()." },
+	{ NULL }
+};
 
 
 PyMODINIT_FUNC initscintilla(void)
@@ -918,6 +1219,9 @@ PyMODINIT_FUNC initscintilla(void)
 	if (PyType_Ready(&ScintillaType) < 0)
 		return;
 
+	if (PyType_Ready(&ScintillaBufferType) < 0)
+		return;
+
 	NotificationType.tp_new = PyType_GenericNew;
 	if (PyType_Ready(&NotificationType) < 0)
 		return;
@@ -931,6 +1235,9 @@ PyMODINIT_FUNC initscintilla(void)
 	Py_INCREF(&ScintillaType);
 	PyModule_AddObject(m, "Scintilla", (PyObject *)&ScintillaType);
 
+	Py_INCREF(&ScintillaBufferType);
+	PyModule_AddObject(m, "Buffer", (PyObject *)&ScintillaBufferType);
+
 	Py_INCREF(&NotificationType);
 	PyModule_AddObject(m, "Notification", (PyObject *)&NotificationType);
 
@@ -9,9 +9,57 @@ struct _SignalManager
 	GeanyPlugin *geany_plugin;
 	PyObject *py_obj;
 	GObject *obj;
+	guint editor_notify_id;
+	GHashTable *notify_details;
+	Editor *editor_pool;
+	Notification *notif_pool;
 };
 
 
+/* Detail names for the 'editor-notify' signal, so Python code can connect
+ * to e.g. 'editor-notify::update-ui' and only be called for those. */
+static const struct
+{
+	gint code;
+	const gchar *detail;
+}
+notify_details[] = {
+	{ SCN_STYLENEEDED, "style-needed" },
+	{ SCN_CHARADDED, "char-added" },
+	{ SCN_SAVEPOINTREACHED, "save-point-reached" },
+	{ SCN_SAVEPOINTLEFT, "save-point-left" },
+	{ SCN_MODIFYATTEMPTRO, "modify-attempt-ro" },
+	{ SCN_KEY, "key" },
+	{ SCN_DOUBLECLICK, "double-click" },
+	{ SCN_UPDATEUI, "update-ui" },
+	{ SCN_MODIFIED, "modified" },
+	{ SCN_MACRORECORD, "macro-record" },
+	{ SCN_MARGINCLICK, "margin-click" },
+	{ SCN_NEEDSHOWN, "need-shown" },
+	{ SCN_PAINTED, "painted" },
+	{ SCN_USERLISTSELECTION, "user-list-selection" },
+	{ SCN_URIDROPPED, "uri-dropped" },
+	{ SCN_DWELLSTART, "dwell-start" },
+	{ SCN_DWELLEND, "dwell-end" },
+	{ SCN_ZOOM, "zoom" },
+	{ SCN_HOTSPOTCLICK, "hot-spot-click" },
+	{ SCN_HOTSPOTDOUBLECLICK, "hot-spot-double-click" },
+	{ SCN_CALLTIPCLICK, "call-tip-click" },
+	{ SCN_AUTOCSELECTION, "auto-c-selection" },
+	{ SCN_INDICATORCLICK, "indicator-click" },
+	{ SCN_INDICATORRELEASE, "indicator-release" },
+	{ SCN_AUTOCCANCELLED, "autoc-cancelled" },
+	{ SCN_AUTOCCHARDELETED, "autoc-char-deleted" },
+	{ SCN_HOTSPOTRELEASECLICK, "hot-spot-release-click" }
+};
+
+
+/* Reference counts for each SC_MOD_* bit that somebody asked for, and the
+ * union of them, used to drop uninteresting SCN_MODIFIED notifications. */
+static guint modification_refs[32];
+static gint modification_mask = 0;
+
+
 static void signal_manager_connect_signals(SignalManager *man);
 
 static void on_build_start(GObject *geany_object, SignalManager *man);
@@ -38,6 +86,7 @@ SignalManager *signal_manager_new(GeanyPlugin *geany_plugin)
 {
 	SignalManager *man;
 	PyObject *module;
+	guint i;
 
 	man = g_new0(SignalManager, 1);
 
@@ -67,6 +116,14 @@ SignalManager *signal_manager_new(GeanyPlugin *geany_plugin)
 	}
 	man->obj = pygobject_get(man->py_obj);
 
+	man->editor_notify_id = g_signal_lookup("editor-notify", G_OBJECT_TYPE(man->obj));
+	man->notify_details = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (i = 0; i < G_N_ELEMENTS(notify_details); i++)
+	{
+		g_hash_table_insert(man->notify_details, GINT_TO_POINTER(notify_details[i].code),
+			GUINT_TO_POINTER(g_quark_from_static_string(notify_details[i].detail)));
+	}
+
 	signal_manager_connect_signals(man);
 
 	return man;
@@ -76,6 +133,10 @@ SignalManager *signal_manager_new(GeanyPlugin *geany_plugin)
 void signal_manager_free(SignalManager *man)
 {
 	g_return_if_fail(man != NULL);
+	Py_XDECREF(man->editor_pool);
+	Py_XDECREF(man->notif_pool);
+	if (man->notify_details)
+		g_hash_table_destroy(man->notify_details);
 	Py_XDECREF(man->py_obj);
 	g_free(man);
 }
@@ -86,6 +147,36 @@ GObject *signal_manager_get_gobject(SignalManager *signal_manager)
 }
 
 
+void signal_manager_watch_modifications(gint mask)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(modification_refs); i++)
+	{
+		if (mask & (1 << i))
+		{
+			modification_refs[i]++;
+			modification_mask |= (1 << i);
+		}
+	}
+}
+
+
+void signal_manager_unwatch_modifications(gint mask)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(modification_refs); i++)
+	{
+		if ((mask & (1 << i)) && modification_refs[i] > 0)
+		{
+			if (--modification_refs[i] == 0)
+				modification_mask &= ~(1 << i);
+		}
+	}
+}
+
+
 static void signal_manager_connect_signals(SignalManager *man)
 {
 	plugin_signal_connect(geany_plugin, NULL, "build-start", TRUE, G_CALLBACK(on_build_start), man);
@@ -175,13 +266,67 @@ static void on_document_save(GObject *geany_object, GeanyDocument *doc, SignalMa
 }
 
 
+/* The wrappers passed to 'editor-notify' handlers are reused for the next
+ * notification as long as no Python code kept a reference to them. */
+static PyObject *get_editor_wrapper(SignalManager *man, GeanyEditor *editor)
+{
+	if (man->editor_pool == NULL || Py_REFCNT(man->editor_pool) > 1)
+	{
+		Py_XDECREF(man->editor_pool);
+		man->editor_pool = Editor_create_new_from_geany_editor(editor);
+		if (man->editor_pool == NULL)
+			return NULL;
+	}
+	man->editor_pool->editor = editor;
+	Py_INCREF(man->editor_pool);
+	return (PyObject *) man->editor_pool;
+}
+
+
+static PyObject *get_notification_wrapper(SignalManager *man, SCNotification *nt)
+{
+	Notification *notif = man->notif_pool;
+
+	if (notif == NULL || Py_REFCNT(notif) > 1 ||
+		(notif->hdr != NULL && Py_REFCNT(notif->hdr) > 1))
+	{
+		Py_XDECREF(man->notif_pool);
+		man->notif_pool = Notification_create_new_from_scintilla_notification(nt);
+		if (man->notif_pool == NULL)
+			return NULL;
+		notif = man->notif_pool;
+	}
+	notif->notif = nt;
+	if (notif->hdr != NULL)
+		notif->hdr->notif = nt;
+	Py_INCREF(notif);
+	return (PyObject *) notif;
+}
+
+
 static gboolean on_editor_notify(GObject *geany_object, GeanyEditor *editor, SCNotification *nt, SignalManager *man)
 {
 	gboolean res = FALSE;
 	PyObject *py_ed, *py_notif;
-	py_ed = (PyObject *) Editor_create_new_from_geany_editor(editor);
-	py_notif = (PyObject *) Notification_create_new_from_scintilla_notification(nt);
-	g_signal_emit_by_name(man->obj, "editor-notify", py_ed, py_notif, &res);
+	GQuark detail;
+
+	detail = GPOINTER_TO_UINT(g_hash_table_lookup(man->notify_details, GINT_TO_POINTER(nt->nmhdr.code)));
+
+	/* Handlers connected without a detail get every notification, otherwise
+	 * only wrap and emit when somebody asked for this one. */
+	if (!g_signal_has_handler_pending(man->obj, man->editor_notify_id, 0, FALSE))
+	{
+		if (detail == 0 ||
+			!g_signal_has_handler_pending(man->obj, man->editor_notify_id, detail, FALSE))
+			return FALSE;
+		if (nt->nmhdr.code == SCN_MODIFIED && modification_mask != 0 &&
+			!(nt->modificationType & modification_mask))
+			return FALSE;
+	}
+
+	py_ed = get_editor_wrapper(man, editor);
+	py_notif = get_notification_wrapper(man, nt);
+	g_signal_emit(man->obj, man->editor_notify_id, detail, py_ed, py_notif, &res);
 	Py_XDECREF(py_ed);
 	Py_XDECREF(py_notif);
 	return res;
@@ -6,5 +6,7 @@ typedef struct _SignalManager SignalManager;
 SignalManager *signal_manager_new(GeanyPlugin *geany_plugin);
 void signal_manager_free(SignalManager *signal_manager);
 GObject *signal_manager_get_gobject(SignalManager *signal_manager);
+void signal_manager_watch_modifications(gint mask);
+void signal_manager_unwatch_modifications(gint mask);
 
 #endif /* SIGNALMANAGER_H */
@@ -27,6 +27,7 @@ namespace MultiTerm
 	{
 		public signal void new_shell_activate(ShellConfig sh);
 		public signal void new_window_activate();
+		public signal void search_activate();
 		public signal void copy_activate();
 		public signal void paste_activate();
 		public signal void show_tabs_activate(bool show_tabs);
@@ -98,6 +99,11 @@ namespace MultiTerm
 			this.append(item);
 			item.show();
 
+			item = new Gtk.MenuItem.with_label("Search Output");
+			item.activate.connect(() => search_activate());
+			this.append(item);
+			item.show();
+
 			add_separator();
 
 			item = new Gtk.MenuItem.with_label("Next tab");
@@ -140,6 +140,10 @@ font=Monospace 9
 # The number of lines to keep in the scrollback buffer
 #scrollback_lines=512
 
+# The number of output lines to keep for searching, independently of
+# the scrollback buffer, or 0 to disable searching the output
+#capture_lines=100000
+
 # Whether the terminal will present a visible bell when the child
 # sends a bell sequence.  The terminal will clear itself to the
 # default foreground color and then repaint itself.
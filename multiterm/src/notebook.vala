@@ -92,6 +92,13 @@ namespace MultiTerm
 			}
 		}
 
+		private void on_search_activate()
+		{
+			Terminal? term = this.get_nth_page(this.get_current_page()) as Terminal;
+			if (term != null)
+				term.show_search();
+		}
+
 		private void on_move_to_location(string location)
 		{
 			Container frame = this.get_parent() as Container;
@@ -147,6 +154,7 @@ namespace MultiTerm
 				context_menu.previous_tab_activate.connect(on_previous_tab_activate);
 				context_menu.new_shell_activate.connect(on_new_shell_activate);
 				context_menu.new_window_activate.connect(on_new_window_activate);
+				context_menu.search_activate.connect(on_search_activate);
 				context_menu.move_to_location_activate.connect(on_move_to_location);
 			}
 			context_menu.popup(null, null, null, event.button, event.time);
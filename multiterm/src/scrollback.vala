@@ -0,0 +1,401 @@
+/*
+ * scrollback.vala - This file is part of the Geany MultiTerm plugin
+ *
+ * Copyright (c) 2012 Matthew Brush <matt@geany.org>.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+namespace MultiTerm
+{
+	/* The numbers of the lines containing a word, in increasing order.
+	 * Lines dropped from the scrollback are removed from the front. */
+	class Postings
+	{
+		public uint[] lines = new uint[0];
+		public int start = 0;
+
+		public int length { get { return lines.length - start; } }
+
+		public void drop_first()
+		{
+			start++;
+			/* compact once most of the array is dropped lines */
+			if (start > 32 && start > lines.length / 2)
+			{
+				lines = lines[start:lines.length];
+				start = 0;
+			}
+		}
+	}
+
+	/*
+	 * A bounded ring buffer of the lines output in a terminal, along with
+	 * an index of the words they contain so that searching them doesn't
+	 * need to look at every line.  Lines are numbered from 0 as they are
+	 * added, the oldest ones are dropped once max_lines are kept.
+	 *
+	 * The words are themselves indexed by the pairs of characters they
+	 * contain, so a part of a word is only looked for in the words
+	 * containing its rarest pair rather than in the whole vocabulary.
+	 * Queries need at least one token of MIN_QUERY_LENGTH characters.
+	 */
+	public class ScrollbackIndex
+	{
+		public const int MIN_QUERY_LENGTH = 2;
+		private const int GRAM_LENGTH = 2;
+
+		private string[] lines;
+		private long[] rows;
+		private uint first_line = 0;
+		private uint end_line = 0;
+		private HashTable<string, Postings> words;
+		private HashTable<string, HashTable<string, Postings>> grams;
+
+		public ScrollbackIndex(int max_lines)
+		{
+			lines = new string[int.max(max_lines, 1)];
+			rows = new long[lines.length];
+			words = new HashTable<string, Postings>(str_hash, str_equal);
+			grams = new HashTable<string, HashTable<string, Postings>>(str_hash, str_equal);
+		}
+
+		/* Number of the oldest line kept */
+		public uint first { get { return first_line; } }
+
+		/* Number of the next line to be added */
+		public uint end { get { return end_line; } }
+
+		private static bool is_word_char(char c)
+		{
+			return c.isalnum() || c == '_' || (uchar) c >= 0x80;
+		}
+
+		/* Calls func for each distinct word (lower case) of text.  Single
+		 * characters aren't words, they would match nearly every line. */
+		private static void foreach_word(string text, Func<string> func)
+		{
+			string lower = text.down();
+			HashTable<string, bool> seen = new HashTable<string, bool>(str_hash, str_equal);
+			int i = 0;
+
+			while (i < lower.length)
+			{
+				int start;
+
+				while (i < lower.length && !is_word_char(lower[i]))
+					i++;
+				start = i;
+				while (i < lower.length && is_word_char(lower[i]))
+					i++;
+				if (i - start > 1)
+				{
+					string word = lower.substring(start, i - start);
+					if (!seen.contains(word))
+					{
+						seen.insert(word, true);
+						func(word);
+					}
+				}
+			}
+		}
+
+		/* Calls func for each distinct pair of characters (bytes) of word */
+		private static void foreach_gram(string word, Func<string> func)
+		{
+			HashTable<string, bool> seen = new HashTable<string, bool>(str_hash, str_equal);
+
+			for (int i = 0; i + GRAM_LENGTH <= word.length; i++)
+			{
+				string gram = word.substring(i, GRAM_LENGTH);
+				if (!seen.contains(gram))
+				{
+					seen.insert(gram, true);
+					func(gram);
+				}
+			}
+		}
+
+		private void add_word(string word, Postings postings)
+		{
+			words.insert(word, postings);
+			foreach_gram(word, (gram) => {
+				HashTable<string, Postings>? gram_words = grams.lookup(gram);
+				if (gram_words == null)
+				{
+					gram_words = new HashTable<string, Postings>(str_hash, str_equal);
+					grams.insert(gram, gram_words);
+				}
+				gram_words.insert(word, postings);
+			});
+		}
+
+		private void remove_word(string word)
+		{
+			foreach_gram(word, (gram) => {
+				HashTable<string, Postings>? gram_words = grams.lookup(gram);
+				if (gram_words != null)
+				{
+					gram_words.remove(word);
+					if (gram_words.size() == 0)
+						grams.remove(gram);
+				}
+			});
+			words.remove(word);
+		}
+
+		private void drop_first_line()
+		{
+			uint line = first_line;
+			string text = lines[line % lines.length];
+
+			foreach_word(text, (word) => {
+				Postings? postings = words.lookup(word);
+				if (postings != null && postings.length > 0 &&
+					postings.lines[postings.start] == line)
+				{
+					postings.drop_first();
+					if (postings.length == 0)
+						remove_word(word);
+				}
+			});
+			lines[line % lines.length] = null;
+			first_line++;
+		}
+
+		/* Adds a line, row being the terminal row it was read from */
+		public void append(string text, long row)
+		{
+			uint line = end_line;
+
+			if (end_line - first_line == lines.length)
+				drop_first_line();
+
+			lines[line % lines.length] = text;
+			rows[line % lines.length] = row;
+			end_line++;
+
+			foreach_word(text, (word) => {
+				Postings? postings = words.lookup(word);
+				if (postings == null)
+				{
+					postings = new Postings();
+					add_word(word, postings);
+				}
+				postings.lines += line;
+			});
+		}
+
+		public string? get_line(uint line)
+		{
+			if (line < first_line || line >= end_line)
+				return null;
+			return lines[line % lines.length];
+		}
+
+		/* The terminal row the line was read from */
+		public long get_row(uint line)
+		{
+			return rows[line % lines.length];
+		}
+
+		/* The lines which may contain token.  A token bounded by non-word
+		 * characters in the query is a whole word and is looked up directly,
+		 * otherwise it may be a part of any word containing it, which are
+		 * looked for among the words containing its rarest pair. */
+		private uint[] get_candidates(string token, bool whole_word)
+		{
+			if (whole_word)
+			{
+				Postings? postings = words.lookup(token);
+				if (postings == null)
+					return new uint[0];
+				return postings.lines[postings.start:postings.lines.length];
+			}
+
+			HashTable<string, Postings>? gram_words = null;
+			for (int i = 0; i + GRAM_LENGTH <= token.length; i++)
+			{
+				HashTable<string, Postings>? found = grams.lookup(token.substring(i, GRAM_LENGTH));
+				if (found == null)
+					return new uint[0];
+				if (gram_words == null || found.size() < gram_words.size())
+					gram_words = found;
+			}
+
+			Postings[] lists = {};
+			HashTableIter<string, Postings> iter = HashTableIter<string, Postings>(gram_words);
+			unowned string word;
+			unowned Postings postings;
+
+			while (iter.next(out word, out postings))
+			{
+				if (word.contains(token))
+					lists += postings;
+			}
+			return merge(lists);
+		}
+
+		/* Merges lists of lines in increasing order.  A heap of the lists
+		 * ordered by their next line gives the next line of the result, so
+		 * merging k lists of n lines in total takes O(n log k). */
+		private static uint[] merge(Postings[] lists)
+		{
+			int[] heap = new int[lists.length];
+			int[] pos = new int[lists.length];
+			int size = 0, total = 0, n = 0;
+
+			for (int i = 0; i < lists.length; i++)
+			{
+				pos[i] = lists[i].start;
+				total += lists[i].length;
+				if (lists[i].length > 0)
+					heap[size++] = i;
+			}
+			for (int i = size / 2 - 1; i >= 0; i--)
+				sift_down(lists, pos, heap, size, i);
+
+			uint[] merged = new uint[total];
+			while (size > 0)
+			{
+				int top = heap[0];
+				uint line = lists[top].lines[pos[top]++];
+
+				/* lines containing several matching words appear once */
+				if (n == 0 || merged[n - 1] != line)
+					merged[n++] = line;
+				if (pos[top] == lists[top].lines.length)
+					heap[0] = heap[--size];
+				sift_down(lists, pos, heap, size, 0);
+			}
+			merged.resize(n);
+			return merged;
+		}
+
+		/* Moves the list at i of the heap down to its place */
+		private static void sift_down(Postings[] lists, int[] pos, int[] heap, int size, int i)
+		{
+			while (true)
+			{
+				int least = i;
+
+				for (int child = 2 * i + 1; child <= 2 * i + 2 && child < size; child++)
+				{
+					if (lists[heap[child]].lines[pos[heap[child]]] <
+						lists[heap[least]].lines[pos[heap[least]]])
+						least = child;
+				}
+				if (least == i)
+					return;
+
+				int tmp = heap[i];
+				heap[i] = heap[least];
+				heap[least] = tmp;
+				i = least;
+			}
+		}
+
+		private bool line_matches(uint line, string lower_text)
+		{
+			return lines[line % lines.length].down().contains(lower_text);
+		}
+
+		/* The longest word of the lower case query, by which the lines are
+		 * looked up, or null if it has no word of MIN_QUERY_LENGTH characters
+		 * (looking for shorter ones would mean checking every line) */
+		private static string? get_query_token(string lower, out bool whole_word)
+		{
+			string? token = null;
+			int i = 0;
+
+			whole_word = false;
+			while (i < lower.length)
+			{
+				int start;
+
+				while (i < lower.length && !is_word_char(lower[i]))
+					i++;
+				start = i;
+				while (i < lower.length && is_word_char(lower[i]))
+					i++;
+				if (i - start >= MIN_QUERY_LENGTH && (token == null || i - start > token.length))
+				{
+					token = lower.substring(start, i - start);
+					whole_word = start > 0 && i < lower.length;
+				}
+			}
+			return token;
+		}
+
+		/* Whether text is long enough to be searched for */
+		public static bool is_searchable(string text)
+		{
+			bool whole_word;
+			return get_query_token(text.down(), out whole_word) != null;
+		}
+
+		/*
+		 * Finds the closest line containing text (ignoring case) starting
+		 * from line from, towards the older lines if backwards is true.
+		 * Returns the line number, or -1 if no line matches or text isn't
+		 * searchable.
+		 */
+		public int64 find(string text, int64 from, bool backwards)
+		{
+			string lower = text.down();
+			bool best_whole;
+			string? best_token = get_query_token(lower, out best_whole);
+
+			if (best_token == null || first_line == end_line)
+				return -1;
+
+			from = int64.max(int64.min(from, (int64) end_line - 1), (int64) first_line);
+
+			uint[] candidates = get_candidates(best_token, best_whole);
+			int lo = 0, hi = candidates.length;
+
+			/* first candidate not before from */
+			while (lo < hi)
+			{
+				int mid = (lo + hi) / 2;
+				if (candidates[mid] < from)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+
+			if (backwards)
+			{
+				if (lo < candidates.length && candidates[lo] == from)
+					lo++;
+				for (int j = lo - 1; j >= 0; j--)
+				{
+					if (candidates[j] >= first_line && line_matches(candidates[j], lower))
+						return candidates[j];
+				}
+			}
+			else
+			{
+				for (int j = lo; j < candidates.length; j++)
+				{
+					if (candidates[j] >= first_line && line_matches(candidates[j], lower))
+						return candidates[j];
+				}
+			}
+			return -1;
+		}
+	}
+}
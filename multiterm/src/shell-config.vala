@@ -320,6 +320,20 @@ namespace MultiTerm
 			}
 		}
 
+		public int capture_lines
+		{
+			get
+			{
+				try { return kf.get_integer(_section, "capture_lines"); }
+				catch (KeyFileError err) { return 100000; }
+			}
+			set
+			{
+				kf.set_integer(_section, "capture_lines", value);
+				cfg.store_eventually();
+			}
+		}
+
 		public bool visible_bell
 		{
 			get
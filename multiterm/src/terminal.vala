@@ -29,6 +29,13 @@ namespace MultiTerm
 	{
 		public Vte.Terminal terminal;
 		private ShellConfig sh;
+		private bool started = false;
+		private ScrollbackIndex? scrollback = null;
+		private long captured_row = 0;
+		private HBox search_bar;
+		private Entry search_entry;
+		private Label search_label;
+		private int64 search_line = -1;
 
 		public signal bool right_click_event(EventButton event);
 
@@ -89,6 +96,22 @@ namespace MultiTerm
 			}
 		}
 
+		/* Spawns the shell, if it isn't already running.  Shells are only
+		 * spawned when their tab is first shown so that tabs which are never
+		 * used don't cost anything. */
+		public void start()
+		{
+			if (started)
+				return;
+			started = true;
+			run_command(this.sh.command);
+		}
+
+		private void on_vte_map()
+		{
+			start();
+		}
+
 		private void on_vte_realize()
 		{
 			if (sh.cfg != null)
@@ -119,8 +142,138 @@ namespace MultiTerm
 			return false;
 		}
 
+		/* Captures the lines completed since the last time for searching */
+		private void on_contents_changed()
+		{
+			long col, row;
+
+			terminal.get_cursor_position(out col, out row);
+
+			/* the terminal was reset */
+			if (row < captured_row)
+				captured_row = row;
+			/* rows which scrolled out of the terminal are lost */
+			captured_row = long.max(captured_row, (long) terminal.get_adjustment().lower);
+
+			/* the rows above the cursor are complete */
+			for (; captured_row < row; captured_row++)
+			{
+				string text = terminal.get_text_range(captured_row, 0, captured_row,
+					terminal.get_column_count() - 1, null, null);
+				scrollback.append(text.chomp(), captured_row);
+			}
+		}
+
+		public void show_search()
+		{
+			if (scrollback == null)
+				search_label.set_text("Searching is disabled (capture_lines=0)");
+			search_bar.show();
+			search_entry.grab_focus();
+		}
+
+		private void hide_search()
+		{
+			search_bar.hide();
+			terminal.grab_focus();
+		}
+
+		/* Searches the captured output from the last match towards the older
+		 * lines, or from the line before it to find the next match */
+		private void search(bool next)
+		{
+			string text = search_entry.get_text();
+			int64 line = -1;
+
+			if (scrollback == null)
+				return;
+
+			if (text == "")
+			{
+				search_line = -1;
+				search_label.set_text("");
+				return;
+			}
+
+			if (!ScrollbackIndex.is_searchable(text))
+			{
+				search_line = -1;
+				search_label.set_text("Type at least %d letters or digits".printf(
+					ScrollbackIndex.MIN_QUERY_LENGTH));
+				return;
+			}
+
+			if (search_line >= scrollback.first)
+			{
+				int64 from = next ? search_line - 1 : search_line;
+				if (from >= scrollback.first)
+					line = scrollback.find(text, from, true);
+			}
+			/* start over from the newest line */
+			if (line < 0)
+				line = scrollback.find(text, (int64) scrollback.end - 1, true);
+
+			if (line < 0)
+			{
+				search_line = -1;
+				search_label.set_text("Not found");
+				return;
+			}
+
+			search_line = line;
+			search_label.set_text(scrollback.get_line((uint) line).strip());
+
+			/* scroll to the line if the terminal still has it */
+			long row = scrollback.get_row((uint) line);
+			Adjustment adj = terminal.get_adjustment();
+			if (row >= adj.lower)
+				adj.set_value(double.min(row, adj.upper - adj.page_size));
+		}
+
+		private bool on_search_key_press(EventKey event)
+		{
+			if (Gdk.keyval_name(event.keyval) == "Escape")
+			{
+				hide_search();
+				return true;
+			}
+			return false;
+		}
+
+		private HBox create_search_bar()
+		{
+			HBox hbox = new HBox(false, 6);
+			Button close_button = new Button();
+
+			search_entry = new Entry();
+			search_entry.changed.connect(() => search(false));
+			search_entry.activate.connect(() => search(true));
+			search_entry.key_press_event.connect(on_search_key_press);
+			search_entry.show();
+
+			search_label = new Label(null);
+			search_label.set_alignment(0.0f, 0.5f);
+			search_label.ellipsize = Pango.EllipsizeMode.END;
+			search_label.show();
+
+			close_button.relief = ReliefStyle.NONE;
+			close_button.focus_on_click = false;
+			close_button.add(new Gtk.Image.from_stock(Gtk.Stock.CLOSE, IconSize.MENU));
+			close_button.clicked.connect(hide_search);
+			close_button.show_all();
+
+			hbox.pack_start(search_entry, false, false, 0);
+			hbox.pack_start(search_label, true, true, 0);
+			hbox.pack_start(close_button, false, false, 0);
+			/* only shown when searching */
+			hbox.no_show_all = true;
+
+			return hbox;
+		}
+
 		public void send_command(string command)
 		{
+			start();
 			terminal.feed_child("%s\n".printf(command), -1);
 		}
 
@@ -128,6 +281,7 @@ namespace MultiTerm
 		{
 			VScrollbar vsb;
 			HBox hbox;
+			VBox vbox;
 
 			this.sh = sh;
 			if (this.sh.command.strip() == "")
@@ -143,7 +297,13 @@ namespace MultiTerm
 			hbox.pack_start(terminal, true, true, 0);
 			hbox.pack_start(vsb, false, false, 0);
 
-			this.add(hbox);
+			search_bar = create_search_bar();
+
+			vbox = new VBox(false, 0);
+			vbox.pack_start(hbox, true, true, 0);
+			vbox.pack_start(search_bar, false, false, 0);
+
+			this.add(vbox);
 
 			if (this.sh.track_title)
 				terminal.window_title_changed.connect(on_window_title_changed);
@@ -181,8 +341,14 @@ namespace MultiTerm
 				terminal.set_word_chars("");
 			}
 
+			if (this.sh.capture_lines > 0)
+			{
+				scrollback = new ScrollbackIndex(this.sh.capture_lines);
+				terminal.contents_changed.connect(on_contents_changed);
+			}
+
 			terminal.realize.connect(on_vte_realize); /* colors can only be set on realize (lame) */
-			run_command(this.sh.command);
+			terminal.map.connect(on_vte_map); /* the shell is spawned when first shown */
 		}
 
 	}
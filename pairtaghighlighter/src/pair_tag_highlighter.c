@@ -21,15 +21,54 @@
 #define NONMATCHING_PAIR_COLOR  0xff0000    /* red */
 #define EMPTY_TAG_COLOR         0xffff00    /* yellow */
 
+#define TAG_INDEX_KEY "pair-tag-highlighter-index"
+
+enum
+{
+    TAG_OPENING,
+    TAG_CLOSING,
+    TAG_EMPTY
+};
+
+/* A tag found in the document: positions of its brackets, its name, the
+ * tag it pairs with and, for opening tags, the unclosed opening tag of the
+ * same name it was nested in when it was paired. Tags are referenced by
+ * pointer so that inserting and removing tags doesn't invalidate pairs. */
+typedef struct TagInfo TagInfo;
+struct TagInfo
+{
+    gint openingBracket;
+    gint closingBracket;
+    GQuark name;
+    gint kind;
+    gboolean dead;      /* touched by a modification, waiting to be re-scanned */
+    TagInfo *match;
+    TagInfo *outer;
+};
+
+#define TAG_AT(tags, i) ((TagInfo *) g_ptr_array_index((tags), (i)))
+
+/* Per-document list of tags sorted by position. It is built the first time
+ * the caret moves in the document and afterwards only the text between
+ * the tags surrounding a modification is scanned again. */
+typedef struct
+{
+    GPtrArray *tags;
+    gboolean built;
+    gint dirtyStart;    /* range which needs re-scanning, -1 if none */
+    gint dirtyEnd;
+    gboolean modified;  /* highlighting is out of date */
+    gint currentTag;
+    /* Is needed for clearing highlighting after moving cursor out
+     * from the tag */
+    gint highlightedBrackets[4];
+} TagIndex;
+
 /* These items are set by Geany before plugin_init() is called. */
 GeanyPlugin     *geany_plugin;
 GeanyData       *geany_data;
 GeanyFunctions  *geany_functions;
 
-/* Is needed for clearing highlighting after moving cursor out
- * from the tag */
-static gint highlightedBrackets[] = {0, 0, 0, 0};
-
 PLUGIN_VERSION_CHECK(211)
 
 PLUGIN_SET_TRANSLATABLE_INFO(LOCALEDIR, GETTEXT_PACKAGE, _("Pair Tag Highlighter"),
@@ -37,80 +76,6 @@ PLUGIN_SET_TRANSLATABLE_INFO(LOCALEDIR, GETTEXT_PACKAGE, _("Pair Tag Highlighter
                             "1.1", "Volodymyr Kononenko <vm@kononenko.ws>")
 
 
-/* Searches tag brackets.
- * direction variable shows sets search direction:
- * TRUE  - to the right
- * FALSE - to the left
- * from the current cursor position to the start of the line.
- */
-static gint findBracket(ScintillaObject *sci, gint position, gint endOfSearchPos,
-                        gchar searchedBracket, gchar breakBracket, gboolean direction)
-{
-    gint foundBracket = -1;
-    gint pos;
-
-    if(TRUE == direction)
-    {
-        /* search to the right */
-        for(pos=position; pos<=endOfSearchPos; pos++)
-        {
-            gchar charAtCurPosition = sci_get_char_at(sci, pos);
-            gchar charAtPrevPosition = sci_get_char_at(sci, pos-1);
-            gchar charAtNextPosition = sci_get_char_at(sci, pos+1);
-
-            if(charAtCurPosition == searchedBracket) {
-                if ('>' == searchedBracket) {
-                    if (('-' == charAtPrevPosition) || ('?' == charAtPrevPosition))
-                        continue;
-                } else if ('<' == searchedBracket) {
-                    if ('?' == charAtNextPosition)
-                        continue;
-                }
-                foundBracket = pos;
-                break;
-            } else if(charAtCurPosition == breakBracket) {
-                if ('<' == breakBracket) {
-                    if ('?' == charAtNextPosition)
-                        continue;
-                }
-                break;
-            }
-        }
-    }
-    else
-    {
-        /* search to the left */
-        for(pos=position-1; pos>=endOfSearchPos; pos--)
-        {
-            gchar charAtCurPosition = sci_get_char_at(sci, pos);
-            gchar charAtPrevPosition = sci_get_char_at(sci, pos+1);
-            gchar charAtNextPosition = sci_get_char_at(sci, pos-1);
-
-            if(charAtCurPosition == searchedBracket)
-            {
-                if ('<' == searchedBracket) {
-                    if ('?' == charAtPrevPosition)
-                        continue;
-                } else if ('>' == searchedBracket) {
-                    if (('-' == charAtNextPosition) || ('?' == charAtNextPosition))
-                        continue;
-                }
-                foundBracket = pos;
-                break;
-            } else if(charAtCurPosition == breakBracket) {
-                if ('>' == breakBracket) {
-                    if (('-' == charAtNextPosition) || ('?' == charAtNextPosition))
-                        continue;
-                }
-                break;
-            }
-        }
-    }
-
-    return foundBracket;
-}
-
-
 static gint rgb2bgr(gint color)
 {
     guint r, g, b;
@@ -138,11 +103,11 @@ static void highlight_tag(ScintillaObject *sci, gint openingBracket,
 }
 
 
-static void highlight_matching_pair(ScintillaObject *sci)
+static void highlight_matching_pair(ScintillaObject *sci, TagIndex *idx)
 {
-    highlight_tag(sci, highlightedBrackets[0], highlightedBrackets[1],
+    highlight_tag(sci, idx->highlightedBrackets[0], idx->highlightedBrackets[1],
                   MATCHING_PAIR_COLOR);
-    highlight_tag(sci, highlightedBrackets[2], highlightedBrackets[3],
+    highlight_tag(sci, idx->highlightedBrackets[2], idx->highlightedBrackets[3],
                   MATCHING_PAIR_COLOR);
 }
 
@@ -154,17 +119,6 @@ static void clear_previous_highlighting(ScintillaObject *sci, gint rangeStart, g
 }
 
 
-static gboolean is_tag_self_closing(ScintillaObject *sci, gint closingBracket)
-{
-    gboolean isTagSelfClosing = FALSE;
-    gchar charBeforeBracket = sci_get_char_at(sci, closingBracket-1);
-
-    if('/' == charBeforeBracket)
-        isTagSelfClosing = TRUE;
-    return isTagSelfClosing;
-}
-
-
 static gboolean is_tag_empty(gchar *tagName)
 {
     const char *emptyTags[] = {"area", "base", "br", "col", "embed",
@@ -182,189 +136,487 @@ static gboolean is_tag_empty(gchar *tagName)
 }
 
 
-static gboolean is_tag_opening(ScintillaObject *sci, gint openingBracket)
-{
-    gboolean isTagOpening = TRUE;
-    gchar charAfterBracket = sci_get_char_at(sci, openingBracket+1);
-
-    if('/' == charAfterBracket)
-        isTagOpening = FALSE;
-    return isTagOpening;
-}
-
-
-static void get_tag_name(ScintillaObject *sci, gint openingBracket, gint closingBracket,
-                    gchar tagName[], gboolean isTagOpening)
+static void add_tag(GPtrArray *tags, const gchar *text, gint openingBracket, gint closingBracket)
 {
+    TagInfo *tag = g_slice_new0(TagInfo);
+    gchar tagName[MAX_TAG_NAME];
+    gboolean isTagOpening = ('/' != text[openingBracket+1]);
     gint nameStart = openingBracket + (TRUE == isTagOpening ? 1 : 2);
     gint nameEnd = nameStart;
-    gchar charAtCurPosition = sci_get_char_at(sci, nameStart);
 
-    while(' ' != charAtCurPosition && '>' != charAtCurPosition &&
-        '\t' != charAtCurPosition && '\r' != charAtCurPosition && '\n' != charAtCurPosition)
+    while(nameEnd < closingBracket && nameEnd-nameStart < MAX_TAG_NAME-1 &&
+        ' ' != text[nameEnd] && '\t' != text[nameEnd] &&
+        '\r' != text[nameEnd] && '\n' != text[nameEnd])
     {
-        charAtCurPosition = sci_get_char_at(sci, nameEnd);
         nameEnd++;
-        if(nameEnd-nameStart > MAX_TAG_NAME)
-            break;
     }
-    sci_get_text_range(sci, nameStart, nameEnd-1, tagName);
+    memcpy(tagName, text+nameStart, nameEnd-nameStart);
+    tagName[nameEnd-nameStart] = '\0';
+
+    tag->openingBracket = openingBracket;
+    tag->closingBracket = closingBracket;
+    tag->name = g_quark_from_string(tagName);
+    if('/' == text[closingBracket-1] || is_tag_empty(tagName))
+        tag->kind = TAG_EMPTY;
+    else
+        tag->kind = isTagOpening ? TAG_OPENING : TAG_CLOSING;
+    g_ptr_array_add(tags, tag);
 }
 
 
-static void findMatchingOpeningTag(ScintillaObject *sci, gchar *tagName, gint openingBracket)
+/* Collects the tags between from and to. '<?' and '?>' (php tags) as
+ * well as '->' (object operators) are not treated as tag brackets. */
+static void scan_tags(GPtrArray *tags, const gchar *text, gint textLength, gint from, gint to)
 {
-    gint pos;
-    gint openingTagsCount = 0;
-    gint closingTagsCount = 1;
+    gint pos = from;
 
-    for(pos=openingBracket; pos>0; pos--)
+    while(pos < to)
     {
-        /* are we inside tag? */
-        gint lineNumber = sci_get_line_from_position(sci, pos);
-        gint lineStart = sci_get_position_from_line(sci, lineNumber);
-        gint matchingOpeningBracket = findBracket(sci, pos, lineStart, '<', '\0', FALSE);
-        gint matchingClosingBracket = findBracket(sci, pos, lineStart, '>', '\0', FALSE);
-
-        if(-1 != matchingOpeningBracket && -1 != matchingClosingBracket
-            && (matchingClosingBracket > matchingOpeningBracket))
+        gint end;
+
+        if('<' != text[pos] || (pos+1 < textLength && '?' == text[pos+1]))
         {
-            /* we are inside of some tag. Let us check what tag*/
-            gchar matchingTagName[MAX_TAG_NAME];
-            gboolean isMatchingTagOpening = is_tag_opening(sci, matchingOpeningBracket);
-            get_tag_name(sci, matchingOpeningBracket, matchingClosingBracket,
-                            matchingTagName, isMatchingTagOpening);
-            if(strcmp(tagName, matchingTagName) == 0)
-            {
-                if(TRUE == isMatchingTagOpening)
-                    openingTagsCount++;
-                else
-                    closingTagsCount++;
-            }
-            pos = matchingOpeningBracket+1;
+            pos++;
+            continue;
         }
-        /* Speed up search: if findBracket returns -1, that means start of line
-         * is reached. There is no need to go through the same positions again.
-         * Jump to the start of line */
-        else if(-1 == matchingOpeningBracket || -1 == matchingClosingBracket)
+
+        for(end=pos+1; end<to; end++)
         {
-            pos = lineStart;
-            continue;
+            if('>' == text[end] && '-' != text[end-1] && '?' != text[end-1])
+                break;
+            if('<' == text[end] && !(end+1 < textLength && '?' == text[end+1]))
+                break;
         }
-        if(openingTagsCount == closingTagsCount)
+
+        if(end < to && '>' == text[end])
         {
-            /* matching tag is found */
-            highlightedBrackets[2] = matchingOpeningBracket;
-            highlightedBrackets[3] = matchingClosingBracket;
-            highlight_matching_pair(sci);
-            return;
+            add_tag(tags, text, pos, end);
+            pos = end+1;
         }
+        else
+            pos = end;
     }
-    highlight_tag(sci, highlightedBrackets[0], highlightedBrackets[1],
-                  NONMATCHING_PAIR_COLOR);
 }
 
 
-static void findMatchingClosingTag(ScintillaObject *sci, gchar *tagName, gint closingBracket)
+/* Pairing state of one tag name while the tags are paired again */
+typedef struct
+{
+    TagInfo *top;       /* innermost unclosed opening tag */
+    TagInfo *oldTop;    /* the same before the change, at the current tag */
+    gboolean pending;   /* not known to agree with the previous pairing yet */
+    gboolean found;
+} PairState;
+
+
+/* The innermost unclosed opening tag of the tag's name right after the tag,
+ * according to the current pairing */
+static TagInfo *top_after_tag(TagInfo *tag)
+{
+    if(TAG_OPENING == tag->kind)
+        return tag;
+    return NULL != tag->match ? tag->match->outer : NULL;
+}
+
+
+static PairState *get_pair_state(GHashTable *states, GQuark name)
+{
+    PairState *state = g_hash_table_lookup(states, GUINT_TO_POINTER(name));
+
+    if(NULL == state)
+    {
+        state = g_new0(PairState, 1);
+        g_hash_table_insert(states, GUINT_TO_POINTER(name), state);
+    }
+    return state;
+}
+
+
+static void pair_tag(PairState *state, TagInfo *tag)
+{
+    if(TAG_OPENING == tag->kind)
+    {
+        tag->match = NULL;
+        tag->outer = state->top;
+        state->top = tag;
+    }
+    else if(NULL != state->top)
+    {
+        tag->match = state->top;
+        state->top->match = tag;
+        state->top = state->top->outer;
+    }
+    else
+        tag->match = NULL;
+}
+
+
+/* Pairs opening and closing tags with the same name, each name having its
+ * own stack of unclosed tags. The tags from first to first+count replaced
+ * the removed ones (still allocated but no longer in the index) and
+ * start at position from. Only the names of these tags can pair
+ * differently, and each of them is paired again until its stack is the same
+ * as it was before, which usually happens at the next tag of that name. */
+static void pair_tags(TagIndex *idx, guint first, guint count, GPtrArray *removed, gint from)
 {
-    gint pos;
-    gint linesInDocument = sci_get_line_count(sci);
-    gint endOfDocument = sci_get_position_from_line(sci, linesInDocument);
-    gint openingTagsCount = 1;
-    gint closingTagsCount = 0;
+    GHashTable *states = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    GHashTable *oldOuters = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GHashTableIter iter;
+    PairState *state;
+    guint missing = 0;
+    guint pending = 0;
+    guint i;
+
+    /* the stacks before and after the removed tags, before the change */
+    for(i=0; NULL != removed && i<removed->len; i++)
+    {
+        TagInfo *tag = TAG_AT(removed, i);
+
+        if(TAG_EMPTY == tag->kind)
+            continue;
+        state = get_pair_state(states, tag->name);
+        if(!state->found)
+        {
+            state->top = TAG_OPENING == tag->kind ? tag->outer : tag->match;
+            state->found = TRUE;
+        }
+        state->oldTop = top_after_tag(tag);
+    }
+    /* the stacks of the names only found in the new tags are those left by
+     * the closest tags before them */
+    for(i=first; i<first+count; i++)
+    {
+        TagInfo *tag = TAG_AT(idx->tags, i);
+
+        if(TAG_EMPTY == tag->kind)
+            continue;
+        state = get_pair_state(states, tag->name);
+        if(!state->found && !state->pending)
+        {
+            state->pending = TRUE;
+            missing++;
+        }
+    }
+    for(i=first; missing > 0 && i>0; i--)
+    {
+        TagInfo *tag = TAG_AT(idx->tags, i-1);
+
+        if(TAG_EMPTY == tag->kind)
+            continue;
+        state = g_hash_table_lookup(states, GUINT_TO_POINTER(tag->name));
+        if(NULL != state && !state->found)
+        {
+            state->top = state->oldTop = top_after_tag(tag);
+            state->found = TRUE;
+            missing--;
+        }
+    }
+
+    for(i=first; i<first+count; i++)
+    {
+        TagInfo *tag = TAG_AT(idx->tags, i);
+
+        if(TAG_EMPTY != tag->kind)
+            pair_tag(g_hash_table_lookup(states, GUINT_TO_POINTER(tag->name)), tag);
+    }
+
+    /* a stack made of tags before the change only is the same as before if
+     * its innermost tag is */
+    g_hash_table_iter_init(&iter, states);
+    while(g_hash_table_iter_next(&iter, NULL, (gpointer *) &state))
+    {
+        state->pending = state->top != state->oldTop ||
+                        (NULL != state->top && state->top->openingBracket >= from);
+        if(state->pending)
+            pending++;
+    }
 
-    for(pos=closingBracket; pos<endOfDocument; pos++)
+    for(i=first+count; pending > 0 && i<idx->tags->len; i++)
     {
-        /* are we inside tag? */
-        gint lineNumber = sci_get_line_from_position(sci, pos);
-        gint lineEnd = sci_get_line_end_position(sci, lineNumber);
-        gint matchingOpeningBracket = findBracket(sci, pos, lineEnd, '<', '\0', TRUE);
-        gint matchingClosingBracket = findBracket(sci, pos, lineEnd, '>', '\0', TRUE);
-
-        if(-1 != matchingOpeningBracket && -1 != matchingClosingBracket
-            && (matchingClosingBracket > matchingOpeningBracket))
+        TagInfo *tag = TAG_AT(idx->tags, i);
+
+        if(TAG_EMPTY == tag->kind)
+            continue;
+        state = g_hash_table_lookup(states, GUINT_TO_POINTER(tag->name));
+        if(NULL == state || !state->pending)
+            continue;
+
+        /* read the previous pairing before it is overwritten */
+        if(TAG_OPENING == tag->kind)
         {
-            /* we are inside of some tag. Let us check what tag*/
-            gchar matchingTagName[64];
-            gboolean isMatchingTagOpening = is_tag_opening(sci, matchingOpeningBracket);
-            get_tag_name(sci, matchingOpeningBracket, matchingClosingBracket,
-                            matchingTagName, isMatchingTagOpening);
-            if(strcmp(tagName, matchingTagName) == 0)
-            {
-                if(TRUE == isMatchingTagOpening)
-                    openingTagsCount++;
-                else
-                    closingTagsCount++;
-            }
-            pos = matchingClosingBracket;
+            g_hash_table_insert(oldOuters, tag, tag->outer);
+            state->oldTop = tag;
         }
+        else if(NULL == tag->match)
+            state->oldTop = NULL;
+        else if(g_hash_table_lookup_extended(oldOuters, tag->match, NULL, (gpointer *) &state->oldTop))
+            ;
+        else
+            state->oldTop = tag->match->outer;
 
-        if(openingTagsCount == closingTagsCount)
+        pair_tag(state, tag);
+        if(state->top == state->oldTop &&
+            (NULL == state->top || state->top->openingBracket < from))
         {
-            /* matching tag is found */
-            highlightedBrackets[2] = matchingOpeningBracket;
-            highlightedBrackets[3] = matchingClosingBracket;
-            highlight_matching_pair(sci);
-            return;
+            state->pending = FALSE;
+            pending--;
         }
     }
-    highlight_tag(sci, highlightedBrackets[0], highlightedBrackets[1],
-                  NONMATCHING_PAIR_COLOR);
+
+    /* the tags left open at the end of the document */
+    g_hash_table_iter_init(&iter, states);
+    while(g_hash_table_iter_next(&iter, NULL, (gpointer *) &state))
+    {
+        TagInfo *tag;
+
+        for(tag = state->pending ? state->top : NULL; NULL != tag; tag = tag->outer)
+            tag->match = NULL;
+    }
+
+    g_hash_table_destroy(oldOuters);
+    g_hash_table_destroy(states);
 }
 
 
-static void findMatchingTag(ScintillaObject *sci, gint openingBracket, gint closingBracket)
+/* Returns the index of the first tag whose opening (or closing) bracket is
+ * at or after position. Tags don't overlap, so both brackets are sorted. */
+static guint find_first_tag_after(GPtrArray *tags, gint position, gboolean byClosingBracket)
 {
-    gchar tagName[MAX_TAG_NAME];
-    gboolean isTagOpening = is_tag_opening(sci, openingBracket);
+    guint low = 0;
+    guint high = tags->len;
 
-    get_tag_name(sci, openingBracket, closingBracket, tagName, isTagOpening);
+    while(low < high)
+    {
+        guint mid = (low + high) / 2;
+        TagInfo *tag = TAG_AT(tags, mid);
+        gint bracket = byClosingBracket ? tag->closingBracket : tag->openingBracket;
 
-    if(is_tag_self_closing(sci, closingBracket) || is_tag_empty(tagName)) {
-        highlight_tag(sci, openingBracket, closingBracket, EMPTY_TAG_COLOR);
-    } else {
-        if(isTagOpening)
-            findMatchingClosingTag(sci, tagName, closingBracket);
+        if(bracket < position)
+            low = mid + 1;
         else
-            findMatchingOpeningTag(sci, tagName, openingBracket);
+            high = mid;
     }
+    return low;
 }
 
 
-static void run_tag_highlighter(ScintillaObject *sci)
+static void free_tag(gpointer tag, gpointer user_data)
 {
-    gint position = sci_get_current_position(sci);
-    gint lineNumber = sci_get_current_line(sci);
-    gint lineStart = sci_get_position_from_line(sci, lineNumber);
-    gint lineEnd = sci_get_line_end_position(sci, lineNumber);
-    gint openingBracket = findBracket(sci, position, lineStart, '<', '>', FALSE);
-    gint closingBracket = findBracket(sci, position, lineEnd, '>', '<', TRUE);
-    int i;
-
-    if(-1 == openingBracket || -1 == closingBracket)
+    g_slice_free(TagInfo, tag);
+}
+
+
+static void update_tag_index(TagIndex *idx, ScintillaObject *sci)
+{
+    const gchar *text;
+    gint textLength;
+
+    if(idx->built && idx->dirtyStart < 0)
+        return;
+
+    textLength = sci_get_length(sci);
+    text = (const gchar *) scintilla_send_message(sci, SCI_GETCHARACTERPOINTER, 0, 0);
+
+    if(!idx->built)
+    {
+        g_ptr_array_set_size(idx->tags, 0);
+        scan_tags(idx->tags, text, textLength, 0, textLength);
+        pair_tags(idx, 0, idx->tags->len, NULL, 0);
+        idx->built = TRUE;
+    }
+    else
     {
-        clear_previous_highlighting(sci, highlightedBrackets[0], highlightedBrackets[1]);
-        clear_previous_highlighting(sci, highlightedBrackets[2], highlightedBrackets[3]);
-        for(i=0; i<3; i++)
-            highlightedBrackets[i] = 0;
+        /* re-scan from the end of the last untouched tag before the change up
+         * to the first untouched one after it */
+        guint first = find_first_tag_after(idx->tags, idx->dirtyStart, FALSE);
+        guint last = find_first_tag_after(idx->tags, idx->dirtyEnd, FALSE);
+        gint from, to;
+        GPtrArray *newTags = g_ptr_array_new();
+        GPtrArray *removed = g_ptr_array_new();
+        guint i;
+
+        while(last < idx->tags->len && TAG_AT(idx->tags, last)->dead)
+            last++;
+        from = first > 0 ? TAG_AT(idx->tags, first-1)->closingBracket+1 : 0;
+        to = last < idx->tags->len ? TAG_AT(idx->tags, last)->openingBracket : textLength;
+        scan_tags(newTags, text, textLength, from, to);
+
+        for(i=first; i<last; i++)
+            g_ptr_array_add(removed, TAG_AT(idx->tags, i));
+        if(newTags->len > last-first)
+        {
+            guint oldLength = idx->tags->len;
+
+            g_ptr_array_set_size(idx->tags, oldLength + newTags->len - (last-first));
+            memmove(idx->tags->pdata + first + newTags->len, idx->tags->pdata + last,
+                    (oldLength-last) * sizeof(gpointer));
+        }
+        else
+        {
+            memmove(idx->tags->pdata + first + newTags->len, idx->tags->pdata + last,
+                    (idx->tags->len-last) * sizeof(gpointer));
+            g_ptr_array_set_size(idx->tags, idx->tags->len - (last-first) + newTags->len);
+        }
+        if(newTags->len > 0)
+            memcpy(idx->tags->pdata + first, newTags->pdata, newTags->len * sizeof(gpointer));
+
+        pair_tags(idx, first, newTags->len, removed, from);
+        g_ptr_array_foreach(removed, free_tag, NULL);
+        g_ptr_array_free(newTags, TRUE);
+        g_ptr_array_free(removed, TRUE);
+    }
+    idx->dirtyStart = idx->dirtyEnd = -1;
+}
+
+
+/* Updates the tag positions after text was inserted or deleted. The tags the
+ * change touched are collapsed at its position and replaced once the text
+ * is re-scanned on the next lookup. */
+static void tag_index_text_changed(TagIndex *idx, gint position, gint length, gboolean inserted)
+{
+    gint changeEnd = inserted ? position : position+length;
+    gint delta = inserted ? length : -length;
+    guint first, last, i;
+
+    idx->modified = TRUE;
+    if(!idx->built)
         return;
+
+    first = find_first_tag_after(idx->tags, position, TRUE);
+    for(last=first; last<idx->tags->len; last++)
+    {
+        TagInfo *tag = TAG_AT(idx->tags, last);
+
+        if(tag->openingBracket >= changeEnd)
+            break;
+        tag->openingBracket = tag->closingBracket = position;
+        tag->dead = TRUE;
+    }
+    for(i=last; i<idx->tags->len; i++)
+    {
+        TagInfo *tag = TAG_AT(idx->tags, i);
+        tag->openingBracket += delta;
+        tag->closingBracket += delta;
     }
 
-    /* If the cursor jumps from one tag into another, clear
-     * previous highlighted tags*/
-    if(openingBracket != highlightedBrackets[0] ||
-        closingBracket != highlightedBrackets[1])
+    if(idx->dirtyStart >= 0)
+    {
+        if(idx->dirtyStart >= changeEnd)
+            idx->dirtyStart += delta;
+        else if(idx->dirtyStart > position)
+            idx->dirtyStart = position;
+        if(idx->dirtyEnd >= changeEnd)
+            idx->dirtyEnd += delta;
+        else if(idx->dirtyEnd > position)
+            idx->dirtyEnd = position;
+        idx->dirtyStart = MIN(idx->dirtyStart, position);
+        idx->dirtyEnd = MAX(idx->dirtyEnd, inserted ? position+length : position);
+    }
+    else
     {
-        clear_previous_highlighting(sci, highlightedBrackets[0], highlightedBrackets[1]);
-        clear_previous_highlighting(sci, highlightedBrackets[2], highlightedBrackets[3]);
+        idx->dirtyStart = position;
+        idx->dirtyEnd = inserted ? position+length : position;
     }
+}
+
 
+static void free_tag_index(TagIndex *idx)
+{
+    g_ptr_array_foreach(idx->tags, free_tag, NULL);
+    g_ptr_array_free(idx->tags, TRUE);
+    g_free(idx);
+}
+
+
+static TagIndex *get_tag_index(ScintillaObject *sci)
+{
+    TagIndex *idx = g_object_get_data(G_OBJECT(sci), TAG_INDEX_KEY);
+
+    if(NULL == idx)
+    {
+        idx = g_new0(TagIndex, 1);
+        idx->tags = g_ptr_array_new();
+        idx->dirtyStart = idx->dirtyEnd = -1;
+        idx->currentTag = -1;
+        g_object_set_data_full(G_OBJECT(sci), TAG_INDEX_KEY, idx,
+                                (GDestroyNotify) free_tag_index);
+    }
+    return idx;
+}
+
+
+/* Returns the index of the tag the position is inside of, or -1 */
+static gint find_tag_at(TagIndex *idx, gint position)
+{
+    guint i = find_first_tag_after(idx->tags, position, FALSE);
+    TagInfo *tag;
+
+    if(0 == i)
+        return -1;
+    tag = TAG_AT(idx->tags, i-1);
+    if(position > tag->closingBracket)
+        return -1;
+    return i-1;
+}
+
+
+static void clear_tag_highlighting(ScintillaObject *sci, TagIndex *idx)
+{
+    if(idx->modified)
+    {
+        /* the highlighted positions have moved, clear everything */
+        clear_previous_highlighting(sci, 0, sci_get_length(sci));
+    }
+    else
+    {
+        clear_previous_highlighting(sci, idx->highlightedBrackets[0], idx->highlightedBrackets[1]);
+        clear_previous_highlighting(sci, idx->highlightedBrackets[2], idx->highlightedBrackets[3]);
+    }
+    memset(idx->highlightedBrackets, 0, sizeof(idx->highlightedBrackets));
+}
+
+
+static void run_tag_highlighter(ScintillaObject *sci)
+{
+    TagIndex *idx = get_tag_index(sci);
+    gint position = sci_get_current_position(sci);
+    gint i;
+    TagInfo *tag;
+
+    update_tag_index(idx, sci);
+    i = find_tag_at(idx, position);
+
+    /* nothing to do while the caret stays inside the same tag */
+    if(i == idx->currentTag && !idx->modified)
+        return;
+
+    clear_tag_highlighting(sci, idx);
+    idx->modified = FALSE;
+    idx->currentTag = i;
+    if(-1 == i)
+        return;
+
+    tag = TAG_AT(idx->tags, i);
     /* Don't run search on empty brackets <> */
-    if (closingBracket - openingBracket > 1) {
-        highlightedBrackets[0] = openingBracket;
-        highlightedBrackets[1] = closingBracket;
+    if(tag->closingBracket - tag->openingBracket <= 1)
+        return;
 
-        findMatchingTag(sci, openingBracket, closingBracket);
+    idx->highlightedBrackets[0] = tag->openingBracket;
+    idx->highlightedBrackets[1] = tag->closingBracket;
+    if(TAG_EMPTY == tag->kind)
+    {
+        highlight_tag(sci, tag->openingBracket, tag->closingBracket, EMPTY_TAG_COLOR);
+    }
+    else if(NULL != tag->match)
+    {
+        idx->highlightedBrackets[2] = tag->match->openingBracket;
+        idx->highlightedBrackets[3] = tag->match->closingBracket;
+        highlight_matching_pair(sci, idx);
+    }
+    else
+    {
+        highlight_tag(sci, tag->openingBracket, tag->closingBracket,
+                      NONMATCHING_PAIR_COLOR);
     }
 }
 
@@ -375,6 +627,18 @@ static gboolean on_editor_notify(GObject *obj, GeanyEditor *editor,
 {
     gint lexer;
 
+    /* keep an existing index up to date even if the lexer changed meanwhile */
+    if(SCN_MODIFIED == nt->nmhdr.code &&
+        (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)))
+    {
+        TagIndex *idx = g_object_get_data(G_OBJECT(editor->sci), TAG_INDEX_KEY);
+
+        if(NULL != idx)
+            tag_index_text_changed(idx, nt->position, nt->length,
+                                   (nt->modificationType & SC_MOD_INSERTTEXT) != 0);
+        return FALSE;
+    }
+
     lexer = sci_get_lexer(editor->sci);
     if((lexer != SCLEX_HTML) && (lexer != SCLEX_XML))
     {
@@ -385,6 +649,10 @@ static gboolean on_editor_notify(GObject *obj, GeanyEditor *editor,
     switch (nt->nmhdr.code)
     {
         case SCN_UPDATEUI:
+            /* scrolling alone doesn't move the caret */
+            if(0 != nt->updated &&
+                !(nt->updated & (SC_UPDATE_CONTENT | SC_UPDATE_SELECTION)))
+                break;
             run_tag_highlighter(editor->sci);
             break;
     }
@@ -408,11 +676,17 @@ void plugin_init(GeanyData *data)
 
 void plugin_cleanup(void)
 {
-    GeanyDocument *doc = document_get_current();
+    guint i;
 
-    if (doc)
+    foreach_document(i)
     {
-        clear_previous_highlighting(doc->editor->sci, highlightedBrackets[0], highlightedBrackets[1]);
-        clear_previous_highlighting(doc->editor->sci, highlightedBrackets[2], highlightedBrackets[3]);
+        ScintillaObject *sci = documents[i]->editor->sci;
+        TagIndex *idx = g_object_get_data(G_OBJECT(sci), TAG_INDEX_KEY);
+
+        if(NULL != idx)
+        {
+            clear_tag_highlighting(sci, idx);
+            g_object_set_data(G_OBJECT(sci), TAG_INDEX_KEY, NULL);
+        }
     }
 }
@@ -65,9 +65,19 @@ static struct Plugin {
   gboolean update_headers;
   
   GtkWidget *menu_item;
+  
+  struct {
+    GtkWidget  *page;
+    GtkWidget  *progress;
+    GtkWidget  *translated;
+    GtkWidget  *fuzzy;
+    GtkWidget  *untranslated;
+    guint       update_id;
+  } stats;
 } plugin = {
   TRUE,
-  NULL
+  NULL,
+  { NULL, NULL, NULL, NULL, NULL, 0 }
 };
 
 
@@ -76,12 +86,6 @@ static struct Plugin {
                         (doc)->file_type->id == GEANY_FILETYPES_PO)
 
 
-/* gets the smallest valid position between @a and @b */
-#define MIN_POS(a, b) ((a) < 0 ? (b) : (b) < 0 ? (a) : MIN ((a), (b)))
-/* gets the highest valid position between @a and @b */
-#define MAX_POS(a, b) (MAX ((a), (b)))
-
-
 /*
  * find_style:
  * @sci: a #ScintillaObject
@@ -126,196 +130,526 @@ find_style (ScintillaObject  *sci,
   return pos;
 }
 
-/*
- * find_message:
- * @doc: A #GeanyDocument
- * @start: start of the search range
- * @end: end of the search range
+/* message entry index
  * 
- * Finds the start position of the next msgstr in the given range.  If start is
- * > end, searches backwards.
- * 
- * Returns: The start position of the next msgstr in the given range, or -1 if
- *          not found.
- */
-static gint
-find_message (GeanyDocument  *doc,
-              gint            start,
-              gint            end)
+ * The entries of a catalog are parsed from the text rather than from the
+ * styles, so that the lexer doesn't need to style the whole document.  The
+ * index is built once, and then only the entries touched by an edit are
+ * parsed again, the next time the index is used. */
+
+#define GPH_INDEX_KEY "pohelper-entry-index"
+
+typedef struct {
+  gint      start;      /* start of the entry's first line, comments included */
+  gint      end;        /* start of the line following the entry */
+  gint      msgstr;     /* start of the translation, after the opening quote */
+  guint     fuzzy       : 1;
+  guint     translated  : 1;
+  guint     header      : 1;
+} GphEntry;
+
+typedef struct {
+  GArray   *entries;      /* GphEntry, sorted and not overlapping */
+  gint      dirty_start;  /* range to parse again, -1 if none */
+  gint      dirty_end;
+} GphIndex;
+
+typedef enum {
+  GPH_LINE_BLANK,
+  GPH_LINE_COMMENT,
+  GPH_LINE_FLAGS,
+  GPH_LINE_MSGCTXT,
+  GPH_LINE_MSGID,
+  GPH_LINE_MSGID_PLURAL,
+  GPH_LINE_MSGSTR,
+  GPH_LINE_STRING,
+  GPH_LINE_OTHER
+} GphLineType;
+
+typedef struct {
+  gboolean      active;       /* whether an entry is being read */
+  GphLineType   last;         /* last keyword (not string) line of the entry */
+  GphEntry      entry;
+  gboolean      in_msgid;
+  gboolean      in_first_msgstr;
+  gboolean      msgid_empty;
+  gboolean      has_msgctxt;
+} GphParser;
+
+static void
+gph_index_free (GphIndex *index)
 {
-  if (doc_is_po (doc)) {
-    ScintillaObject *sci = doc->editor->sci;
-    gint pos = find_style (sci, SCE_PO_MSGSTR, start, end);
+  g_array_free (index->entries, TRUE);
+  g_slice_free (GphIndex, index);
+}
+
+/* checks whether the line [@p, @end) starts with @keyword followed by a
+ * space, a quote or the end of the line */
+static gboolean
+line_has_keyword (const gchar  *p,
+                  const gchar  *end,
+                  const gchar  *keyword)
+{
+  gsize len = strlen (keyword);
+  
+  return ((gsize) (end - p) >= len && strncmp (p, keyword, len) == 0 &&
+          (p + len == end || p[len] == ' ' || p[len] == '\t' ||
+           p[len] == '"' || p[len] == '\r' || p[len] == '\n'));
+}
+
+/* gets the type of the line [@p, @end) */
+static GphLineType
+classify_line (const gchar *p,
+               const gchar *end)
+{
+  while (p < end && (*p == ' ' || *p == '\t')) {
+    p++;
+  }
+  
+  if (p >= end || *p == '\r' || *p == '\n') {
+    return GPH_LINE_BLANK;
+  } else if (*p == '#') {
+    return (p + 1 < end && p[1] == ',') ? GPH_LINE_FLAGS : GPH_LINE_COMMENT;
+  } else if (*p == '"') {
+    return GPH_LINE_STRING;
+  } else if (line_has_keyword (p, end, "msgctxt")) {
+    return GPH_LINE_MSGCTXT;
+  } else if (line_has_keyword (p, end, "msgid_plural")) {
+    return GPH_LINE_MSGID_PLURAL;
+  } else if (line_has_keyword (p, end, "msgid")) {
+    return GPH_LINE_MSGID;
+  } else if (line_has_keyword (p, end, "msgstr") ||
+             ((gsize) (end - p) > 6 && strncmp (p, "msgstr[", 7) == 0)) {
+    return GPH_LINE_MSGSTR;
+  }
+  
+  return GPH_LINE_OTHER;
+}
+
+/* finds the opening quote of the string on the line [@p, @end), or NULL */
+static const gchar *
+find_string (const gchar *p,
+             const gchar *end)
+{
+  for (; p < end; p++) {
+    if (*p == '"')
+      return p;
+  }
+  
+  return NULL;
+}
+
+/* whether the string on the line [@p, @end) is empty or missing */
+static gboolean
+string_is_empty (const gchar *p,
+                 const gchar *end)
+{
+  p = find_string (p, end);
+  
+  return ! p || p + 1 >= end || p[1] == '"';
+}
+
+/* whether the flags line [@p, @end) contains the "fuzzy" flag */
+static gboolean
+flags_have_fuzzy (const gchar *p,
+                  const gchar *end)
+{
+  while (p < end) {
+    const gchar *ws;
     
-    if (pos >= 0) {
-      pos = find_style (sci, SCE_PO_MSGSTR_TEXT, pos, sci_get_length (sci));
-      if (pos >= 0) {
-        return pos + 1;
-      } 
+    while (p < end && (*p == '#' || *p == ',' || g_ascii_isspace (*p))) {
+      p++;
+    }
+    for (ws = p; p < end && *p != ',' && ! g_ascii_isspace (*p); p++);
+    if (p - ws == 5 && strncmp (ws, "fuzzy", 5) == 0) {
+      return TRUE;
     }
   }
   
-  return -1;
+  return FALSE;
 }
 
-/*
- * find_untranslated:
- * @doc: A #GeanyDocument
- * @start: start of the search range
- * @end: end of the search range
- * 
- * Searches for the next untranslated message in the given range.  If start is
- * > end, searches backwards.
- * 
- * Returns: The start position of the next untranslated message in the given
- *          range, or -1 if not found.
- */
-static gint
-find_untranslated (GeanyDocument *doc,
-                   gint           start,
-                   gint           end)
+/* whether a line of type @type starts a new entry, given what was read */
+static gboolean
+parser_line_starts_entry (const GphParser *parser,
+                          GphLineType      type)
 {
-  if (doc_is_po (doc)) {
-    ScintillaObject *sci = doc->editor->sci;
-    gboolean backwards = start > end;
+  switch (type) {
+    case GPH_LINE_COMMENT:
+    case GPH_LINE_FLAGS:
+    case GPH_LINE_MSGCTXT:
+      return ! parser->active || parser->last != GPH_LINE_COMMENT;
     
-    while (start >= 0) {
-      gint pos;
-      
-      if (backwards) {
-        start = find_style (sci, SCE_PO_MSGID, start, end);
+    case GPH_LINE_MSGID:
+      return (! parser->active || (parser->last != GPH_LINE_COMMENT &&
+                                   parser->last != GPH_LINE_MSGCTXT));
+    
+    default:
+      return FALSE;
+  }
+}
+
+/* ends the entry being read, if any, keeping it if it has a translation */
+static void
+parser_finish (GphParser *parser,
+               GArray    *entries)
+{
+  if (parser->active && parser->entry.msgstr >= 0) {
+    parser->entry.header = parser->msgid_empty && ! parser->has_msgctxt;
+    g_array_append_val (entries, parser->entry);
+  }
+  parser->active = FALSE;
+}
+
+/* reads the line [@p, @end) of type @type, starting at position @pos */
+static void
+parser_feed_line (GphParser    *parser,
+                  GArray       *entries,
+                  GphLineType   type,
+                  const gchar  *p,
+                  const gchar  *end,
+                  gint          pos)
+{
+  if (type == GPH_LINE_BLANK) {
+    parser_finish (parser, entries);
+    return;
+  }
+  
+  if (parser_line_starts_entry (parser, type)) {
+    parser_finish (parser, entries);
+    memset (parser, 0, sizeof *parser);
+    parser->active = TRUE;
+    parser->entry.start = pos;
+    parser->entry.msgstr = -1;
+    parser->msgid_empty = TRUE;
+  } else if (! parser->active) {
+    return; /* garbage outside any entry */
+  }
+  
+  switch (type) {
+    case GPH_LINE_FLAGS:
+      if (flags_have_fuzzy (p, end)) {
+        parser->entry.fuzzy = TRUE;
       }
-      
-      pos = find_message (doc, start, end);
-      if (pos < 0) {
-        return -1;
-      } else {
-        gint i = pos;
+      /* fallthrough */
+    case GPH_LINE_COMMENT:
+      parser->last = GPH_LINE_COMMENT;
+      break;
+    
+    case GPH_LINE_MSGCTXT:
+      parser->has_msgctxt = TRUE;
+      parser->last = type;
+      break;
+    
+    case GPH_LINE_MSGID:
+      parser->in_msgid = TRUE;
+      parser->msgid_empty = string_is_empty (p, end);
+      parser->last = type;
+      break;
+    
+    case GPH_LINE_MSGSTR:
+      parser->in_msgid = FALSE;
+      parser->in_first_msgstr = parser->entry.msgstr < 0;
+      if (parser->in_first_msgstr) {
+        const gchar *quote = find_string (p, end);
         
-        for (i = pos; i < sci_get_length (sci); i++) {
-          gint style = sci_get_style_at (sci, i);
-          
-          if (style == SCE_PO_MSGSTR_TEXT) {
-            if (sci_get_char_at (sci, i) != '"') {
-              /* if any character in the text is not a delimiter, there's a
-               * translation */
-              i = -1;
-              break;
-            }
-          } else if (style != SCE_PO_DEFAULT) {
-            /* if we reached something else than the text and the background,
-             * we're done searching */
-            break;
-          }
+        /* where to put the cursor, like right after the opening quote */
+        parser->entry.msgstr = pos + (gint) ((quote ? quote + 1 : end) - p);
+        parser->entry.translated = ! string_is_empty (p, end);
+      }
+      parser->last = type;
+      break;
+    
+    case GPH_LINE_STRING:
+      if (! string_is_empty (p, end)) {
+        if (parser->in_msgid) {
+          parser->msgid_empty = FALSE;
+        } else if (parser->in_first_msgstr) {
+          parser->entry.translated = TRUE;
         }
-        if (i >= 0)
-          return pos;
       }
-      
-      start = pos;
-    }
+      break;
+    
+    default:
+      parser->in_msgid = FALSE;
+      parser->in_first_msgstr = FALSE;
+      parser->last = type;
+      break;
   }
   
-  return -1;
+  parser->entry.end = pos + (gint) (end - p);
 }
 
-static gint
-find_prev_untranslated (GeanyDocument  *doc)
+/* first entry which ends at or after @pos */
+static guint
+index_find_end (GphIndex *index,
+                gint      pos)
 {
-  return find_untranslated (doc, sci_get_current_position (doc->editor->sci),
-                            0);
+  guint lo = 0;
+  guint hi = index->entries->len;
+  
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+    
+    if (g_array_index (index->entries, GphEntry, mid).end < pos)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  
+  return lo;
 }
 
-static gint
-find_next_untranslated (GeanyDocument  *doc)
+/* first entry which starts at or after @pos */
+static guint
+index_find_start (GphIndex *index,
+                  gint      pos)
 {
-  return find_untranslated (doc, sci_get_current_position (doc->editor->sci),
-                            sci_get_length (doc->editor->sci));
+  guint lo = 0;
+  guint hi = index->entries->len;
+  
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+    
+    if (g_array_index (index->entries, GphEntry, mid).start < pos)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  
+  return lo;
 }
 
-static gint
-find_fuzzy (GeanyDocument  *doc,
-            gint            start,
-            gint            end)
+/* first entry whose translation starts after @pos */
+static guint
+index_find_msgstr_after (GphIndex *index,
+                         gint      pos)
 {
-  if (doc_is_po (doc)) {
-    ScintillaObject *sci = doc->editor->sci;
+  guint lo = 0;
+  guint hi = index->entries->len;
+  
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
     
-    if (start > end) {
-      /* if searching backwards, first go to the previous msgstr not to find
-       * the current one */
-      gint style = sci_get_style_at (sci, start);
-      
-      if (style == SCE_PO_MSGSTR || style == SCE_PO_MSGSTR_TEXT) {
-        start = find_style (sci, SCE_PO_MSGID, start, end);
-        if (start >= 0) {
-          start = find_style (sci, SCE_PO_MSGSTR, start, end);
-        }
-      }
-    }
+    if (g_array_index (index->entries, GphEntry, mid).msgstr <= pos)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  
+  return lo;
+}
+
+/* parses again the dirty range of @index, and as much around it as needed
+ * to get back in sync with the entries that were kept */
+static void
+index_update (GphIndex        *index,
+              ScintillaObject *sci)
+{
+  const gchar *text;
+  gint length;
+  guint first, next;
+  gint pos;
+  GphParser parser;
+  GArray *entries;
+  
+  if (index->dirty_start < 0)
+    return;
+  
+  text = (const gchar *) scintilla_send_message (sci, SCI_GETCHARACTERPOINTER,
+                                                 0, 0);
+  length = sci_get_length (sci);
+  
+  /* the entries touching the dirty range were dropped, parse from the end of
+   * the previous one up to the start of a following one */
+  first = index_find_start (index, index->dirty_start);
+  pos = first > 0 ? g_array_index (index->entries, GphEntry, first - 1).end : 0;
+  next = first;
+  
+  memset (&parser, 0, sizeof parser);
+  entries = g_array_new (FALSE, FALSE, sizeof (GphEntry));
+  while (pos < length) {
+    const gchar *line = text + pos;
+    const gchar *eol = memchr (line, '\n', (gsize) (length - pos));
+    const gchar *line_end = eol ? eol + 1 : text + length;
+    GphLineType type = classify_line (line, line_end);
     
-    if (start >= 0) {
-      struct Sci_TextToFind ttf;
-      
-      ttf.chrg.cpMin = start;
-      ttf.chrg.cpMax = end;
-      ttf.lpstrText = (gchar *)"fuzzy";
-      
-      while (sci_find_text (sci, SCFIND_WHOLEWORD | SCFIND_MATCHCASE,
-                            &ttf) >= 0) {
-        gint style = sci_get_style_at (sci, (gint) ttf.chrgText.cpMin);
-        
-        if (style == SCE_PO_FUZZY || style == SCE_PO_FLAGS) {
-          /* OK, now find the start of the translation */
-          return find_message (doc, (gint) ttf.chrgText.cpMax,
-                               start > end ? sci_get_length (sci) : end);
-        }
-        
-        ttf.chrg.cpMin = start > end ? ttf.chrgText.cpMin : ttf.chrgText.cpMax;
-      }
+    /* skip the entries the parsed text flowed into */
+    while (next < index->entries->len &&
+           g_array_index (index->entries, GphEntry, next).start < pos) {
+      next++;
     }
+    if (pos >= index->dirty_end && next < index->entries->len &&
+        g_array_index (index->entries, GphEntry, next).start == pos &&
+        parser_line_starts_entry (&parser, type)) {
+      break;
+    }
+    
+    parser_feed_line (&parser, entries, type, line, line_end, pos);
+    pos = (gint) (line_end - text);
   }
+  if (pos >= length) {
+    next = index->entries->len;
+  }
+  parser_finish (&parser, entries);
   
-  return -1;
+  g_array_remove_range (index->entries, first, next - first);
+  g_array_insert_vals (index->entries, first, entries->data, entries->len);
+  g_array_free (entries, TRUE);
+  
+  index->dirty_start = -1;
+  index->dirty_end = -1;
 }
 
-static gint
-find_prev_fuzzy (GeanyDocument *doc)
+/* shifts and drops the entries after @len bytes were inserted at @pos (or
+ * -@len bytes deleted if negative).  @line_start is the start of the line
+ * containing @pos, as changing a line can change the entry it belongs to.
+ * The text is parsed again later on. */
+static void
+index_text_changed (GphIndex *index,
+                    gint      line_start,
+                    gint      pos,
+                    gint      len)
 {
-  return find_fuzzy (doc, sci_get_current_position (doc->editor->sci), 0);
+  gint changed_end = len < 0 ? pos - len : pos;
+  guint first = index_find_end (index, line_start);
+  guint last;
+  guint i;
+  
+  /* drop the entries touching the modification, shift the following ones */
+  for (last = first; last < index->entries->len; last++) {
+    if (g_array_index (index->entries, GphEntry, last).start > changed_end)
+      break;
+  }
+  g_array_remove_range (index->entries, first, last - first);
+  for (i = first; i < index->entries->len; i++) {
+    GphEntry *entry = &g_array_index (index->entries, GphEntry, i);
+    
+    entry->start += len;
+    entry->end += len;
+    entry->msgstr += len;
+  }
+  
+  /* move the pending dirty range along, and merge the new one */
+  if (index->dirty_start >= 0) {
+    if (len > 0) {
+      if (index->dirty_start > pos)
+        index->dirty_start += len;
+      if (index->dirty_end > pos)
+        index->dirty_end += len;
+    } else {
+      if (index->dirty_start > pos)
+        index->dirty_start = MAX (pos, index->dirty_start + len);
+      if (index->dirty_end > pos)
+        index->dirty_end = MAX (pos, index->dirty_end + len);
+    }
+    index->dirty_start = MIN (index->dirty_start, line_start);
+    index->dirty_end = MAX (index->dirty_end, pos + MAX (len, 0));
+  } else {
+    index->dirty_start = line_start;
+    index->dirty_end = pos + MAX (len, 0);
+  }
 }
 
-static gint
-find_next_fuzzy (GeanyDocument *doc)
+/* gets the up-to-date index of @doc, building it if needed */
+static GphIndex *
+get_index (GeanyDocument *doc)
 {
-  return find_fuzzy (doc, sci_get_current_position (doc->editor->sci),
-                     sci_get_length (doc->editor->sci));
+  GphIndex *index;
+  
+  if (! doc_is_po (doc))
+    return NULL;
+  
+  index = g_object_get_data (G_OBJECT (doc->editor->sci), GPH_INDEX_KEY);
+  if (! index) {
+    index = g_slice_new (GphIndex);
+    index->entries = g_array_new (FALSE, FALSE, sizeof (GphEntry));
+    index->dirty_start = 0;
+    index->dirty_end = sci_get_length (doc->editor->sci);
+    g_object_set_data_full (G_OBJECT (doc->editor->sci), GPH_INDEX_KEY, index,
+                            (GDestroyNotify) gph_index_free);
+  }
+  index_update (index, doc->editor->sci);
+  
+  return index;
 }
 
-/* goto */
+typedef enum {
+  GPH_FILTER_ANY,
+  GPH_FILTER_UNTRANSLATED,
+  GPH_FILTER_FUZZY,
+  GPH_FILTER_UNTRANSLATED_OR_FUZZY
+} GphFilter;
 
-static void
-goto_prev (GeanyDocument *doc)
+static gboolean
+entry_matches (const GphEntry  *entry,
+               GphFilter        filter)
 {
-  if (doc_is_po (doc)) {
-    gint pos = sci_get_current_position (doc->editor->sci);
+  switch (filter) {
+    case GPH_FILTER_UNTRANSLATED:           return ! entry->translated;
+    case GPH_FILTER_FUZZY:                  return entry->fuzzy;
+    case GPH_FILTER_UNTRANSLATED_OR_FUZZY:  return ! entry->translated || entry->fuzzy;
+    default:                                return TRUE;
+  }
+}
+
+/*
+ * find_message:
+ * @doc: A #GeanyDocument
+ * @pos: position from which to search
+ * @backwards: whether to search backwards
+ * @filter: which messages to consider
+ * 
+ * Finds the translation of the next or previous message matching @filter.
+ * Searching backwards skips the message containing @pos.
+ * 
+ * Returns: The start position of the translation, or -1 if not found.
+ */
+static gint
+find_message (GeanyDocument  *doc,
+              gint            pos,
+              gboolean        backwards,
+              GphFilter       filter)
+{
+  GphIndex *index = get_index (doc);
+  
+  if (index) {
+    GArray *entries = index->entries;
     
-    pos = find_style (doc->editor->sci, SCE_PO_MSGID, pos, 0);
-    if (pos >= 0) {
-      pos = find_message (doc, pos, 0);
-      if (pos >= 0) {
-        editor_goto_pos (doc->editor, pos, FALSE);
+    if (backwards) {
+      guint i = index_find_start (index, pos);
+      
+      /* skip the message we're in */
+      if (i > 0 && pos < g_array_index (entries, GphEntry, i - 1).end) {
+        i--;
+      }
+      while (i-- > 0) {
+        if (entry_matches (&g_array_index (entries, GphEntry, i), filter))
+          return g_array_index (entries, GphEntry, i).msgstr;
+      }
+    } else {
+      guint i;
+      
+      for (i = index_find_msgstr_after (index, pos); i < entries->len; i++) {
+        if (entry_matches (&g_array_index (entries, GphEntry, i), filter))
+          return g_array_index (entries, GphEntry, i).msgstr;
       }
     }
   }
+  
+  return -1;
 }
 
+/* goto */
+
 static void
-goto_next (GeanyDocument *doc)
+goto_message (GeanyDocument  *doc,
+              gboolean        backwards,
+              GphFilter       filter)
 {
   if (doc_is_po (doc)) {
     gint pos = find_message (doc, sci_get_current_position (doc->editor->sci),
-                             sci_get_length (doc->editor->sci));
+                             backwards, filter);
     
     if (pos >= 0) {
       editor_goto_pos (doc->editor, pos, FALSE);
@@ -323,80 +657,52 @@ goto_next (GeanyDocument *doc)
   }
 }
 
+static void
+goto_prev (GeanyDocument *doc)
+{
+  goto_message (doc, TRUE, GPH_FILTER_ANY);
+}
+
+static void
+goto_next (GeanyDocument *doc)
+{
+  goto_message (doc, FALSE, GPH_FILTER_ANY);
+}
+
 static void
 goto_prev_untranslated (GeanyDocument *doc)
 {
-  if (doc_is_po (doc)) {
-    gint pos = find_prev_untranslated (doc);
-    
-    if (pos >= 0) {
-      editor_goto_pos (doc->editor, pos, FALSE);
-    }
-  }
+  goto_message (doc, TRUE, GPH_FILTER_UNTRANSLATED);
 }
 
 static void
 goto_next_untranslated (GeanyDocument *doc)
 {
-  if (doc_is_po (doc)) {
-    gint pos = find_next_untranslated (doc);
-    
-    if (pos >= 0) {
-      editor_goto_pos (doc->editor, pos, FALSE);
-    }
-  }
+  goto_message (doc, FALSE, GPH_FILTER_UNTRANSLATED);
 }
 
 static void
 goto_prev_fuzzy (GeanyDocument *doc)
 {
-  if (doc_is_po (doc)) {
-    gint pos = find_prev_fuzzy (doc);
-    
-    if (pos >= 0) {
-      editor_goto_pos (doc->editor, pos, FALSE);
-    }
-  }
+  goto_message (doc, TRUE, GPH_FILTER_FUZZY);
 }
 
 static void
 goto_next_fuzzy (GeanyDocument *doc)
 {
-  if (doc_is_po (doc)) {
-    gint pos = find_next_fuzzy (doc);
-    
-    if (pos >= 0) {
-      editor_goto_pos (doc->editor, pos, FALSE);
-    }
-  }
+  goto_message (doc, FALSE, GPH_FILTER_FUZZY);
 }
 
 static void
 goto_prev_untranslated_or_fuzzy (GeanyDocument *doc)
 {
-  if (doc_is_po (doc)) {
-    gint pos1 = find_prev_untranslated (doc);
-    gint pos2 = find_prev_fuzzy (doc);
-    gint pos = MAX_POS (pos1, pos2);
-    
-    if (pos >= 0) {
-      editor_goto_pos (doc->editor, pos, FALSE);
-    }
-  }
+  goto_message (doc, TRUE, GPH_FILTER_UNTRANSLATED_OR_FUZZY);
 }
 
 static void
 goto_next_untranslated_or_fuzzy (GeanyDocument *doc)
 {
-  if (doc_is_po (doc)) {
-    gint pos1 = find_next_untranslated (doc);
-    gint pos2 = find_next_fuzzy (doc);
-    gint pos = MIN_POS (pos1, pos2);
-    
-    if (pos >= 0) {
-      editor_goto_pos (doc->editor, pos, FALSE);
-    }
-  }
+  goto_message (doc, FALSE, GPH_FILTER_UNTRANSLATED_OR_FUZZY);
 }
 
 /* basic regex search/replace without captures or back references */
@@ -479,6 +785,123 @@ on_document_save (GObject        *obj,
   }
 }
 
+/* statistics */
+
+static void
+set_count_label (GtkWidget *label,
+                 guint      count,
+                 guint      total)
+{
+  gchar *text = g_strdup_printf ("%u (%.0f%%)", count,
+                                 total ? 100.0 * count / total : 0.0);
+  
+  gtk_label_set_text (GTK_LABEL (label), text);
+  g_free (text);
+}
+
+static gboolean
+update_stats_idle (gpointer data)
+{
+  GeanyDocument *doc = document_get_current ();
+  GphIndex *index = get_index (doc);
+  
+  plugin.stats.update_id = 0;
+  
+  if (! index) {
+    gtk_widget_hide (plugin.stats.page);
+  } else {
+    guint translated = 0;
+    guint fuzzy = 0;
+    guint untranslated = 0;
+    guint total;
+    guint i;
+    gchar *text;
+    
+    for (i = 0; i < index->entries->len; i++) {
+      const GphEntry *entry = &g_array_index (index->entries, GphEntry, i);
+      
+      if (entry->header)
+        continue;
+      else if (entry->fuzzy)
+        fuzzy++;
+      else if (entry->translated)
+        translated++;
+      else
+        untranslated++;
+    }
+    total = translated + fuzzy + untranslated;
+    
+    set_count_label (plugin.stats.translated, translated, total);
+    set_count_label (plugin.stats.fuzzy, fuzzy, total);
+    set_count_label (plugin.stats.untranslated, untranslated, total);
+    
+    text = g_strdup_printf (_("%u of %u translated"), translated, total);
+    gtk_progress_bar_set_text (GTK_PROGRESS_BAR (plugin.stats.progress), text);
+    gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (plugin.stats.progress),
+                                   total ? (gdouble) translated / total : 0.0);
+    g_free (text);
+    
+    gtk_widget_show (plugin.stats.page);
+  }
+  
+  return FALSE;
+}
+
+/* updates the statistics once idle, so they don't slow down typing */
+static void
+queue_stats_update (void)
+{
+  if (plugin.stats.page && ! plugin.stats.update_id) {
+    plugin.stats.update_id = g_idle_add_full (G_PRIORITY_LOW,
+                                              update_stats_idle, NULL, NULL);
+  }
+}
+
+static GtkWidget *
+create_stats_row (GtkWidget    *table,
+                  guint         row,
+                  const gchar  *label_text)
+{
+  GtkWidget *label = gtk_label_new (label_text);
+  GtkWidget *value = gtk_label_new (NULL);
+  
+  gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
+  gtk_misc_set_alignment (GTK_MISC (value), 1.0, 0.5);
+  gtk_table_attach (GTK_TABLE (table), label, 0, 1, row, row + 1,
+                    GTK_FILL, 0, 0, 0);
+  gtk_table_attach (GTK_TABLE (table), value, 1, 2, row, row + 1,
+                    GTK_FILL | GTK_EXPAND, 0, 0, 0);
+  
+  return value;
+}
+
+static void
+create_stats_page (void)
+{
+  GtkWidget *vbox = gtk_vbox_new (FALSE, 6);
+  GtkWidget *table = gtk_table_new (3, 2, FALSE);
+  
+  gtk_container_set_border_width (GTK_CONTAINER (vbox), 6);
+  gtk_table_set_col_spacings (GTK_TABLE (table), 12);
+  gtk_table_set_row_spacings (GTK_TABLE (table), 3);
+  
+  plugin.stats.progress = gtk_progress_bar_new ();
+  gtk_box_pack_start (GTK_BOX (vbox), plugin.stats.progress, FALSE, TRUE, 0);
+  
+  plugin.stats.translated = create_stats_row (table, 0, _("Translated:"));
+  plugin.stats.fuzzy = create_stats_row (table, 1, _("Fuzzy:"));
+  plugin.stats.untranslated = create_stats_row (table, 2, _("Untranslated:"));
+  gtk_box_pack_start (GTK_BOX (vbox), table, FALSE, TRUE, 0);
+  
+  gtk_widget_show_all (vbox);
+  /* hidden until a catalog is active */
+  gtk_widget_hide (vbox);
+  
+  plugin.stats.page = vbox;
+  gtk_notebook_append_page (GTK_NOTEBOOK (geany->main_widgets->sidebar_notebook),
+                            vbox, gtk_label_new (_("Translation")));
+}
+
 static void
 update_menus (GeanyDocument *doc)
 {
@@ -493,6 +916,7 @@ on_document_activate (GObject        *obj,
                       gpointer        user_data)
 {
   update_menus (doc);
+  queue_stats_update ();
 }
 
 static void
@@ -501,7 +925,12 @@ on_document_filetype_set (GObject        *obj,
                           GeanyFiletype  *old_ft,
                           gpointer        user_data)
 {
+  if (! doc_is_po (doc) && DOC_VALID (doc)) {
+    /* forget the index, it's not maintained anymore */
+    g_object_set_data (G_OBJECT (doc->editor->sci), GPH_INDEX_KEY, NULL);
+  }
   update_menus (doc);
+  queue_stats_update ();
 }
 
 static void
@@ -510,6 +939,34 @@ on_document_close (GObject       *obj,
                    gpointer       user_data)
 {
   update_menus (NULL);
+  queue_stats_update ();
+}
+
+static gboolean
+on_editor_notify (GObject        *obj,
+                  GeanyEditor    *editor,
+                  SCNotification *nt,
+                  gpointer        user_data)
+{
+  if (nt->nmhdr.code == SCN_MODIFIED &&
+      nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)) {
+    GphIndex *index = g_object_get_data (G_OBJECT (editor->sci), GPH_INDEX_KEY);
+    
+    if (index) {
+      gint pos = (gint) nt->position;
+      gint len = (gint) nt->length;
+      gint line_start = sci_get_position_from_line (editor->sci,
+                                                    sci_get_line_from_position (editor->sci, pos));
+      
+      index_text_changed (index, line_start, pos,
+                          (nt->modificationType & SC_MOD_INSERTTEXT) ? len : -len);
+      if (editor->document == document_get_current ()) {
+        queue_stats_update ();
+      }
+    }
+  }
+  
+  return FALSE;
 }
 
 static void
@@ -1211,6 +1668,11 @@ plugin_init (GeanyData *data)
                          G_CALLBACK (on_document_close), NULL);
   plugin_signal_connect (geany_plugin, NULL, "document-before-save", TRUE,
                          G_CALLBACK (on_document_save), NULL);
+  plugin_signal_connect (geany_plugin, NULL, "editor-notify", FALSE,
+                         G_CALLBACK (on_editor_notify), NULL);
+  
+  create_stats_page ();
+  queue_stats_update ();
   
   /* add keybindings */
   group = plugin_set_key_group (geany_plugin, "pohelper", GPH_KB_COUNT, NULL);
@@ -1244,6 +1706,21 @@ plugin_init (GeanyData *data)
 void
 plugin_cleanup (void)
 {
+  guint i;
+  
+  if (plugin.stats.update_id) {
+    g_source_remove (plugin.stats.update_id);
+    plugin.stats.update_id = 0;
+  }
+  if (plugin.stats.page) {
+    gtk_widget_destroy (plugin.stats.page);
+    plugin.stats.page = NULL;
+  }
+  foreach_document (i) {
+    g_object_set_data (G_OBJECT (documents[i]->editor->sci), GPH_INDEX_KEY,
+                       NULL);
+  }
+  
   if (plugin.menu_item) {
     gtk_widget_destroy (plugin.menu_item);
   }
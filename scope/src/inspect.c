@@ -65,6 +65,24 @@ static void append_stub(GtkTreeIter *parent, const gchar *text, gboolean expand)
 
 #define append_ellipsis(parent, expand) append_stub((parent), _("..."), (expand))
 
+/* The trailing ellipsis of a partially listed variable loads the next children when it
+   becomes visible or is activated. It's marked by a non-zero start, and expand is reset
+   once the children are requested. */
+static void append_more(GtkTreeIter *parent, gint start)
+{
+	scp_tree_store_append_with_values(store, NULL, parent, INSPECT_EXPR, _("..."),
+		INSPECT_START, start, INSPECT_EXPAND, TRUE, -1);
+}
+
+static gboolean inspect_is_more(GtkTreeIter *iter)
+{
+	const char *var1;
+	gint start;
+
+	scp_tree_store_get(store, iter, INSPECT_VAR1, &var1, INSPECT_START, &start, -1);
+	return !var1 && start && scp_tree_store_iter_depth(store, iter);
+}
+
 static gboolean inspect_find_recursive(GtkTreeIter *iter, gint i, const char *key)
 {
 	do
@@ -147,11 +165,98 @@ static void inspect_expand(GtkTreeIter *iter)
 	scp_tree_store_get(store, iter, INSPECT_VAR1, &var1, INSPECT_START, &start,
 		INSPECT_COUNT, &count, INSPECT_NUMCHILD, &numchild, -1);
 	s = g_strdup_printf("%d", start);
-	debug_send_format(N, "07%c%d%d-var-list-children 1 %s %d %d", '0' + (int) strlen(s) - 1,
+	debug_send_format(N, "070%c%d%d-var-list-children 1 %s %d %d", '0' + (int) strlen(s) - 1,
 		start, scid, var1, start, count ? start + count : numchild);
 	g_free(s);
 }
 
+static void inspect_load_more(GtkTreeIter *iter)
+{
+	GtkTreeIter parent;
+	const char *var1;
+	gint from, count, numchild;
+	char *s;
+
+	scp_tree_store_iter_parent(store, &parent, iter);
+	scp_tree_store_get(store, iter, INSPECT_START, &from, -1);
+	scp_tree_store_set(store, iter, INSPECT_EXPAND, FALSE, -1);
+	scp_tree_store_get(store, &parent, INSPECT_VAR1, &var1, INSPECT_COUNT, &count,
+		INSPECT_NUMCHILD, &numchild, -1);
+	s = g_strdup_printf("%d", from);
+	debug_send_format(N, "071%c%d%d-var-list-children 1 %s %d %d", '0' + (int) strlen(s) - 1,
+		from, inspect_get_scid(&parent), var1, from, count ? from + count : numchild);
+	g_free(s);
+}
+
+static gboolean inspect_next_visible(GtkTreeIter *iter, GtkTreePath *path)
+{
+	GtkTreeIter next;
+
+	if (gtk_tree_view_row_expanded(tree, path) &&
+		scp_tree_store_iter_children(store, &next, iter))
+	{
+		*iter = next;
+		gtk_tree_path_down(path);
+		return TRUE;
+	}
+
+	for (;;)
+	{
+		next = *iter;
+
+		if (scp_tree_store_iter_next(store, &next))
+		{
+			*iter = next;
+			gtk_tree_path_next(path);
+			return TRUE;
+		}
+
+		if (!scp_tree_store_iter_parent(store, &next, iter))
+			return FALSE;
+
+		*iter = next;
+		gtk_tree_path_up(path);
+	}
+}
+
+static guint prefetch_id = 0;
+
+static gboolean inspect_prefetch(G_GNUC_UNUSED gpointer gdata)
+{
+	GtkTreePath *start, *end;
+
+	prefetch_id = 0;
+
+	if ((debug_state() & DS_VARIABLE) && gtk_tree_view_get_visible_range(tree, &start, &end))
+	{
+		GtkTreeIter iter;
+
+		if (scp_tree_store_get_iter(store, &iter, start))
+		{
+			do
+			{
+				gboolean expand;
+
+				scp_tree_store_get(store, &iter, INSPECT_EXPAND, &expand, -1);
+				if (expand && inspect_is_more(&iter))
+					inspect_load_more(&iter);
+			} while (gtk_tree_path_compare(start, end) < 0 &&
+				inspect_next_visible(&iter, start));
+		}
+
+		gtk_tree_path_free(start);
+		gtk_tree_path_free(end);
+	}
+
+	return FALSE;
+}
+
+static void inspect_queue_prefetch(void)
+{
+	if (!prefetch_id)
+		prefetch_id = plugin_idle_add(geany_plugin, inspect_prefetch, NULL);
+}
+
 static void on_jump_to_menu_item_activate(GtkMenuItem *menuitem, G_GNUC_UNUSED gpointer gdata)
 {
 	GtkTreeIter iter;
@@ -349,9 +454,34 @@ static void inspect_node_append(const ParseNode *node, GtkTreeIter *parent)
 	}
 }
 
+/* Removes the trailing ellipsis the next children are requested for. If it's gone, the
+   variable was collapsed or re-expanded in the meantime. */
+static gboolean inspect_remove_more(GtkTreeIter *parent, gint from)
+{
+	GtkTreeIter iter;
+	gint n_children = scp_tree_store_iter_n_children(store, parent);
+
+	if (n_children && scp_tree_store_iter_nth_child(store, &iter, parent, n_children - 1) &&
+		inspect_is_more(&iter))
+	{
+		gint start;
+
+		scp_tree_store_get(store, &iter, INSPECT_START, &start, -1);
+
+		if (start == from)
+		{
+			scp_tree_store_remove(store, &iter);
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
 void on_inspect_children(GArray *nodes)
 {
 	char *token = (char *) parse_grab_token(nodes);
+	gboolean append = *token++ == '1';
 	size_t size = *token - '0' + 2;
 
 	iff (strlen(token) >= size + 1, "bad token")
@@ -361,40 +491,66 @@ void on_inspect_children(GArray *nodes)
 		if (inspect_find(&iter, FALSE, token + size))
 		{
 			gint from;
-			GtkTreePath *path = scp_tree_store_get_path(store, &iter);
+			GtkTreePath *path;
 
 			token[size] = '\0';
 			from = atoi(token + 1);
-			scp_tree_store_clear_children(store, &iter, FALSE);
+
+			if (append)
+			{
+				if (!inspect_remove_more(&iter, from))
+					return;
+			}
+			else
+				scp_tree_store_clear_children(store, &iter, FALSE);
 
 			if ((nodes = parse_find_array(nodes, "children")) == NULL)
-				append_stub(&iter, _("no children in range"), FALSE);
+			{
+				if (!append)
+					append_stub(&iter, _("no children in range"), FALSE);
+			}
 			else
 			{
-				gint numchild, end;
+				gint start, numchild, end;
 				const char *var1;
 
-				if (from)
+				if (from && !append)
 					append_ellipsis(&iter, FALSE);
 
-				scp_tree_store_get(store, &iter, INSPECT_VAR1, &var1,
-					INSPECT_NUMCHILD, &numchild, -1);
+				scp_tree_store_get(store, &iter, INSPECT_VAR1, &var1, INSPECT_START,
+					&start, INSPECT_NUMCHILD, &numchild, -1);
 
 				parse_foreach(nodes, (GFunc) inspect_node_append, &iter);
 				end = from + nodes->len;
 
-				if (nodes->len && (from || end < numchild))
+				if (!append)
+					start = from;
+
+				if (nodes->len && (start || end < numchild))
 				{
 					debug_send_format(N, "04-var-set-update-range %s %d %d", var1,
-						from, end);
+						start, end);
+				}
+				else if (nodes->len && append)
+				{
+					/* the earlier pages narrowed the range, everything is listed now */
+					debug_send_format(N, "04-var-set-update-range %s -1 -1", var1);
 				}
 
-				if (nodes->len ? end < numchild : !from)
+				if (nodes->len && end < numchild)
+					append_more(&iter, end);
+				else if (!nodes->len && !from)
 					append_ellipsis(&iter, FALSE);
 			}
 
-			gtk_tree_view_expand_row(tree, path, FALSE);
-			gtk_tree_path_free(path);
+			if (!append)
+			{
+				path = scp_tree_store_get_path(store, &iter);
+				gtk_tree_view_expand_row(tree, path, FALSE);
+				gtk_tree_path_free(path);
+			}
+
+			inspect_queue_prefetch();
 		}
 	}
 }
@@ -1058,12 +1214,40 @@ static gboolean inspect_test_expand_row(G_GNUC_UNUSED GtkTreeView *tree_view,
 	return TRUE;
 }
 
+static void inspect_activate(void)
+{
+	GtkTreeIter iter;
+
+	if (gtk_tree_selection_get_selected(selection, NULL, &iter) && inspect_is_more(&iter))
+	{
+		if (debug_state() & DS_VARIABLE)
+			inspect_load_more(&iter);
+		else
+			plugin_blink();
+	}
+	else
+		menu_item_execute(&inspect_menu_info, apply_item, FALSE);
+}
+
+static void on_inspect_row_expanded(G_GNUC_UNUSED GtkTreeView *tree_view,
+	G_GNUC_UNUSED GtkTreeIter *iter, G_GNUC_UNUSED GtkTreePath *path,
+	G_GNUC_UNUSED gpointer gdata)
+{
+	inspect_queue_prefetch();
+}
+
+static void on_inspect_scrolled(G_GNUC_UNUSED GtkAdjustment *adjustment,
+	G_GNUC_UNUSED gpointer gdata)
+{
+	inspect_queue_prefetch();
+}
+
 static gboolean on_inspect_key_press(G_GNUC_UNUSED GtkWidget *widget, GdkEventKey *event,
 	G_GNUC_UNUSED gpointer gdata)
 {
 	if (ui_is_keyval_enter_or_return(event->keyval))
 	{
-		menu_item_execute(&inspect_menu_info, apply_item, FALSE);
+		inspect_activate();
 		return TRUE;
 	}
 
@@ -1076,7 +1260,7 @@ gboolean on_inspect_button_press(GtkWidget *widget, GdkEventButton *event,
 	if (event->button == 1 && event->type == GDK_2BUTTON_PRESS)
 	{
 		utils_handle_button_press(widget, event);
-		menu_item_execute(&inspect_menu_info, apply_item, FALSE);
+		inspect_activate();
 		return TRUE;
 	}
 
@@ -1132,6 +1316,7 @@ static void on_inspect_menu_show(G_GNUC_UNUSED GtkWidget *widget, G_GNUC_UNUSED
 void inspect_init(void)
 {
 	GtkWidget *menu;
+	GtkAdjustment *vadjustment;
 
 	jump_to_item = get_widget("inspect_jump_to_item");
 	jump_to_menu = GTK_CONTAINER(get_widget("inspect_jump_to_menu"));
@@ -1143,6 +1328,11 @@ void inspect_init(void)
 	g_signal_connect(tree, "key-press-event", G_CALLBACK(on_inspect_key_press), NULL);
 	g_signal_connect(tree, "button-press-event", G_CALLBACK(on_inspect_button_press), NULL);
 	g_signal_connect(tree, "drag-motion", G_CALLBACK(on_inspect_drag_motion), NULL);
+	g_signal_connect(tree, "row-expanded", G_CALLBACK(on_inspect_row_expanded), NULL);
+	vadjustment = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(
+		get_widget("inspect_window")));
+	g_signal_connect(vadjustment, "value-changed", G_CALLBACK(on_inspect_scrolled), NULL);
+	g_signal_connect(vadjustment, "changed", G_CALLBACK(on_inspect_scrolled), NULL);
 
 	g_signal_connect(store, "row-inserted", G_CALLBACK(on_inspect_row_inserted), NULL);
 	g_signal_connect(store, "row-changed", G_CALLBACK(on_inspect_row_changed), NULL);
@@ -1177,6 +1367,8 @@ void inspect_init(void)
 
 void inspect_finalize(void)
 {
+	if (prefetch_id)
+		g_source_remove(prefetch_id);
 	gtk_widget_destroy(inspect_dialog);
 	gtk_widget_destroy(expand_dialog);
 	g_free(jump_to_expr);
@@ -91,7 +91,9 @@ void on_local_variables(GArray *nodes)
 			gtk_tree_model_get((GtkTreeModel *) store, &iter, LOCAL_NAME, &ld.name, -1);
 
 		locals_clear();
+		scp_tree_store_begin_batch(store);
 		parse_foreach(parse_lead_array(nodes), (GFunc) local_node_variable, &ld);
+		scp_tree_store_end_batch(store);
 		g_free(ld.name);
 	}
 }
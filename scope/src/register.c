@@ -282,7 +282,11 @@ void on_register_values(GArray *nodes)
 	ValueAction va = { *token - '0', utils_matches_frame(token + 1) };
 
 	if (va.format < FORMAT_COUNT || va.assign)
+	{
+		scp_tree_store_begin_batch(store);
 		parse_foreach(parse_lead_array(nodes), (GFunc) register_node_value, &va);
+		scp_tree_store_end_batch(store);
+	}
 }
 
 static void on_register_display_edited(G_GNUC_UNUSED GtkCellRendererText *renderer,
@@ -71,7 +71,9 @@ void on_stack_frames(GArray *nodes)
 		char *fid = g_strdup(frame_id);
 
 		stack_clear();
+		scp_tree_store_begin_batch(store);
 		parse_foreach(parse_lead_array(nodes), (GFunc) stack_node_location, fid);
+		scp_tree_store_end_batch(store);
 		g_free(fid);
 
 		if (!frame_id)
@@ -72,6 +72,10 @@ struct _ScpTreeStorePrivate
 	guint sublevel_reserved;
 	gboolean sublevel_discard;
 	gboolean columns_dirty;
+	guint batch_level;
+	gboolean batch_unsorted;
+	AElem *spare;
+	guint n_spare;
 };
 
 #define VALID_ITER(iter, store) \
@@ -84,6 +88,7 @@ struct _ScpTreeStorePrivate
 #define ITER_INDEX(iter) (GPOINTER_TO_INT((iter)->user_data2))
 #define ITER_ELEM(iter) ((AElem *) ITER_ARRAY(iter)->pdata[ITER_INDEX(iter)])
 #define ELEM_SIZE(n_columns) (sizeof(AElem) + ((n_columns) - 1) * sizeof(ScpTreeData))
+#define SPARE_MAX 1024
 
 /* Store */
 
@@ -95,6 +100,52 @@ static void scp_ptr_array_insert_val(GPtrArray *array, guint index, gpointer dat
 	array->pdata[index] = data;
 }
 
+static AElem *scp_alloc_element(ScpTreeStore *store)
+{
+	ScpTreeStorePrivate *priv = store->priv;
+	AElem *elem = priv->spare;
+
+	if (elem)
+	{
+		priv->spare = elem->parent;
+		priv->n_spare--;
+		memset(elem, 0, ELEM_SIZE(priv->n_columns));
+		return elem;
+	}
+
+	return g_slice_alloc0(ELEM_SIZE(priv->n_columns));
+}
+
+static void scp_release_element(ScpTreeStore *store, AElem *elem)
+{
+	ScpTreeStorePrivate *priv = store->priv;
+
+	/* keep some spare elements for the next reload, linked by parent */
+	if (priv->n_spare < SPARE_MAX)
+	{
+		elem->parent = priv->spare;
+		priv->spare = elem;
+		priv->n_spare++;
+	}
+	else
+		g_slice_free1(ELEM_SIZE(priv->n_columns), elem);
+}
+
+static void scp_free_spare(ScpTreeStore *store)
+{
+	ScpTreeStorePrivate *priv = store->priv;
+
+	while (priv->spare)
+	{
+		AElem *elem = priv->spare;
+
+		priv->spare = elem->parent;
+		g_slice_free1(ELEM_SIZE(priv->n_columns), elem);
+	}
+
+	priv->n_spare = 0;
+}
+
 static void scp_free_element(ScpTreeStore *store, AElem *elem);
 
 static void scp_free_array(ScpTreeStore *store, GPtrArray *array)
@@ -119,7 +170,7 @@ static void scp_free_element(ScpTreeStore *store, AElem *elem)
 	for (i = 0; i < priv->n_columns; i++)
 		scp_tree_data_free(elem->data + i, priv->headers[i].type);
 
-	g_slice_free1(ELEM_SIZE(priv->n_columns), elem);
+	scp_release_element(store, elem);
 }
 
 ScpTreeStore *scp_tree_store_new(gboolean sublevels, gint n_columns, ...)
@@ -170,6 +221,7 @@ gboolean scp_tree_store_set_column_types(ScpTreeStore *store, gint n_columns, GT
 	if (priv->headers)
 		scp_tree_data_headers_free(priv->n_columns, priv->headers);
 
+	scp_free_spare(store);
 	priv->headers = scp_tree_data_headers_new(n_columns, types, scp_tree_model_compare_func);
 	priv->n_columns = n_columns;
 	return TRUE;
@@ -407,7 +459,12 @@ static void scp_set_values_signals(ScpTreeStore *store, GtkTreeIter *iter, gbool
 	gboolean sort_changed)
 {
 	if (sort_changed)
-		scp_sort_element(store, iter, TRUE);
+	{
+		if (store->priv->batch_level)
+			store->priv->batch_unsorted = TRUE;
+		else
+			scp_sort_element(store, iter, TRUE);
+	}
 
 	if (changed)
 	{
@@ -539,8 +596,8 @@ static gboolean scp_insert_element(ScpTreeStore *store, GtkTreeIter *iter, AElem
 
 	if (array)
 	{
-		if (position == -1)
-			position = array->len;
+		if (position == -1 || (priv->sort_func && priv->batch_level))
+			position = array->len;  /* batch: sorted when the batch ends */
 		else
 			g_return_val_if_fail((guint) position <= array->len, FALSE);
 	}
@@ -559,7 +616,12 @@ static gboolean scp_insert_element(ScpTreeStore *store, GtkTreeIter *iter, AElem
 	iter->user_data2 = GINT_TO_POINTER(position);
 
 	if (priv->sort_func)
-		scp_sort_element(store, iter, FALSE);
+	{
+		if (priv->batch_level)
+			priv->batch_unsorted = TRUE;
+		else
+			scp_sort_element(store, iter, FALSE);
+	}
 
 	priv->columns_dirty = TRUE;
 	path = scp_tree_store_get_path(store, iter);
@@ -579,16 +641,16 @@ static gboolean scp_insert_element(ScpTreeStore *store, GtkTreeIter *iter, AElem
 void scp_tree_store_insert(ScpTreeStore *store, GtkTreeIter *iter, GtkTreeIter *parent,
 	gint position)
 {
-	AElem *elem = g_slice_alloc0(ELEM_SIZE(store->priv->n_columns));
+	AElem *elem = scp_alloc_element(store);
 
 	if (!scp_insert_element(store, iter, elem, position, parent))
-		g_slice_free1(ELEM_SIZE(store->priv->n_columns), elem);
+		scp_release_element(store, elem);
 }
 
 void scp_tree_store_insert_with_valuesv(ScpTreeStore *store, GtkTreeIter *iter,
 	GtkTreeIter *parent, gint position, gint *columns, GValue *values, gint n_values)
 {
-	AElem *elem = g_slice_alloc0(ELEM_SIZE(store->priv->n_columns));
+	AElem *elem = scp_alloc_element(store);
 	gboolean changed, sort_changed;
 	GtkTreeIter iter1;
 
@@ -601,7 +663,7 @@ void scp_tree_store_insert_with_valuesv(ScpTreeStore *store, GtkTreeIter *iter,
 void scp_tree_store_insert_with_valist(ScpTreeStore *store, GtkTreeIter *iter, GtkTreeIter
 	*parent, gint position, va_list ap)
 {
-	AElem *elem = g_slice_alloc0(ELEM_SIZE(store->priv->n_columns));
+	AElem *elem = scp_alloc_element(store);
 	gboolean changed, sort_changed;
 	GtkTreeIter iter1;
 
@@ -1274,24 +1336,43 @@ static gint scp_index_compare(gint *a, gint *b, ScpSortData *sort_data)
 		priv->headers[priv->sort_column_id].data);
 }
 
-static void scp_sort_children(ScpTreeStore *store, GtkTreeIter *parent)
+static gboolean scp_array_sorted(ScpSortData *sort_data)
+{
+	gint i;
+
+	for (i = 1; i < (gint) sort_data->array->len; i++)
+	{
+		gint prev = i - 1;
+
+		if (scp_index_compare(&prev, &i, sort_data) > 0)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void scp_sort_children(ScpTreeStore *store, GtkTreeIter *parent, gboolean check_sorted)
 {
 	GPtrArray *array = (parent ? ITER_ELEM(parent) : store->priv->root)->children;
 
 	if (array && array->len)
 	{
-		gint *new_order = g_new(gint, array->len);
 		ScpSortData sort_data = { store, array };
 		GtkTreeIter iter;
 		guint i;
 
-		for (i = 0; i < array->len; i++)
-			new_order[i] = i;
+		if (!check_sorted || !scp_array_sorted(&sort_data))
+		{
+			gint *new_order = g_new(gint, array->len);
 
-		g_qsort_with_data(new_order, array->len, sizeof(gint),
-			(GCompareDataFunc) scp_index_compare, &sort_data);
-		scp_reorder_array(store, parent, array, new_order);
-		g_free(new_order);
+			for (i = 0; i < array->len; i++)
+				new_order[i] = i;
+
+			g_qsort_with_data(new_order, array->len, sizeof(gint),
+				(GCompareDataFunc) scp_index_compare, &sort_data);
+			scp_reorder_array(store, parent, array, new_order);
+			g_free(new_order);
+		}
 
 		iter.stamp = store->priv->stamp;
 		iter.user_data = array;
@@ -1299,7 +1380,7 @@ static void scp_sort_children(ScpTreeStore *store, GtkTreeIter *parent)
 		for (i = 0; i < array->len; i++)
 		{
 			iter.user_data2 = GINT_TO_POINTER(i);
-			scp_sort_children(store, &iter);
+			scp_sort_children(store, &iter, check_sorted);
 		}
 	}
 }
@@ -1307,7 +1388,7 @@ static void scp_sort_children(ScpTreeStore *store, GtkTreeIter *parent)
 static void scp_store_sort(ScpTreeStore *store)
 {
 	if (store->priv->sort_func)
-		scp_sort_children(store, NULL);
+		scp_sort_children(store, NULL, FALSE);
 }
 
 void scp_tree_store_set_sort_column_id(ScpTreeStore *store, gint sort_column_id,
@@ -1560,6 +1641,28 @@ gint scp_tree_store_compare_func(ScpTreeStore *store, GtkTreeIter *a, GtkTreeIte
 		scp_tree_data_compare_func(&data_a, &data_b, type);
 }
 
+void scp_tree_store_begin_batch(ScpTreeStore *store)
+{
+	g_return_if_fail(SCP_IS_TREE_STORE(store));
+	store->priv->batch_level++;
+}
+
+void scp_tree_store_end_batch(ScpTreeStore *store)
+{
+	ScpTreeStorePrivate *priv = store->priv;
+
+	g_return_if_fail(SCP_IS_TREE_STORE(store));
+	g_return_if_fail(priv->batch_level > 0);
+
+	if (--priv->batch_level == 0 && priv->batch_unsorted)
+	{
+		priv->batch_unsorted = FALSE;
+
+		if (priv->sort_func)
+			scp_sort_children(store, NULL, TRUE);
+	}
+}
+
 gboolean scp_tree_store_iter_seek(VALIDATE_ONLY ScpTreeStore *store, GtkTreeIter *iter,
 	gint position)
 {
@@ -1693,7 +1796,7 @@ gboolean scp_tree_store_search(ScpTreeStore *store, gboolean sublevels, gboolean
 		data.v_string = g_utf8_collate_key(scp_data_string(&data), -1);
 	}
 
-	found = !linear_order && column == priv->sort_column_id &&
+	found = !linear_order && !priv->batch_unsorted && column == priv->sort_column_id &&
 		priv->sort_func == scp_tree_model_compare_func ?
 		scp_binary_search(array, column, &data, type, iter, sublevels) :
 		scp_linear_search(array, column, &data, type, iter, sublevels);
@@ -1871,6 +1974,10 @@ static GObject *scp_tree_store_constructor(GType type, guint n_construct_propert
 	priv->sublevel_reserved = 0;
 	priv->sublevel_discard = FALSE;
 	priv->columns_dirty = FALSE;
+	priv->batch_level = 0;
+	priv->batch_unsorted = FALSE;
+	priv->spare = NULL;
+	priv->n_spare = 0;
 	return object;
 }
 
@@ -1957,6 +2064,7 @@ static void scp_tree_store_finalize(GObject *object)
 	ScpTreeStorePrivate *priv = store->priv;
 
 	scp_free_array(store, priv->root->children);
+	scp_free_spare(store);
 	g_free(priv->root);
 	g_ptr_array_free(priv->roar, TRUE);
 
@@ -150,6 +150,8 @@ void scp_tree_store_set_utf8_collate(ScpTreeStore *store, gint column, gboolean
 gboolean scp_tree_store_get_utf8_collate(ScpTreeStore *store, gint column);
 gint scp_tree_store_compare_func(ScpTreeStore *store, GtkTreeIter *a, GtkTreeIter *b,
 	gpointer data);
+void scp_tree_store_begin_batch(ScpTreeStore *store);
+void scp_tree_store_end_batch(ScpTreeStore *store);
 gboolean scp_tree_store_iter_seek(ScpTreeStore *store, GtkTreeIter *iter, gint position);
 gboolean scp_tree_store_search(ScpTreeStore *store, gboolean sublevels, gboolean linear_order,
 	GtkTreeIter *iter, GtkTreeIter *parent, gint column, ...);
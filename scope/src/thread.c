@@ -543,7 +543,9 @@ static const char *thread_info_parse(GArray *nodes, gboolean select)
 {
 	const char *tid = parse_find_value(nodes, "current-thread-id");
 
+	scp_tree_store_begin_batch(store);
 	parse_foreach(parse_lead_array(nodes), (GFunc) thread_node_parse, NULL);
+	scp_tree_store_end_batch(store);
 
 	if (tid)
 		set_gdb_thread(tid, select);
@@ -22,6 +22,8 @@
 	#include "config.h" /* for the gettext domain */
 #endif
 
+#include <string.h>
+
 #include "tableconvert.h"
 #include "tableconvert_ui.h"
 
@@ -82,19 +84,225 @@ TableConvertRule tablerules[] = {
 };
 
 
-static gchar* convert_to_table_worker(gchar **rows, gboolean header,
-	const TableConvertRule *rule)
+/* Size of the blocks the converted table is inserted into the document
+ * with, so huge selections don't need to be converted in one piece */
+#define TC_CHUNK_SIZE (64 * 1024)
+
+
+typedef struct {
+	const gchar *pos;
+	const gchar *end;
+	gchar delimiter;
+	/* Whether the last row read was terminated by a line break, i.e.
+	 * whether another row follows */
+	gboolean row_ended_by_newline;
+} TableConvertTokenizer;
+
+
+/* Tabulators are used as column separators by default. In case the
+ * first line doesn't contain any, but commas, we are assuming CSV. */
+static gchar guess_delimiter(const gchar *text, gsize len)
+{
+	const gchar *p;
+	gboolean has_comma = FALSE;
+
+	for (p = text; p < text + len && *p != '\n'; p++)
+	{
+		if (*p == '\t')
+		{
+			return '\t';
+		}
+		if (*p == ',')
+		{
+			has_comma = TRUE;
+		}
+	}
+
+	return has_comma ? ',' : '\t';
+}
+
+
+static gboolean is_field_end(const TableConvertTokenizer *tok, const gchar *p)
+{
+	return *p == tok->delimiter ||
+		*p == '\n' ||
+		(*p == '\r' && p + 1 < tok->end && p[1] == '\n');
+}
+
+
+/* Returns the closing quote of the quoted field starting at p, or NULL if
+ * the field isn't properly quoted, i.e. if there is no quote followed by
+ * the end of the field (doubled quotes don't count). */
+static const gchar *find_closing_quote(const TableConvertTokenizer *tok, const gchar *p)
+{
+	for (p++; p < tok->end; p++)
+	{
+		if (*p != '"')
+		{
+			continue;
+		}
+		if (p + 1 < tok->end && p[1] == '"')
+		{
+			p++;
+		}
+		else if (p + 1 == tok->end || is_field_end(tok, p + 1))
+		{
+			return p;
+		}
+		else
+		{
+			return NULL;
+		}
+	}
+	return NULL;
+}
+
+
+/* Appends the next field of the current row to str and moves on behind
+ * it. CSV fields might be quoted, in which case they can contain
+ * delimiters and line breaks, and doubled quotes stand for a single one.
+ * Tab separated fields, and fields with a quote missing, are taken as
+ * they are.
+ * Returns TRUE if another field of the same row follows. */
+static gboolean tokenizer_append_field(TableConvertTokenizer *tok, GString *str)
+{
+	const gchar *p = tok->pos;
+	const gchar *start;
+	const gchar *closing_quote = NULL;
+
+	if (tok->delimiter == ',' && p < tok->end && *p == '"')
+	{
+		closing_quote = find_closing_quote(tok, p);
+	}
+
+	if (closing_quote != NULL)
+	{
+		start = ++p;
+		while (p < closing_quote)
+		{
+			if (*p == '"')
+			{
+				/* Doubled quote */
+				g_string_append_len(str, start, p + 1 - start);
+				p += 2;
+				start = p;
+				continue;
+			}
+			p++;
+		}
+		g_string_append_len(str, start, p - start);
+		/* Skipping the closing quote */
+		p++;
+	}
+	else
+	{
+		const gchar *field_end;
+
+		start = p;
+		while (p < tok->end && *p != tok->delimiter && *p != '\n')
+		{
+			p++;
+		}
+		field_end = p;
+		if (p < tok->end && *p == '\n' && field_end > start && field_end[-1] == '\r')
+		{
+			field_end--;
+		}
+		g_string_append_len(str, start, field_end - start);
+	}
+
+	if (p < tok->end && *p == tok->delimiter)
+	{
+		tok->pos = p + 1;
+		return TRUE;
+	}
+
+	if (p < tok->end && *p == '\r')
+	{
+		p++;
+	}
+	tok->row_ended_by_newline = (p < tok->end && *p == '\n');
+	tok->pos = tok->row_ended_by_newline ? p + 1 : tok->end;
+
+	return FALSE;
+}
+
+
+/* Estimates the size of the table built from text, so the buffer it is
+ * built in doesn't need to be reallocated all the time. As the table is
+ * inserted in chunks, the buffer never needs to hold much more than one. */
+static gsize estimate_table_size(const gchar *text, gsize len,
+	gchar delimiter, const TableConvertRule *rule, const gchar *eol)
+{
+	const gchar *p;
+	const gchar *end = text + len;
+	gsize rows = 1;
+	gsize columns = 1;
+	gsize row_size;
+
+	if (len >= TC_CHUNK_SIZE)
+	{
+		return 2 * TC_CHUNK_SIZE;
+	}
+
+	for (p = text; p < end && *p != '\n'; p++)
+	{
+		if (*p == delimiter)
+		{
+			columns++;
+		}
+	}
+	while ((p = memchr(p, '\n', end - p)) != NULL)
+	{
+		rows++;
+		p++;
+	}
+
+	row_size = strlen(rule->linestart) + strlen(rule->lineend) +
+		strlen(eol) + strlen(rule->linesplit) +
+		(columns - 1) * strlen(rule->columnsplit);
+
+	return len + rows * row_size + strlen(rule->start) +
+		strlen(rule->header_start) + strlen(rule->header_stop) +
+		strlen(rule->body_start) + strlen(rule->body_end) +
+		strlen(rule->end) + 1;
+}
+
+
+static void insert_chunk(ScintillaObject *sci, GString *str)
+{
+	scintilla_send_message(sci, SCI_ADDTEXT, str->len, (sptr_t) str->str);
+	g_string_truncate(str, 0);
+}
+
+
+/* Converts text into a table in a single pass and inserts it at the
+ * current position of the document */
+static void convert_to_table_worker(GeanyDocument *doc, const gchar *text,
+	gsize len, gboolean header, const TableConvertRule *rule)
 {
 	guint i;
-	guint j;
 	GString *replacement_str = NULL;
-	GeanyDocument *doc = NULL;
-	doc = document_get_current();
+	TableConvertTokenizer tok;
+	const gchar *eol = NULL;
+	gboolean eol_after_lineend;
+
+	g_return_if_fail(text != NULL);
+
+	eol = editor_get_eol_char(doc->editor);
+	eol_after_lineend = (doc->file_type->id == GEANY_FILETYPES_SQL ||
+		doc->file_type->id == GEANY_FILETYPES_LATEX);
 
-	g_return_val_if_fail(rows != NULL, NULL);
+	tok.pos = text;
+	tok.end = text + len;
+	tok.delimiter = guess_delimiter(text, len);
+	tok.row_ended_by_newline = FALSE;
+
+	replacement_str = g_string_sized_new(
+		estimate_table_size(text, len, tok.delimiter, rule, eol));
 
 	/* Adding start of table to replacement */
-	replacement_str = g_string_new(rule->start);
+	g_string_append(replacement_str, rule->start);
 
 	/* Adding special header if requested
 	 * e.g. <thead> */
@@ -104,11 +312,13 @@ static gchar* convert_to_table_worker(gchar **rows, gboolean header,
 	}
 
 	/* Iteration onto rows and building up lines of table for
-	 * replacement */
-	for (i = 0; rows[i] != NULL; i++)
+	 * replacement. Every line break starts a new row, also a trailing
+	 * one. */
+	i = 0;
+	do
 	{
-		gchar **columns = NULL;
-		columns = g_strsplit_set(rows[i], "\t", -1);
+		gboolean first_column = TRUE;
+		gboolean more_columns;
 
 		if (i == 1 &&
 			header == TRUE)
@@ -122,35 +332,42 @@ static gchar* convert_to_table_worker(gchar **rows, gboolean header,
 
 		g_string_append(replacement_str, rule->linestart);
 
-		for (j = 0; columns[j] != NULL; j++)
+		do
 		{
-			if (j > 0)
+			if (!first_column)
 			{
 				g_string_append(replacement_str, rule->columnsplit);
 			}
-			g_string_append(replacement_str, columns[j]);
+			more_columns = tokenizer_append_field(&tok, replacement_str);
+			first_column = FALSE;
 		}
+		while (more_columns);
 
 		if (utils_str_equal(rule->lineend, ""))
 		{
-			g_string_append(replacement_str, editor_get_eol_char(doc->editor));
+			g_string_append(replacement_str, eol);
 		}
 		else
 		{
 			g_string_append(replacement_str, rule->lineend);
-			if (doc->file_type->id == GEANY_FILETYPES_SQL ||
-				doc->file_type->id == GEANY_FILETYPES_LATEX)
+			if (eol_after_lineend)
 			{
-				g_string_append(replacement_str, editor_get_eol_char(doc->editor));
+				g_string_append(replacement_str, eol);
 			}
 		}
 
-		if (rows[i+1] != NULL)
+		if (tok.row_ended_by_newline)
 		{
 			g_string_append(replacement_str, rule->linesplit);
 		}
-		g_strfreev(columns);
+
+		if (replacement_str->len >= TC_CHUNK_SIZE)
+		{
+			insert_chunk(doc->editor->sci, replacement_str);
+		}
+		i++;
 	}
+	while (tok.row_ended_by_newline);
 
 	if (header == TRUE)
 	{
@@ -160,105 +377,73 @@ static gchar* convert_to_table_worker(gchar **rows, gboolean header,
 	/* Adding the footer of table */
 	g_string_append(replacement_str, rule->end);
 
-	return g_string_free(replacement_str, FALSE);
+	insert_chunk(doc->editor->sci, replacement_str);
+	g_string_free(replacement_str, TRUE);
 }
 
 void convert_to_table(gboolean header, gint file_type)
 {
 	GeanyDocument *doc = NULL;
+	const TableConvertRule *rule = NULL;
+	gchar *selection = NULL;
+
 	doc = document_get_current();
 
 	g_return_if_fail(doc != NULL);
 
-	if (sci_has_selection(doc->editor->sci))
+	/* in case of there was no selection we are just doing nothing */
+	if (!sci_has_selection(doc->editor->sci))
 	{
-		gchar *selection = NULL;
-		gchar **rows = NULL;
-		gchar *replacement = NULL;
-		GString *selection_str = NULL;
-
-		/* Actually grabbing selection and splitting it into single
-		 * lines we will work on later */
-		selection = sci_get_selection_contents(doc->editor->sci);
-
-		selection_str = g_string_new(selection);
-		utils_string_replace_all(selection_str, "\r\n", "\n");
-
-		g_free(selection);
-		selection = g_string_free(selection_str, FALSE);
-
-		rows = g_strsplit_set(selection, "\n", -1);
-		g_free(selection);
+		return;
+	}
 
-		/* Checking whether we do have something we can work on - Returning if not */
-		if (rows != NULL)
+	if (file_type == -1)
+	{
+		switch (doc->file_type->id)
 		{
-			if (file_type == -1)
+			case GEANY_FILETYPES_HTML:
+			case GEANY_FILETYPES_MARKDOWN:
 			{
-				switch (doc->file_type->id)
-				{
-					case GEANY_FILETYPES_NONE:
-					{
-						g_strfreev(rows);
-						return;
-					}
-					case GEANY_FILETYPES_HTML:
-					case GEANY_FILETYPES_MARKDOWN:
-					{
-						replacement = convert_to_table_worker(rows,
-							header,
-							&tablerules[TC_HTML]);
-						break;
-					}
-					case GEANY_FILETYPES_LATEX:
-					{
-						replacement = convert_to_table_worker(rows,
-							header,
-							&tablerules[TC_LATEX]);
-						break;
-					}
-					case GEANY_FILETYPES_SQL:
-					{
-						/* TODO: Check for INTEGER and other datatypes on SQL */
-						replacement = convert_to_table_worker(rows,
-							header,
-							&tablerules[TC_SQL]);
-						break;
-					}
-					default:
-					{
-						/* We just don't do anything */
-					}
-				} /* filetype switch */
+				rule = &tablerules[TC_HTML];
+				break;
 			}
-			else
+			case GEANY_FILETYPES_LATEX:
 			{
-				replacement = convert_to_table_worker(rows,
-							header,
-							&tablerules[file_type]);
+				rule = &tablerules[TC_LATEX];
+				break;
 			}
+			case GEANY_FILETYPES_SQL:
+			{
+				/* TODO: Check for INTEGER and other datatypes on SQL */
+				rule = &tablerules[TC_SQL];
+				break;
+			}
+			default:
+			{
+				/* We just don't do anything */
+			}
+		} /* filetype switch */
+	}
+	else
+	{
+		rule = &tablerules[file_type];
+	}
 
-		}
-		else
-		{
-			/* OK. Something went not as expected.
-			 * We did have a selection but cannot parse it into rows.
-			 * Aborting */
-			g_warning(_("Something went wrong on parsing selection. Aborting"));
-			return;
-		}
-
-		/* The replacement should have been prepared at this point. Let's go
-		 * on and put it into document and replace selection with it. */
-		if (replacement != NULL)
-		{
-			sci_replace_sel(doc->editor->sci, replacement);
-		}
-		g_strfreev(rows);
-		g_free(replacement);
+	if (rule == NULL)
+	{
+		return;
 	}
-	   /* in case of there was no selection we are just doing nothing */
-	return;
+
+	/* Actually grabbing selection. The table replacing it is inserted
+	 * piece by piece, so keep it a single undo step. */
+	selection = sci_get_selection_contents(doc->editor->sci);
+
+	sci_start_undo_action(doc->editor->sci);
+	sci_replace_sel(doc->editor->sci, "");
+	convert_to_table_worker(doc, selection, strlen(selection), header, rule);
+	sci_end_undo_action(doc->editor->sci);
+
+	g_free(selection);
 }
 
 
@@ -1068,6 +1068,84 @@ gwh_browser_init (GwhBrowser *self)
 }
 
 
+/* appends @str to @buf as a JavaScript string literal, or "null" if @str is
+ * %NULL */
+static void
+append_js_string (GString     *buf,
+                  const gchar *str)
+{
+  if (! str) {
+    g_string_append (buf, "null");
+    return;
+  }
+  
+  g_string_append_c (buf, '"');
+  for (; *str; str++) {
+    switch (*str) {
+      case '"':   g_string_append (buf, "\\\""); break;
+      case '\\':  g_string_append (buf, "\\\\"); break;
+      case '\n':  g_string_append (buf, "\\n"); break;
+      case '\r':  g_string_append (buf, "\\r"); break;
+      case '\t':  g_string_append (buf, "\\t"); break;
+      
+      default:
+        if ((guchar) *str < 0x20) {
+          g_string_append_printf (buf, "\\u%04x", (guint) (guchar) *str);
+        } else if (str[0] == '\xe2' && str[1] == '\x80' &&
+                   (str[2] == '\xa8' || str[2] == '\xa9')) {
+          /* U+2028 and U+2029 terminate lines in JavaScript */
+          g_string_append_printf (buf, "\\u%04x", str[2] == '\xa8' ? 0x2028 : 0x2029);
+          str += 2;
+        } else {
+          g_string_append_c (buf, *str);
+        }
+    }
+  }
+  g_string_append_c (buf, '"');
+}
+
+/* the script replacing the stylesheets linked from @uri in the page, called
+ * with the URI and either the new stylesheet contents, or null to reload the
+ * file itself. if the file isn't linked from the page (e.g. it is @import-ed),
+ * the whole page is reloaded. */
+#define RELOAD_STYLESHEET_SCRIPT                                               \
+  "(function (uri, css) {"                                                     \
+  "  var links = document.getElementsByTagName ('link');"                      \
+  "  var found = [];"                                                          \
+  "  for (var i = 0; i < links.length; i++) {"                                 \
+  "    if (/\\bstylesheet\\b/i.test (links[i].rel) &&"                         \
+  "        links[i].href.replace (/[?#].*$/, '') == uri) {"                    \
+  "      found.push (links[i]);"                                               \
+  "    }"                                                                      \
+  "  }"                                                                        \
+  "  if (found.length == 0 && css === null) {"                                 \
+  "    location.reload ();"                                                    \
+  "  }"                                                                        \
+  "  found.forEach (function (link) {"                                         \
+  "    var style = link.gwhStyle;"                                             \
+  "    if (css !== null) {"                                                    \
+  "      if (! style) {"                                                       \
+  "        style = link.gwhStyle = document.createElement ('style');"          \
+  "        link.parentNode.insertBefore (style, link.nextSibling);"            \
+  "      }"                                                                    \
+  "      style.textContent = css;"                                             \
+  "      link.disabled = true;"                                                \
+  "    } else {"                                                               \
+  "      var clone = link.cloneNode (false);"                                  \
+  "      clone.href = uri + '?gwh-reload=' + new Date ().getTime ();"          \
+  "      clone.onload = clone.onerror = function () {"                         \
+  "        if (style && style.parentNode) {"                                   \
+  "          style.parentNode.removeChild (style);"                            \
+  "        }"                                                                  \
+  "        if (link.parentNode) {"                                             \
+  "          link.parentNode.removeChild (link);"                              \
+  "        }"                                                                  \
+  "      };"                                                                   \
+  "      link.parentNode.insertBefore (clone, link.nextSibling);"              \
+  "    }"                                                                      \
+  "  });"                                                                      \
+  "})"
+
 /*----------------------------- Begin public API -----------------------------*/
 
 GtkWidget *
@@ -1135,6 +1213,44 @@ gwh_browser_reload (GwhBrowser *self)
   webkit_web_view_reload (WEBKIT_WEB_VIEW (self->priv->web_view));
 }
 
+/* updates the stylesheets linked from @uri in the current page without
+ * reloading the page, so its state (scroll position, running scripts...) is
+ * kept. @contents is the new stylesheet, or %NULL to reload it from @uri. */
+void
+gwh_browser_reload_stylesheet (GwhBrowser  *self,
+                               const gchar *uri,
+                               const gchar *contents)
+{
+  GString *script;
+  
+  g_return_if_fail (GWH_IS_BROWSER (self));
+  g_return_if_fail (uri != NULL);
+  
+  script = g_string_new (RELOAD_STYLESHEET_SCRIPT);
+  g_string_append_c (script, '(');
+  append_js_string (script, uri);
+  g_string_append_c (script, ',');
+  append_js_string (script, contents);
+  g_string_append (script, ");");
+  webkit_web_view_execute_script (WEBKIT_WEB_VIEW (self->priv->web_view),
+                                  script->str);
+  g_string_free (script, TRUE);
+}
+
+/* displays @contents in place of the current page, e.g. to preview a
+ * document before it gets saved */
+void
+gwh_browser_load_contents (GwhBrowser  *self,
+                           const gchar *contents)
+{
+  g_return_if_fail (GWH_IS_BROWSER (self));
+  g_return_if_fail (contents != NULL);
+  
+  webkit_web_view_load_string (WEBKIT_WEB_VIEW (self->priv->web_view),
+                               contents, "text/html", "UTF-8",
+                               gwh_browser_get_uri (self));
+}
+
 void
 gwh_browser_set_inspector_transient_for (GwhBrowser *self,
                                             GtkWindow  *window)
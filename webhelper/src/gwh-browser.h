@@ -77,6 +77,13 @@ WebKitWebView  *gwh_browser_get_web_view                  (GwhBrowser *self);
 G_GNUC_INTERNAL
 void            gwh_browser_reload                        (GwhBrowser *self);
 G_GNUC_INTERNAL
+void            gwh_browser_reload_stylesheet             (GwhBrowser  *self,
+                                                           const gchar *uri,
+                                                           const gchar *contents);
+G_GNUC_INTERNAL
+void            gwh_browser_load_contents                 (GwhBrowser  *self,
+                                                           const gchar *contents);
+G_GNUC_INTERNAL
 void            gwh_browser_set_inspector_transient_for   (GwhBrowser *self,
                                                            GtkWindow  *window);
 G_GNUC_INTERNAL
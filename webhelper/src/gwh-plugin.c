@@ -226,18 +226,216 @@ on_settings_windows_attrs_notify (GObject    *object,
   }
 }
 
+/* pending updates of the web view, coalesced so saving or modifying many
+ * documents at once only updates the view once. unsaved documents are only
+ * read when the update is applied. */
+static struct {
+  guint           source_id;
+  gboolean        reload;       /* whether the whole page should be reloaded */
+  GeanyDocument  *page;         /* unsaved document of the page, or NULL */
+  GHashTable     *stylesheets;  /* URI => unsaved document, or NULL if saved */
+  gulong          load_handler; /* waiting for the page to load, or 0 */
+} G_update = { 0, FALSE, NULL, NULL, 0 };
+
+static gchar *
+get_document_uri (GeanyDocument *doc)
+{
+  return doc->real_path ? g_filename_to_uri (doc->real_path, NULL, NULL) : NULL;
+}
+
+/* gets the contents of @doc if it is still open on @uri, or %NULL */
+static gchar *
+get_document_contents (GeanyDocument *doc,
+                       const gchar   *uri)
+{
+  gchar *contents = NULL;
+  gchar *doc_uri;
+  
+  if (DOC_VALID (doc) && (doc_uri = get_document_uri (doc))) {
+    if (g_strcmp0 (doc_uri, uri) == 0) {
+      contents = sci_get_contents (doc->editor->sci,
+                                   sci_get_length (doc->editor->sci) + 1);
+    }
+    g_free (doc_uri);
+  }
+  
+  return contents;
+}
+
+static void
+update_stylesheet (gpointer key,
+                   gpointer value,
+                   gpointer data)
+{
+  gchar *contents = NULL;
+  
+  if (value) {
+    contents = get_document_contents (value, key);
+  }
+  gwh_browser_reload_stylesheet (GWH_BROWSER (G_browser), key, contents);
+  g_free (contents);
+}
+
+static void
+cancel_page_load_wait (void)
+{
+  if (G_update.load_handler) {
+    g_signal_handler_disconnect (gwh_browser_get_web_view (GWH_BROWSER (G_browser)),
+                                 G_update.load_handler);
+    G_update.load_handler = 0;
+  }
+}
+
+/* applies the pending stylesheet updates to the newly loaded page */
+static void
+on_web_view_load_status_notify (GObject    *object,
+                                GParamSpec *pspec,
+                                gpointer    data)
+{
+  switch (webkit_web_view_get_load_status (WEBKIT_WEB_VIEW (object))) {
+    case WEBKIT_LOAD_FINISHED:
+      g_hash_table_foreach (G_update.stylesheets, update_stylesheet, NULL);
+      /* fallthrough */
+    case WEBKIT_LOAD_FAILED:
+      g_hash_table_remove_all (G_update.stylesheets);
+      cancel_page_load_wait ();
+      break;
+    
+    default:
+      break;
+  }
+}
+
+static gboolean
+on_update_timeout (gpointer data)
+{
+  const gchar *uri      = gwh_browser_get_uri (GWH_BROWSER (G_browser));
+  gchar       *contents = NULL;
+  gboolean     loading  = TRUE;
+  
+  G_update.source_id = 0;
+  
+  if (G_update.reload) {
+    gwh_browser_reload (GWH_BROWSER (G_browser));
+  } else if (G_update.page && uri &&
+             (contents = get_document_contents (G_update.page, uri))) {
+    gwh_browser_load_contents (GWH_BROWSER (G_browser), contents);
+  } else {
+    loading = G_update.load_handler != 0;
+  }
+  g_free (contents);
+  
+  if (! loading) {
+    g_hash_table_foreach (G_update.stylesheets, update_stylesheet, NULL);
+    g_hash_table_remove_all (G_update.stylesheets);
+  } else if (! G_update.load_handler &&
+             g_hash_table_size (G_update.stylesheets) > 0) {
+    /* the new page would use the saved stylesheets, so update them once it's
+     * loaded */
+    G_update.load_handler = g_signal_connect (gwh_browser_get_web_view (GWH_BROWSER (G_browser)),
+                                              "notify::load-status",
+                                              G_CALLBACK (on_web_view_load_status_notify),
+                                              NULL);
+  }
+  G_update.reload = FALSE;
+  G_update.page = NULL;
+  
+  return FALSE;
+}
+
+static void
+cancel_update (void)
+{
+  if (G_update.source_id) {
+    g_source_remove (G_update.source_id);
+    G_update.source_id = 0;
+  }
+  cancel_page_load_wait ();
+  G_update.reload = FALSE;
+  G_update.page = NULL;
+  g_hash_table_remove_all (G_update.stylesheets);
+}
+
+static void
+schedule_update (guint delay)
+{
+  if (G_update.source_id) {
+    /* restart the delay so a burst of changes results in a single update */
+    g_source_remove (G_update.source_id);
+  }
+  G_update.source_id = g_timeout_add (delay, on_update_timeout, NULL);
+}
+
+static gboolean
+document_is_stylesheet (GeanyDocument *doc)
+{
+  return doc->file_type && doc->file_type->id == GEANY_FILETYPES_CSS;
+}
+
 static void
 on_document_save (GObject        *obj,
                   GeanyDocument  *doc,
                   gpointer        user_data)
 {
-  gboolean auto_reload = FALSE;
+  gboolean  auto_reload = FALSE;
+  gint      delay;
+  gchar    *uri;
   
-  g_object_get (G_OBJECT (G_settings), "browser-auto-reload", &auto_reload,
+  g_object_get (G_OBJECT (G_settings),
+                "browser-auto-reload", &auto_reload,
+                "browser-reload-delay", &delay,
                 NULL);
-  if (auto_reload) {
-    gwh_browser_reload (GWH_BROWSER (G_browser));
+  if (! auto_reload) {
+    return;
+  }
+  
+  uri = get_document_uri (doc);
+  if (uri && document_is_stylesheet (doc)) {
+    /* hot-swap the stylesheet rather than reloading the whole page */
+    g_hash_table_insert (G_update.stylesheets, uri, NULL);
+  } else {
+    G_update.reload = TRUE;
+    g_free (uri);
   }
+  schedule_update ((guint) MAX (delay, 0));
+}
+
+static gboolean
+on_editor_notify (GObject        *obj,
+                  GeanyEditor    *editor,
+                  SCNotification *nt,
+                  gpointer        user_data)
+{
+  gboolean  live_preview = FALSE;
+  gint      delay;
+  gchar    *uri;
+  
+  if (nt->nmhdr.code != SCN_MODIFIED ||
+      ! (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))) {
+    return FALSE;
+  }
+  
+  g_object_get (G_OBJECT (G_settings),
+                "browser-live-preview", &live_preview,
+                "browser-reload-delay", &delay,
+                NULL);
+  if (! live_preview || ! (uri = get_document_uri (editor->document))) {
+    return FALSE;
+  }
+  
+  /* only remember what changed, the contents are read once the delay expires */
+  if (document_is_stylesheet (editor->document)) {
+    g_hash_table_insert (G_update.stylesheets, uri, editor->document);
+    schedule_update ((guint) MAX (delay, 0));
+  } else if (g_strcmp0 (uri, gwh_browser_get_uri (GWH_BROWSER (G_browser))) == 0) {
+    G_update.page = editor->document;
+    schedule_update ((guint) MAX (delay, 0));
+    g_free (uri);
+  } else {
+    g_free (uri);
+  }
+  
+  return FALSE;
 }
 
 static void
@@ -306,6 +504,20 @@ load_config (void)
     _("Whether the browser reloads itself upon document saving"),
     TRUE,
     G_PARAM_READWRITE));
+  gwh_settings_install_property (G_settings, g_param_spec_boolean (
+    "browser-live-preview",
+    _("Browser live preview"),
+    _("Whether the browser is updated as the current page or its stylesheets "
+      "are modified, before they get saved"),
+    FALSE,
+    G_PARAM_READWRITE));
+  gwh_settings_install_property (G_settings, g_param_spec_int (
+    "browser-reload-delay",
+    _("Browser reload delay"),
+    _("Delay in milliseconds before updating the browser after documents "
+      "change, so close changes result in a single update"),
+    0, G_MAXINT, 50,
+    G_PARAM_READWRITE));
   gwh_settings_install_property (G_settings, g_param_spec_string (
     "browser-last-uri",
     _("Browser last URI"),
@@ -409,6 +621,9 @@ plugin_init (GeanyData *data)
   load_config ();
   gwh_keybindings_init ();
   
+  G_update.stylesheets = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                g_free, NULL);
+  
   G_browser = gwh_browser_new ();
   g_signal_connect (G_browser, "populate-popup",
                     G_CALLBACK (on_browser_populate_popup), NULL);
@@ -431,6 +646,8 @@ plugin_init (GeanyData *data)
   
   plugin_signal_connect (geany_plugin, NULL, "document-save", TRUE,
                          G_CALLBACK (on_document_save), NULL);
+  plugin_signal_connect (geany_plugin, NULL, "editor-notify", TRUE,
+                         G_CALLBACK (on_editor_notify), NULL);
   
   /* add keybindings */
   keybindings_set_item (gwh_keybindings_get_group (), GWH_KB_TOGGLE_INSPECTOR,
@@ -446,6 +663,10 @@ plugin_init (GeanyData *data)
 void
 plugin_cleanup (void)
 {
+  cancel_update ();
+  g_hash_table_destroy (G_update.stylesheets);
+  G_update.stylesheets = NULL;
+  
   detach_browser ();
   
   gwh_keybindings_cleanup ();
@@ -458,6 +679,8 @@ struct _GwhConfigDialog
 {
   GtkWidget *browser_position;
   GtkWidget *browser_auto_reload;
+  GtkWidget *browser_live_preview;
+  GtkWidget *browser_reload_delay;
   
   GtkWidget *secondary_windows_skip_taskbar;
   GtkWidget *secondary_windows_are_transient;
@@ -477,6 +700,8 @@ on_configure_dialog_response (GtkDialog        *dialog,
       gwh_settings_widget_sync_v (G_settings,
                                   cdialog->browser_position,
                                   cdialog->browser_auto_reload,
+                                  cdialog->browser_live_preview,
+                                  cdialog->browser_reload_delay,
                                   cdialog->secondary_windows_skip_taskbar,
                                   cdialog->secondary_windows_are_transient,
                                   cdialog->secondary_windows_type,
@@ -516,6 +741,14 @@ plugin_configure (GtkDialog *dialog)
   cdialog->browser_auto_reload = gwh_settings_widget_new (G_settings,
                                                           "browser-auto-reload");
   gtk_box_pack_start (GTK_BOX (box), cdialog->browser_auto_reload, FALSE, TRUE, 0);
+  /* live preview */
+  cdialog->browser_live_preview = gwh_settings_widget_new (G_settings,
+                                                           "browser-live-preview");
+  gtk_box_pack_start (GTK_BOX (box), cdialog->browser_live_preview, FALSE, TRUE, 0);
+  /* reload delay */
+  cdialog->browser_reload_delay = gwh_settings_widget_new (G_settings,
+                                                           "browser-reload-delay");
+  gtk_box_pack_start (GTK_BOX (box), cdialog->browser_reload_delay, FALSE, TRUE, 0);
   
   /* Windows */
   gtk_box_pack_start (GTK_BOX (box1), ui_frame_new_with_alignment (_("Windows"), &alignment), FALSE, FALSE, 0);